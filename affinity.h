@@ -0,0 +1,210 @@
+
+// Author: 	Stephan Meesters
+//
+// Pinning the threads of a pool to processors
+//
+// A band of a grid is stepped by the same thread of the pool every
+// generation, and its pages lie on the NUMA node of that thread (see
+// grid.h). Left alone the scheduler moves threads between nodes, and a band
+// is then read from remote memory. A policy pins the thread of every band to
+// one processor (cores), or to the processors of one node (nodes), in the
+// order of the bands, so neighbouring bands share a node and the halo rows
+// between them stay local.
+//
+// Nodes are read from sysfs, so no libnuma is needed. Elsewhere than on
+// Linux pinning is not supported and reports so.
+//
+
+#ifndef CONWAY_AFFINITY_H
+#define CONWAY_AFFINITY_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "threadpool.h"
+
+/* where the threads of a pool are pinned */
+enum AffinityPolicy
+{
+    AFFINITY_NONE,      // wherever the scheduler puts them
+    AFFINITY_CORES,     // a processor per band
+    AFFINITY_NODES      // the processors of a NUMA node per band
+};
+
+/* policy by its name, false if there is no such policy */
+inline bool parseAffinity(const char* text, AffinityPolicy& policy)
+{
+    static const char* names[] = {"none", "cores", "nodes"};
+    for(int i = 0; i<3; i++)
+    {
+        if(strcmp(text, names[i]) == 0)
+        {
+            policy = AffinityPolicy(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* processors of a sysfs list such as 0-7,16-23 */
+inline std::vector<int> parseProcessorList(const char* text)
+{
+    std::vector<int> processors;
+    for(const char* p = text; *p != 0 && *p != '\n'; )
+    {
+        char* end;
+        long first = strtol(p, &end, 10), last = first;
+        if(end == p)
+        {
+            break;
+        }
+        if(*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for(long i = first; i<=last; i++)
+        {
+            processors.push_back((int)i);
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return processors;
+}
+
+/* processors this process may run on, in order */
+inline std::vector<int> allowedProcessors()
+{
+    std::vector<int> processors;
+#ifdef __linux__
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for(int i = 0; i<CPU_SETSIZE; i++)
+        {
+            if(CPU_ISSET(i, &set))
+            {
+                processors.push_back(i);
+            }
+        }
+    }
+#endif
+    return processors;
+}
+
+/* the allowed processors of every NUMA node that has any, or all of them
+   as a single node without sysfs */
+inline std::vector<std::vector<int> > numaNodes()
+{
+    std::vector<int> allowed = allowedProcessors();
+    std::vector<std::vector<int> > nodes;
+    for(int node = 0; ; node++)
+    {
+        std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+        FILE* file = fopen(path.c_str(), "r");
+        if(file == nullptr)
+        {
+            break;
+        }
+        char text[4096] = {0};
+        bool read = fgets(text, sizeof(text), file) != nullptr;
+        fclose(file);
+        std::vector<int> processors;
+        for(int i: read ? parseProcessorList(text) : std::vector<int>())
+        {
+            if(std::find(allowed.begin(), allowed.end(), i) != allowed.end())
+            {
+                processors.push_back(i);
+            }
+        }
+        if(!processors.empty())
+        {
+            nodes.push_back(processors);
+        }
+    }
+    if(nodes.empty() && !allowed.empty())
+    {
+        nodes.push_back(allowed);
+    }
+    return nodes;
+}
+
+/* processors the thread of a band is pinned to, empty for anywhere */
+inline std::vector<int> bandProcessors(AffinityPolicy policy, int band, int numBands)
+{
+    if(policy == AFFINITY_CORES)
+    {
+        std::vector<int> allowed = allowedProcessors();
+        return allowed.empty() ? allowed : std::vector<int>(1, allowed[band % allowed.size()]);
+    }
+    if(policy == AFFINITY_NODES)
+    {
+        std::vector<std::vector<int> > nodes = numaNodes();
+        return nodes.empty() ? std::vector<int>() : nodes[(long long)band * nodes.size() / numBands];
+    }
+    return std::vector<int>();
+}
+
+/* the thread that calls */
+inline std::thread::native_handle_type currentThread()
+{
+#ifdef __linux__
+    return pthread_self();
+#else
+    return std::thread::native_handle_type();
+#endif
+}
+
+/* pin a thread to processors, false if it could not be */
+inline bool pinThread(std::thread::native_handle_type thread, const std::vector<int>& processors)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int i: processors)
+    {
+        CPU_SET(i, &set);
+    }
+    return !processors.empty() && pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#else
+    (void)thread;
+    (void)processors;
+    return false;
+#endif
+}
+
+/* pin the threads of a pool by a policy, band 0 being the calling thread;
+   false with the reason if one could not be pinned */
+inline bool pinThreadPool(ThreadPool& pool, AffinityPolicy policy, std::string& error)
+{
+    if(policy == AFFINITY_NONE)
+    {
+        return true;
+    }
+#ifndef __linux__
+    error = "threads are only pinned on Linux";
+    return false;
+#endif
+    for(int band = 0; band<pool.size(); band++)
+    {
+        std::thread::native_handle_type thread = band == 0 ? currentThread() : pool.worker(band).native_handle();
+        if(!pinThread(thread, bandProcessors(policy, band, pool.size())))
+        {
+            error = "cannot pin the thread of band " + std::to_string(band);
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,125 @@
+
+// Author: 	Stephan Meesters
+//
+// Counting allocations of the main loop
+//
+// After start-up the loops that step and draw a process should not allocate:
+// buffers are sized once, text goes to fixed buffers, and buffers that are
+// swapped between threads are sized alike. Built with
+// CONWAY_COUNT_ALLOCATIONS, the program replaces the global operator new to
+// count every allocation, and an AllocationCheck at the end of every frame
+// aborts when one happened since the last, once a few frames of warm-up are
+// over. The count is of all threads, so the check also sees the pool, the
+// checkpoint writer and the render thread of a pipelined run.
+//
+// Some work allocates by design: the tables of the sparse and HashLife
+// engines grow with the board, resets read pattern files, a checkpoint
+// writes its rule as text. Such work runs in an AllowAllocations scope, its
+// thread is not counted until the scope ends.
+//
+// Without CONWAY_COUNT_ALLOCATIONS nothing is counted and the check does
+// nothing.
+//
+
+#ifndef CONWAY_ALLOCATIONS_H
+#define CONWAY_ALLOCATIONS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+
+#define ALLOCATION_WARMUP_FRAMES 8  // frames after the start that may allocate
+
+#ifdef CONWAY_COUNT_ALLOCATIONS
+
+/* allocations counted since the start */
+inline std::atomic<uint64_t>& allocationCount()
+{
+    static std::atomic<uint64_t> count(0);
+    return count;
+}
+
+/* AllowAllocations scopes the calling thread is in */
+inline int& allowedAllocations()
+{
+    static thread_local int depth = 0;
+    return depth;
+}
+
+/* count an allocation, from the replaced operator new */
+inline void countAllocation()
+{
+    if(allowedAllocations() == 0)
+    {
+        allocationCount().fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#endif
+
+/* lets the calling thread allocate in a scope without being counted */
+class AllowAllocations
+{
+public:
+
+#ifdef CONWAY_COUNT_ALLOCATIONS
+    explicit AllowAllocations(bool allow = true):allow(allow)
+    {
+        allowedAllocations() += allow;
+    }
+
+    ~AllowAllocations()
+    {
+        allowedAllocations() -= allow;
+    }
+#else
+    explicit AllowAllocations(bool = true){}
+#endif
+
+    AllowAllocations(AllowAllocations const&) = delete;
+    AllowAllocations& operator=(AllowAllocations const&) = delete;
+
+#ifdef CONWAY_COUNT_ALLOCATIONS
+private:
+
+    bool allow;
+#endif
+};
+
+/* aborts when a frame after the warm-up allocated */
+class AllocationCheck
+{
+public:
+
+#ifdef CONWAY_COUNT_ALLOCATIONS
+    /* constructor, name is the loop that is checked */
+    explicit AllocationCheck(const char* name):name(name), frames(0), last(allocationCount().load())
+    {
+    }
+
+    /* end of a frame */
+    void frame()
+    {
+        uint64_t count = allocationCount().load(std::memory_order_relaxed);
+        if(++frames > ALLOCATION_WARMUP_FRAMES && count != last)
+        {
+            fprintf(stderr, "%s: %llu allocations in frame %llu\n", name, (unsigned long long)(count - last),
+                    (unsigned long long)frames);
+            abort();
+        }
+        last = count;
+    }
+
+private:
+
+    const char* name;
+    uint64_t frames;    // frames since the start
+    uint64_t last;      // allocations counted at the end of the last frame
+#else
+    explicit AllocationCheck(const char*){}
+    void frame(){}
+#endif
+};
+
+#endif
@@ -0,0 +1,204 @@
+
+// Author: 	Stephan Meesters
+//
+// Benchmark suite for the Game of Life processes
+//
+// Every case runs update() of one backend on a square grid of a given size
+// and density, or step() of STEP_DEPTH generations for the byte_step cases. A case is repeated a number of times after a warm-up, each
+// repetition timing enough generations to last at least the minimum time,
+// and the median cells/second over the repetitions is reported.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "conway.h"
+#include "bitlife.h"
+#include "sparse.h"
+#include "changelist.h"
+#include "affinity.h"
+
+#define REPETITIONS_DEFAULT 5
+#define MIN_TIME_DEFAULT 0.1    // seconds per repetition
+#define MAX_SIZE_DEFAULT 16384
+
+/* benchmark settings from the command line */
+struct BenchmarkSettings
+{
+    BenchmarkSettings():repetitions(REPETITIONS_DEFAULT), minTime(MIN_TIME_DEFAULT),
+        maxSize(MAX_SIZE_DEFAULT), threads(1), affinity(AFFINITY_NONE), hugePages(false), filter(nullptr){}
+
+    int repetitions;
+    double minTime;
+    int maxSize;
+    int threads;
+    AffinityPolicy affinity;    // where the threads of the pool are pinned
+    bool hugePages;             // back large grids with transparent huge pages
+    const char* filter;     // only run cases whose name contains this
+};
+
+/* time advancing a process depth generations at a time, return the median cells per second */
+template <class Process>
+double measure(Process& conway, int size, int depth, const BenchmarkSettings& settings)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // warm-up, also tells how many generations fill the minimum time
+    long long generations = 1;
+    while(1)
+    {
+        Clock::time_point start = Clock::now();
+        for(long long g = 0; g<generations; g++)
+        {
+            advance(conway, depth);
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if(elapsed >= settings.minTime || generations >= (1LL << 30))
+        {
+            break;
+        }
+        generations *= 2;
+    }
+
+    std::vector<double> rates;
+    for(int r = 0; r<settings.repetitions; r++)
+    {
+        Clock::time_point start = Clock::now();
+        for(long long g = 0; g<generations; g++)
+        {
+            advance(conway, depth);
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        rates.push_back((double)size * size * generations * depth / elapsed);
+    }
+    std::sort(rates.begin(), rates.end());
+    return rates[rates.size()/2];
+}
+
+/* run one case and print its result line */
+template <class Process>
+void runCase(const std::string& name, Process& conway, int size, short sparseness, const BenchmarkSettings& settings, int depth = 1)
+{
+    conway.randomInitialization(sparseness);
+    double rate = measure(conway, size, depth, settings);
+    printf("%-40s %14.3e cells/s\n", name.c_str(), rate);
+    fflush(stdout);
+}
+
+/* does a case pass the name filter */
+bool selected(const std::string& name, const BenchmarkSettings& settings)
+{
+    return settings.filter == nullptr || name.find(settings.filter) != std::string::npos;
+}
+
+/* Main entry point */
+int main(int argc, char *argv[])
+{
+    BenchmarkSettings settings;
+    for(int i = 1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--filter") == 0 && i+1 < argc)
+        {
+            settings.filter = argv[++i];
+        }
+        else if(strcmp(argv[i], "--repetitions") == 0 && i+1 < argc)
+        {
+            settings.repetitions = std::max(1, atoi(argv[++i]));
+        }
+        else if(strcmp(argv[i], "--min-time") == 0 && i+1 < argc)
+        {
+            settings.minTime = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--max-size") == 0 && i+1 < argc)
+        {
+            settings.maxSize = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+        {
+            settings.threads = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--pin") == 0 && i+1 < argc && parseAffinity(argv[i+1], settings.affinity))
+        {
+            i++;
+        }
+        else if(strcmp(argv[i], "--huge-pages") == 0)
+        {
+            settings.hugePages = true;
+        }
+        else
+        {
+            printf("usage: ConwayBenchmark [--filter name] [--repetitions N] [--min-time seconds] [--max-size N] [--threads N] [--pin none|cores|nodes] [--huge-pages]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool pool(settings.threads);
+    std::string error;
+    if(!pinThreadPool(pool, settings.affinity, error))
+    {
+        printf("%s\n", error.c_str());
+        return EXIT_FAILURE;
+    }
+    gridHugePages() = settings.hugePages;
+    const short sparsenesses[] = {1, 2, 9};     // densities of 1/2, 1/3 and 1/10
+    std::vector<LifeRowKernel<ConwayRule> > kernels = availableLifeRowKernels<ConwayRule>();
+
+    printf("%-40s %14s\n", "case", "median");
+    for(int size = 64; size <= settings.maxSize; size *= 4)
+    {
+        for(short sparseness: sparsenesses)
+        {
+            char suffix[64];
+            snprintf(suffix, sizeof(suffix), "/%d/density:1/%d/threads:%d", size, sparseness+1, pool.size());
+
+            for(auto const& kernel: kernels)
+            {
+                std::string name = std::string("byte_") + kernel.name + suffix;
+                if(selected(name, settings))
+                {
+                    Conway<char> conway(size, size);
+                    conway.setThreadPool(&pool);
+                    conway.setRowKernel(kernel.name);
+                    runCase(name, conway, size, sparseness, settings);
+                }
+            }
+
+            std::string name = std::string("byte_step") + suffix;
+            if(selected(name, settings))
+            {
+                Conway<char> conway(size, size);
+                conway.setThreadPool(&pool);
+                runCase(name, conway, size, sparseness, settings, STEP_DEPTH);
+            }
+
+            name = std::string("bit") + suffix;
+            if(selected(name, settings))
+            {
+                BitConway<> conway(size, size);
+                conway.setThreadPool(&pool);
+                runCase(name, conway, size, sparseness, settings);
+            }
+
+            name = std::string("changes") + suffix;
+            if(selected(name, settings))
+            {
+                ChangeListLife<> conway(size, size);
+                runCase(name, conway, size, sparseness, settings);
+            }
+
+            name = std::string("sparse") + suffix;
+            if(selected(name, settings))
+            {
+                SparseLife conway(size, size);
+                conway.setThreadPool(&pool);
+                runCase(name, conway, size, sparseness, settings);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,385 @@
+
+// Author: 	Stephan Meesters
+//
+// Bit-packed Game of Life process
+//
+// Cells are stored 64 to a uint64_t word, cell x of a row in bit x%64 of
+// word x/64. A generation is computed a word at a time: the eight neighbours
+// of all 64 cells are summed with bit-sliced full adders, so every bit
+// position of the adder outputs holds the neighbour count of one cell.
+//
+// B3/S23 only needs to know whether the count is 2, 3 or more; other rules
+// take the full count as four bit planes and match it against every count
+// they use, which a compile-time rule unrolls to a fixed set of masks.
+//
+
+#ifndef CONWAY_BITLIFE_H
+#define CONWAY_BITLIFE_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "rule.h"
+#include "random.h"
+
+/* add three one-bit numbers in every bit position */
+inline void fullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry)
+{
+    uint64_t ab = a ^ b;
+    sum = ab ^ c;
+    carry = (a & b) | (ab & c);
+}
+
+/* next state of 64 cells from their row above (a), own row (b) and row below (c),
+   each given shifted west (w), unshifted and shifted east (e) */
+inline uint64_t lifeWord(uint64_t aw, uint64_t a, uint64_t ae,
+                         uint64_t bw, uint64_t b, uint64_t be,
+                         uint64_t cw, uint64_t c, uint64_t ce)
+{
+    // counts per row: above and below have three neighbours, the own row two
+    uint64_t aOnes, aTwos, cOnes, cTwos;
+    fullAdd(aw, a, ae, aOnes, aTwos);
+    fullAdd(cw, c, ce, cOnes, cTwos);
+    uint64_t bOnes = bw ^ be;
+    uint64_t bTwos = bw & be;
+
+    // add the rows: count = s0 + 2*s1 + 4*(s2 or more)
+    uint64_t s0, k1, t1, t2;
+    fullAdd(aOnes, bOnes, cOnes, s0, k1);
+    fullAdd(aTwos, bTwos, cTwos, t1, t2);
+    uint64_t s1 = t1 ^ k1;
+    uint64_t s2 = t2 | (t1 & k1);
+
+    // alive with 3 neighbours, or with 2 neighbours if alive already
+    return ~s2 & s1 & (s0 | b);
+}
+
+/* neighbour counts of 64 cells as bit planes, count = n0 + 2*n1 + 4*n2 + 8*n3 */
+inline void neighbourCounts(uint64_t aw, uint64_t a, uint64_t ae,
+                            uint64_t bw, uint64_t be,
+                            uint64_t cw, uint64_t c, uint64_t ce,
+                            uint64_t& n0, uint64_t& n1, uint64_t& n2, uint64_t& n3)
+{
+    uint64_t aOnes, aTwos, cOnes, cTwos;
+    fullAdd(aw, a, ae, aOnes, aTwos);
+    fullAdd(cw, c, ce, cOnes, cTwos);
+    uint64_t bOnes = bw ^ be;
+    uint64_t bTwos = bw & be;
+    uint64_t k1, t1, t2;
+    fullAdd(aOnes, bOnes, cOnes, n0, k1);
+    fullAdd(aTwos, bTwos, cTwos, t1, t2);
+    n1 = t1 ^ k1;
+    uint64_t k2 = t1 & k1;
+    n2 = t2 ^ k2;
+    n3 = t2 & k2;
+}
+
+/* cells whose count equals k */
+inline uint64_t countIs(int k, uint64_t n0, uint64_t n1, uint64_t n2, uint64_t n3)
+{
+    return (k & 1 ? n0 : ~n0) & (k & 2 ? n1 : ~n1) & (k & 4 ? n2 : ~n2) & (k & 8 ? n3 : ~n3);
+}
+
+/* cells whose count is K or above and makes them live by compile-time rule R,
+   unrolled so that only the counts the rule uses are matched */
+template <class R, int K>
+struct RuleWord
+{
+    static uint64_t match(uint64_t b, uint64_t n0, uint64_t n1, uint64_t n2, uint64_t n3)
+    {
+        uint64_t rest = RuleWord<R, K+1>::match(b, n0, n1, n2, n3);
+        const bool born = (R::birth >> K) & 1, kept = (R::survival >> K) & 1;
+        if(!born && !kept)
+        {
+            return rest;
+        }
+        uint64_t count = countIs(K, n0, n1, n2, n3);
+        return rest | (born && kept ? count : born ? ~b & count : b & count);
+    }
+};
+
+template <class R>
+struct RuleWord<R, RULE_COUNTS>
+{
+    static uint64_t match(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t)
+    {
+        return 0;
+    }
+};
+
+/* next state of 64 cells by a compile-time rule, from the same inputs */
+template <class R>
+inline uint64_t lifeWord(const R&,
+                         uint64_t aw, uint64_t a, uint64_t ae,
+                         uint64_t bw, uint64_t b, uint64_t be,
+                         uint64_t cw, uint64_t c, uint64_t ce)
+{
+    uint64_t n0, n1, n2, n3;
+    neighbourCounts(aw, a, ae, bw, be, cw, c, ce, n0, n1, n2, n3);
+    return RuleWord<R, 0>::match(b, n0, n1, n2, n3);
+}
+
+/* a rule known only at runtime: match the counts it uses */
+inline uint64_t lifeWord(const DynamicRule& rule,
+                         uint64_t aw, uint64_t a, uint64_t ae,
+                         uint64_t bw, uint64_t b, uint64_t be,
+                         uint64_t cw, uint64_t c, uint64_t ce)
+{
+    uint64_t n0, n1, n2, n3;
+    neighbourCounts(aw, a, ae, bw, be, cw, c, ce, n0, n1, n2, n3);
+    uint64_t born = 0, kept = 0;
+    for(int k = 0; k<RULE_COUNTS; k++)
+    {
+        if(((rule.birth | rule.survival) >> k) & 1)
+        {
+            uint64_t count = countIs(k, n0, n1, n2, n3);
+            born |= (rule.birth >> k) & 1 ? count : 0;
+            kept |= (rule.survival >> k) & 1 ? count : 0;
+        }
+    }
+    return (~b & born) | (b & kept);
+}
+
+/* B3/S23 takes the shortcut */
+template <>
+inline uint64_t lifeWord(const ConwayRule&,
+                         uint64_t aw, uint64_t a, uint64_t ae,
+                         uint64_t bw, uint64_t b, uint64_t be,
+                         uint64_t cw, uint64_t c, uint64_t ce)
+{
+    return lifeWord(aw, a, ae, bw, b, be, cw, c, ce);
+}
+
+/* Game of Life process on a bit-packed grid, stepped by rule R */
+template <class R = ConwayRule>
+class BitConway
+{
+public:
+
+    /* constructor */
+    BitConway(int width, int height, const R& rule = R()):
+        newGrid((width + 63) / 64, height), oldGrid((width + 63) / 64, height),
+        gridWidth(width), gridHeight(height), rule(rule), wordsPerRow((width + 63) / 64),
+        lastBit((width - 1) & 63), lastMask(~uint64_t(0) >> (63 - ((width - 1) & 63))), boundary(BOUNDARY_TORUS), pool(nullptr), generations(0)
+    {
+    }
+    ~BitConway(){};
+
+    /* initialize grid with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        newGrid.fill(0);
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                short b = gen();
+                if(b == 0)
+                {
+                    newGrid(i >> 6, j) |= uint64_t(1) << (i & 63);
+                }
+            }
+        }
+        for(int j = 0; j<gridHeight; j++)
+        {
+            std::copy(newGrid.row(j), newGrid.row(j) + wordsPerRow, oldGrid.row(j));
+        }
+        generations = 0;
+    }
+
+    /* fill the grid with random cells of a density in RANDOM_DENSITY_BITS
+       fractional bits, the board of the seed (see random.h), in bands of
+       rows on the thread pool */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        auto fill = [this, key, density](int band, int numBands)
+        {
+            int begin, end;
+            ThreadPool::bandRange(band, numBands, gridHeight, begin, end);
+            for(int j = begin; j<end; j++)
+            {
+                randomRow(key, j, gridWidth, density, newGrid.row(j));
+            }
+        };
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run(fill);
+        }
+        else
+        {
+            fill(0, 1);
+        }
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        newGrid.fill(0);
+        oldGrid.fill(0);
+        generations = 0;
+    }
+
+    /* set a cell, cells outside the grid are ignored */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x < 0 || y < 0 || x >= gridWidth || y >= gridHeight)
+        {
+            return;
+        }
+        uint64_t bit = uint64_t(1) << (x & 63);
+        uint64_t& word = newGrid((int)(x >> 6), (int)y);
+        word = alive ? word | bit : word & ~bit;
+        oldGrid((int)(x >> 6), (int)y) = word;
+    }
+
+    /* set row y from bit-packed words, cell x in bit x%64 of word x/64 */
+    void setRow(int y, const uint64_t* words)
+    {
+        uint64_t* row = newGrid.row(y);
+        std::copy(words, words + wordsPerRow, row);
+        row[wordsPerRow-1] &= lastMask;
+        std::copy(row, row + wordsPerRow, oldGrid.row(y));
+    }
+
+    /* the rule the grid is stepped by */
+    LifeRule lifeRule() const { return rule.lifeRule(); }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* step in parallel bands on a pool of threads, nullptr for single-threaded */
+    void setThreadPool(ThreadPool* threadPool)
+    {
+        pool = threadPool;
+    }
+
+    /* set what lies beyond the edges of the grid */
+    void setBoundaryPolicy(BoundaryPolicy policy)
+    {
+        boundary = policy;
+    }
+
+    /* return a view of the grid */
+    BitGridView fullGrid() const
+    {
+        return BitGridView(newGrid.row(0), gridWidth, gridHeight, newGrid.stride());
+    }
+
+    /* let go of the grid of the previous generation, which the next update
+       only writes over, for a spare one; its cells stay in releasedGrid()
+       until the next call */
+    void releasePreviousGrid()
+    {
+        if(released.width() != wordsPerRow)
+        {
+            released = GridBuffer<uint64_t>(wordsPerRow, gridHeight);
+        }
+        oldGrid.swap(released);
+    }
+
+    /* the grid let go of by releasePreviousGrid() */
+    BitGridView releasedGrid() const
+    {
+        return BitGridView(released.row(0), gridWidth, gridHeight, released.stride());
+    }
+
+    /* main update loop */
+    void update()
+    {
+        // swap old and new grids
+        oldGrid.swap(newGrid);
+
+        // update grid, split in bands of rows when running on a thread pool
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run([this](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, gridHeight, begin, end);
+                updateRows(begin, end);
+            });
+        }
+        else
+        {
+            updateRows(0, gridHeight);
+        }
+        generations++;
+    }
+
+private:
+
+    /* compute the next state of rows [begin, end), one row of words at a time */
+    void updateRows(int begin, int end)
+    {
+        for(int j = begin; j<end; j++)
+        {
+            updateRow(haloRow(j-1), oldGrid.row(j), haloRow(j+1), newGrid.row(j));
+        }
+    }
+
+    /* row y of the old grid, rows outside the grid follow the boundary policy */
+    const uint64_t* haloRow(int y) const
+    {
+        if(y >= 0 && y < gridHeight)
+        {
+            return oldGrid.row(y);
+        }
+        int src = haloSource(y, gridHeight, boundary);
+        return oldGrid.row(src < 0 ? -1 : src);     // the padding row is all dead
+    }
+
+    /* cell x of a row, cells outside the grid follow the boundary policy */
+    uint64_t haloCell(const uint64_t* r, int x) const
+    {
+        int src = haloSource(x, gridWidth, boundary);
+        return src < 0 ? 0 : (r[src >> 6] >> (src & 63)) & 1;
+    }
+
+    /* compute the next state of one row */
+    void updateRow(const uint64_t* a, const uint64_t* b, const uint64_t* c, uint64_t* out)
+    {
+        // cells just outside both ends of the rows
+        uint64_t aWest = haloCell(a, -1), bWest = haloCell(b, -1), cWest = haloCell(c, -1);
+        uint64_t aEast = haloCell(a, gridWidth) << lastBit;
+        uint64_t bEast = haloCell(b, gridWidth) << lastBit;
+        uint64_t cEast = haloCell(c, gridWidth) << lastBit;
+
+        for(int i = 0; i<wordsPerRow; i++)
+        {
+            // carries shifted in from the neighbouring words; bits past the
+            // grid width are zero, so only the halo cell enters the last word
+            uint64_t aw = i > 0 ? a[i-1] >> 63 : aWest;
+            uint64_t bw = i > 0 ? b[i-1] >> 63 : bWest;
+            uint64_t cw = i > 0 ? c[i-1] >> 63 : cWest;
+            uint64_t ae = i < wordsPerRow-1 ? a[i+1] << 63 : aEast;
+            uint64_t be = i < wordsPerRow-1 ? b[i+1] << 63 : bEast;
+            uint64_t ce = i < wordsPerRow-1 ? c[i+1] << 63 : cEast;
+            out[i] = lifeWord(rule, (a[i] << 1) | aw, a[i], (a[i] >> 1) | ae,
+                                    (b[i] << 1) | bw, b[i], (b[i] >> 1) | be,
+                                    (c[i] << 1) | cw, c[i], (c[i] >> 1) | ce);
+        }
+        out[wordsPerRow-1] &= lastMask;     // keep the bits past the width clear
+    }
+
+    GridBuffer<uint64_t> newGrid;
+    GridBuffer<uint64_t> oldGrid;
+    GridBuffer<uint64_t> released;      // of a past generation, empty until releasePreviousGrid()
+
+    int gridWidth, gridHeight;
+    R rule;
+    int wordsPerRow;
+    int lastBit;        // bit of the last cell in the last word of a row
+    uint64_t lastMask;  // valid bits of the last word of a row
+    BoundaryPolicy boundary;
+    ThreadPool* pool;
+    uint64_t generations;
+};
+
+#endif
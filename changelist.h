@@ -0,0 +1,333 @@
+// Author: 	Stephan Meesters
+//
+// Game of Life process that only visits the cells that can change
+//
+// Most cells of a settled board see the same neighbours generation after
+// generation. ChangeListLife keeps the live neighbour count of every cell
+// between generations, and a list of the cells whose state or count changed
+// in the last one. Only those cells can change in the next generation: a cell
+// whose state and count are what they were did not flip the last time, so it
+// will not now either. A generation evaluates the listed cells, and every
+// cell that flips adds or subtracts one from the counts of its neighbours and
+// lists them for the next. The work follows the activity of the board rather
+// than its area.
+//
+// The boundary policy is folded into a table per axis of the cells that see a
+// row or column as a neighbour, with how many times: a wrapped or mirrored
+// edge is seen twice by the cells next to it. The first generation after the
+// cells were set, and after any change of policy, counts every cell anew.
+//
+// Counts take four bits of a byte, the fifth marks a cell that is already in
+// the list, so that it is listed once, and the sixth a cell on an edge of the
+// grid, whose neighbours are looked up in the tables; the others reach their
+// eight neighbours at fixed offsets. Cells are indexed by their place in the
+// rows of the grid buffer. With the two lists of cell indices a cell costs
+// ten bytes, and a board holds fewer than 2^32 cells. Generations are
+// computed on the calling thread.
+//
+
+#ifndef CONWAY_CHANGELIST_H
+#define CONWAY_CHANGELIST_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+#include "rule.h"
+#include "random.h"
+
+#define CHANGE_COUNT_MASK 0x0f      // live neighbours of a cell, 0 to 8
+#define CHANGE_LISTED 0x10          // the cell is in the list of the next generation
+#define CHANGE_EDGE 0x20            // the cell is on an edge of the grid
+
+/* Game of Life process of byte cells stepped by rule R, visiting the cells
+   whose state or neighbours changed */
+template <class R = ConwayRule>
+class ChangeListLife
+{
+public:
+
+    static_assert(R::binary, "the change list holds two states");
+
+    /* constructor */
+    ChangeListLife(int width, int height, const R& rule = R()):cells(width, height),
+        counts((std::size_t)height * cells.stride()), gridWidth(width), gridHeight(height),
+        stride((uint32_t)cells.stride()), rule(rule), boundary(BOUNDARY_TORUS), recount(true), generations(0)
+    {
+        // every cell is listed at most once, the lists never grow
+        listed.reserve((std::size_t)width * height);
+        next.reserve((std::size_t)width * height);
+        mapNeighbours();
+    }
+
+    /* initialize grid with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                cells(i,j) = gen() == 0;
+            }
+        }
+        recount = true;
+        generations = 0;
+    }
+
+    /* fill the grid with random cells of a density in RANDOM_DENSITY_BITS
+       fractional bits, the board of the seed (see random.h) */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        for(int j = 0; j<gridHeight; j++)
+        {
+            randomRow(key, j, gridWidth, density, cells.row(j));
+        }
+        recount = true;
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        cells.fill(0);
+        recount = true;
+        generations = 0;
+    }
+
+    /* set a cell, cells outside the grid are ignored */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x >= 0 && y >= 0 && x < gridWidth && y < gridHeight)
+        {
+            cells((int)x, (int)y) = alive;
+            recount = true;
+        }
+    }
+
+    /* set row y from bit-packed words, cell x in bit x%64 of word x/64; a
+       single plane, the cells have two states */
+    void setRow(int y, const uint64_t* words, int = 1)
+    {
+        char* row = cells.row(y);
+        for(int x = 0; x<gridWidth; x++)
+        {
+            row[x] = char((words[x >> 6] >> (x & 63)) & 1);
+        }
+        recount = true;
+    }
+
+    /* the rule the grid is stepped by */
+    LifeRule lifeRule() const { return rule.lifeRule(); }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* set what lies beyond the edges of the grid */
+    void setBoundaryPolicy(BoundaryPolicy policy)
+    {
+        boundary = policy;
+        mapNeighbours();
+        recount = true;
+    }
+
+    /* return a view of the grid */
+    GridView<char> fullGrid() const
+    {
+        return cells.view();
+    }
+
+    /* cells the next generation evaluates */
+    std::size_t activeCells() const
+    {
+        return recount ? (std::size_t)gridWidth * gridHeight : listed.size();
+    }
+
+    /* main update loop */
+    void update()
+    {
+        if(recount)
+        {
+            countAll();
+        }
+
+        // decide every listed cell from the counts before any of them flips;
+        // the cells that flip are kept at the front of the list
+        char* state = cells.row(0);
+        std::size_t flips = 0;
+        for(std::size_t k = 0; k<listed.size(); k++)
+        {
+            uint32_t i = listed[k];
+            counts[i] &= ~CHANGE_LISTED;
+            int alive = state[i];
+            if(rule.next(alive, counts[i] & CHANGE_COUNT_MASK) != alive)
+            {
+                listed[flips++] = i;
+            }
+        }
+
+        // flip them, which lists them and their neighbours for the next one
+        for(std::size_t k = 0; k<flips; k++)
+        {
+            uint32_t i = listed[k];
+            state[i] ^= 1;
+            addNeighbour(i, state[i] ? 1 : -1);
+            list(i);
+        }
+        listed.swap(next);
+        next.clear();
+        generations++;
+    }
+
+private:
+
+    /* the cells of an axis that see a row or column as a neighbour, and how
+       many of their three neighbouring rows or columns it is */
+    struct Seen
+    {
+        int count;
+        int cell[3];
+        int times[3];
+    };
+
+    /* who sees whom along one axis of n cells under the boundary policy; a
+       cell sees the cells d = -1, 0, 1 away, from the halo beyond an edge */
+    void mapAxis(int n, std::vector<Seen>& seen) const
+    {
+        seen.assign(n, Seen());
+        for(int t = 0; t<n; t++)
+        {
+            for(int d = -1; d<=1; d++)
+            {
+                int s = t+d >= 0 && t+d < n ? t+d : haloSource(t+d, n, boundary);
+                if(s < 0)
+                {
+                    continue;
+                }
+                Seen& by = seen[s];
+                int k = 0;
+                while(k < by.count && by.cell[k] != t)
+                {
+                    k++;
+                }
+                if(k == by.count)
+                {
+                    // only cells next to s or on an edge, at most three
+                    by.cell[by.count] = t;
+                    by.times[by.count++] = 0;
+                }
+                by.times[k]++;
+            }
+        }
+    }
+
+    void mapNeighbours()
+    {
+        mapAxis(gridWidth, seenColumns);
+        mapAxis(gridHeight, seenRows);
+    }
+
+    /* put a cell in the list of the next generation, once */
+    void list(uint32_t i)
+    {
+        if(!(counts[i] & CHANGE_LISTED))
+        {
+            counts[i] |= CHANGE_LISTED;
+            next.push_back(i);
+        }
+    }
+
+    /* add delta to the counts of the cells that see cell i, and list them */
+    void addNeighbour(uint32_t i, int delta)
+    {
+        if(!(counts[i] & CHANGE_EDGE))
+        {
+            const uint32_t neighbours[8] = {i - stride - 1, i - stride, i - stride + 1, i - 1,
+                                            i + 1, i + stride - 1, i + stride, i + stride + 1};
+            for(uint32_t j: neighbours)
+            {
+                counts[j] = (uint8_t)(counts[j] + delta);
+                list(j);
+            }
+            return;
+        }
+        int y = (int)(i / stride), x = (int)(i - (uint32_t)y * stride);
+        const Seen& columns = seenColumns[x];
+        const Seen& rows = seenRows[y];
+        for(int b = 0; b<rows.count; b++)
+        {
+            uint32_t row = (uint32_t)rows.cell[b] * stride;
+            for(int a = 0; a<columns.count; a++)
+            {
+                // the 3x3 block of a cell includes itself, which is no neighbour
+                int times = rows.times[b] * columns.times[a] - (rows.cell[b] == y && columns.cell[a] == x);
+                if(times != 0)
+                {
+                    uint32_t j = row + columns.cell[a];
+                    counts[j] = (uint8_t)(counts[j] + delta * times);
+                    list(j);
+                }
+            }
+        }
+    }
+
+    /* count the neighbours of every cell from scratch and list them all */
+    void countAll()
+    {
+        const char* state = cells.row(0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for(int y = 0; y<gridHeight; y++)
+        {
+            for(int x = 0; x<gridWidth; x++)
+            {
+                bool edge = x == 0 || y == 0 || x == gridWidth-1 || y == gridHeight-1;
+                counts[(uint32_t)y * stride + x] = edge ? CHANGE_EDGE : 0;
+            }
+        }
+        for(int y = 0; y<gridHeight; y++)
+        {
+            for(int x = 0; x<gridWidth; x++)
+            {
+                uint32_t i = (uint32_t)y * stride + x;
+                if(state[i])
+                {
+                    addNeighbour(i, 1);
+                }
+            }
+        }
+        next.clear();
+        for(int y = 0; y<gridHeight; y++)
+        {
+            for(int x = 0; x<gridWidth; x++)
+            {
+                uint32_t i = (uint32_t)y * stride + x;
+                counts[i] |= CHANGE_LISTED;
+                next.push_back(i);
+            }
+        }
+        listed.swap(next);
+        next.clear();
+        recount = false;
+    }
+
+    GridBuffer<char> cells;
+    std::vector<uint8_t> counts;        // live neighbours and the flags, per cell
+    std::vector<uint32_t> listed;       // cells the next generation evaluates, y*stride + x
+    std::vector<uint32_t> next;         // cells listed for the generation after it
+
+    int gridWidth, gridHeight;
+    uint32_t stride;                    // cells per row of the grid buffer
+    R rule;
+    BoundaryPolicy boundary;
+    std::vector<Seen> seenColumns;      // cells that see column x, per column
+    std::vector<Seen> seenRows;         // cells that see row y, per row
+    bool recount;                       // the cells were set, every count is recomputed
+    uint64_t generations;
+};
+
+#endif
@@ -5,20 +5,48 @@
 //
 // Implementation of Conway's Game of Life using C++ (STD11) and SDL
 //
-// Possible improvements: allocate std::vector<std::vector<T>> on heap,
-//                        use multi-threading with std::shared_ptr
-//
 
 #include <iostream>
 #include <cstdlib>
 #include <stdlib.h>
 #include <SDL.h>
 #include <vector>
-#include <tuple>
 #include <cmath>
 #include <random>
 #include <string>
-#include <cstdarg>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <new>
+
+#include "libconway.h"
+#include "conway.h"
+#include "patterns.h"
+#include "pixels.h"
+#include "triplebuffer.h"
+#include "spscqueue.h"
+#include "framepacer.h"
+#include "snapshot.h"
+#include "cycle.h"
+#include "soup.h"
+#include "metrics.h"
+#include "affinity.h"
+#include "allocations.h"
+#include "recorder.h"
+#include "viewport.h"
+#include "pyramid.h"
+#ifdef CONWAY_GPU
+#include "gpulife.h"
+#endif
+#ifdef CONWAY_MPI
+#include "distributed.h"
+#endif
 
 #define WINDOW_WIDTH_DEFAULT 800
 #define WINDOW_HEIGHT_DEFAULT 600
@@ -26,183 +54,120 @@
 #define GRID_HEIGHT_DEFAULT 60
 #define SPARSENESS_DEFAULT 2
 #define FPS_DEFAULT 30
+#define THREADS_DEFAULT 1
+#define GENERATIONS_DEFAULT 1000
+#define CHECKPOINT_EVERY_DEFAULT 1000
+#define DISPLAY_EVERY_DEFAULT 1
+#define HALO_DEPTH_DEFAULT 4
+
+#define COMMAND_QUEUE_SIZE 64       // commands of the window the simulation has not taken yet
+#define SPEED_MAX_GENERATIONS 65536 // generations per update when sped up all the way
+#define SPEED_MAX_INTERVAL 64       // frames between updates when slowed down all the way
+#define SIMULATION_IDLE_MS 1        // sleep of a simulation with nothing to do between looks at its commands
+
+#define COLOR_ALIVE 0xffff0000u     // ARGB8888 pixel of a live cell
+#define COLOR_DEAD 0xff000000u
 
-/* Conway's Game of Life process */
-template <class T>
-class Conway
+#define OVERLAY_SCALE 2             // screen pixels per pixel of the overlay font
+#define OVERLAY_FIRST '%'           // first character of the font
+#define OVERLAY_TEXT_MAX 512        // characters of the overlay text
+
+/* 3x5 font of the overlay from '%' to 'Z', bit 3*row + column of a glyph is
+   set where it is lit; missing characters are blank */
+static const uint16_t overlayFont[] =
 {
-public:
-    
-    typedef std::tuple<short, short> Coord;
-    
-    /* constructor */
-    Conway(int width, int height):gridWidth(width), gridHeight(height)
-    {
-        // allocate std::vectors
-        std::vector<std::vector<T>> grid1(width, std::vector<T>(height, 0));
-        std::vector<std::vector<T>> grid2(width, std::vector<T>(height, 0));
-        newGrid = std::move(grid1);
-        oldGrid = std::move(grid2);
-
-        // define neighbor search coordinates
-        coords.push_back(std::make_tuple(0,1));
-        coords.push_back(std::make_tuple(0,-1));
-        coords.push_back(std::make_tuple(1,0));
-        coords.push_back(std::make_tuple(-1,0));
-        coords.push_back(std::make_tuple(1,1));
-        coords.push_back(std::make_tuple(-1,-1));
-        coords.push_back(std::make_tuple(1,-1));
-        coords.push_back(std::make_tuple(-1,1));
-    }
-    ~Conway(){};
-    
-    /* initialize grid with random values */
-    void randomInitialization(short sparseness)
-    {
-        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
-        for(int i = 0; i<gridWidth; i++)
-        {
-            for(int j = 0; j<gridHeight; j++)
-            {
-                short b = gen();
-                if(b == 0)
-                {
-                    newGrid[i][j] = 1;
-                    oldGrid[i][j] = 1;
-                }
-                else
-                {
-                    newGrid[i][j] = 0;
-                    oldGrid[i][j] = 0;
-                }
-            }
-        }
-    }
+    0x52a5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x05d0, 0x0000, 0x01c0, 0x2000, 0x12a4, 0x7b6f,
+    0x749a, 0x73e7, 0x79a7, 0x49ed, 0x79cf, 0x7bcf, 0x24a7, 0x7bef, 0x79ef, 0x0410, 0x0000, 0x0000,
+    0x0e38, 0x0000, 0x0000, 0x0000, 0x5bea, 0x3aeb, 0x624e, 0x3b6b, 0x72cf, 0x12cf, 0x6b4e, 0x5bed,
+    0x7497, 0x2b24, 0x5aed, 0x7249, 0x5bfd, 0x5b6b, 0x2b6a, 0x12eb, 0x676a, 0x5aeb, 0x388e, 0x2497,
+    0x7b6d, 0x2b6d, 0x5fed, 0x5aad, 0x24ad, 0x72a7,
+};
 
-    /* return a reference of the grid */
-    std::vector< std::vector<T> >& fullGrid()
-    {
-        return newGrid;
-    }
-    
-    /* verify that grid coordinates are within bounds */
-    void verifyCoordBounds(Coord& cc)
+#ifdef CONWAY_COUNT_ALLOCATIONS
+/* the global allocation functions, counted; the array news call these, and
+   the sized and array deletes forward to them, so that every form is
+   replaced together. Not inlined, so the compiler pairs new and delete by
+   name and not by malloc and free */
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    countAllocation();
+    void* p = std::malloc(size != 0 ? size : 1);
+    if(p == nullptr)
     {
-        // reflect coordinates if out of bounds
-        short& x = std::get<0>(cc);
-        short& y = std::get<1>(cc);
-        
-        if(x < 0)
-        {
-            x = gridWidth-1 + x;
-        }
-        else if(x >= gridWidth)
-        {
-            x = x % gridWidth;
-        }
-        if(y < 0)
-        {
-            y = gridHeight-1 + y;
-        }
-        else if(y >= gridHeight)
-        {
-            y = y % gridHeight;
-        }
+        throw std::bad_alloc();
     }
+    return p;
+}
 
-    /* read a pixel in the grid */
-    T readGrid(Coord& cc)
-    {
-        return oldGrid[std::get<0>(cc)][std::get<1>(cc)];
-    }
+__attribute__((noinline)) void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    countAllocation();
+    return std::malloc(size != 0 ? size : 1);
+}
 
-    /* write a pixel in the grid */
-    void writeGrid(Coord& cc, T val)
-    {
-        newGrid[std::get<0>(cc)][std::get<1>(cc)] = val;
-    }
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
 
-    /* main update loop */
-    void update()
-    {
-        // swap old and new grids
-        oldGrid.swap(newGrid);
+__attribute__((noinline)) void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
 
-        // update grid
-        for(int i = 0; i<this->gridWidth; i++)
-        {
-            for(int j =0; j<this->gridHeight; j++)
-            {
-                Coord idx = std::make_tuple(i,j);
-                short numLiveNeighbors = 0;
-                T isAlive = readGrid(idx);
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
 
-                // calculate number of neighbors
-                for(auto const& cc: coords)
-                {
-                    Coord nIdx = std::make_tuple(i+std::get<0>(cc), j+std::get<1>(cc));
-                    verifyCoordBounds(nIdx);    // verify neighbor coordinates
-                                                // use mirroring of out of bounds
-                    if(readGrid(nIdx) == 1)
-                    {
-                        numLiveNeighbors++;
-                    }
-                }
-                
-                // Algorithm:
-                // Any live cell with two or three live neighbours survives.
-                if(isAlive && (numLiveNeighbors == 2 || numLiveNeighbors == 3))
-                {
-                    writeGrid(idx,1);
-                }
-                
-                // Any dead cell with three live neighbours becomes a live cell.
-                else if(!isAlive && numLiveNeighbors == 3)
-                {
-                    writeGrid(idx,1);
-                }
-                
-                // All other live cells die in the next generation.
-                else if(isAlive)
-                {
-                    writeGrid(idx,0);
-                }
-                
-                // Similarly, all other dead cells stay dead.
-                else
-                {
-                    writeGrid(idx,0);
-                }
-            }
-        }
-    }
-                          
-private:
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
 
-    std::vector<Coord> coords;
-    std::vector< std::vector<T> > newGrid;
-    std::vector< std::vector<T> > oldGrid;
+__attribute__((noinline)) void operator delete[](void* p, std::size_t) noexcept
+{
+    operator delete[](p);
+}
+#endif
 
-    int gridWidth, gridHeight;
+/* what the window asks of the simulation */
+enum CommandType
+{
+    COMMAND_RESET,          // seed the board again
+    COMMAND_PAUSE,          // stop or resume stepping
+    COMMAND_STEP,           // pause and advance a single generation
+    COMMAND_FASTER,         // twice the generations per update
+    COMMAND_SLOWER,         // half of them, or twice the frames between updates below one
+    COMMAND_RULE            // step by another rule from now on
+};
+
+struct Command
+{
+    CommandType type;
+    LifeRule rule;          // of COMMAND_RULE
+};
+
+/* commands from the thread of the window to the one that steps the grid */
+typedef SpscQueue<Command, COMMAND_QUEUE_SIZE> CommandQueue;
+
+/* rules picked by the number keys, of two states so that every grid takes them */
+static const LifeRule keyRules[] =
+{
+    ConwayRule::lifeRule(), HighLifeRule::lifeRule(), DayAndNightRule::lifeRule(), SeedsRule::lifeRule(),
 };
 
 /* GUI class */
 class GUI
 {
 public:
-    
-    enum CallbackType
-    {
-        CALLBACK_NOACTION,
-        CALLBACK_QUIT,
-        CALLBACK_RESET
-    };
 
-    /* create a new window of a certain size */
-	static GUI* createWithDimensions(int width, int height)
+    /* create a new window of a certain size, with an OpenGL context instead
+       of a renderer when openGL is set; a hidden one only holds the context */
+	static GUI* createWithDimensions(int width, int height, bool openGL = false, bool hidden = false)
 	{
 		GUI *pRet = new (std::nothrow) GUI();
-		if (pRet && pRet->initWithSize(width, height)) {
+		if (pRet && pRet->initWithSize(width, height, openGL, hidden)) {
 			m_pInstance = pRet;
 			return pRet;
 		}
@@ -214,73 +179,244 @@ public:
 		return nullptr;
 	}
 
-    /* listen to quit of keyboard eventss */
-	CallbackType pollEvents()
+    /* listen to quit and keyboard events, false once the window is closed;
+       the keys of the simulation are queued as commands, a key press is
+       dropped when the queue is full. The wheel zooms, dragging pans */
+	bool pollEvents(CommandQueue& commands)
 	{
         while( SDL_PollEvent( &event ) != 0 )
         {
             switch (event.type)
             {
                 case SDL_QUIT:
-                    return CALLBACK_QUIT;
+                    return false;
                     
                 case SDL_KEYDOWN:
-                    if(event.key.keysym.sym == SDLK_r)
+                {
+                    Command command;
+                    if(keyCommand(event.key.keysym.sym, command))
+                    {
+                        commands.push(command);
+                    }
+                    else
+                    {
+                        moveView(event.key.keysym.sym);
+                    }
+                    break;
+                }
+
+                case SDL_MOUSEWHEEL:
+                {
+                    int x, y;
+                    SDL_GetMouseState(&x, &y);
+                    view.zoom(std::pow(VIEWPORT_ZOOM_STEP, -event.wheel.y), x, y);
+                    break;
+                }
+
+                case SDL_MOUSEMOTION:
+                    if(event.motion.state & SDL_BUTTON_LMASK)
                     {
-                        return CALLBACK_RESET;
+                        view.pan(event.motion.xrel, event.motion.yrel);
                     }
                     break;
             }
         }
-		return CALLBACK_NOACTION;
+		return true;
 	}
 
     /* clear the screen */
 	void clear()
 	{
+		if(renderer == nullptr)
+		{
+			return;     // the GPU draw covers the whole window
+		}
 		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
 		SDL_RenderClear(renderer);	    
 	}
 
-    /* draw all pixels */
-	template <class T>
-	void drawGrid(std::vector< std::vector<T> >& grid, int width, int height)
+    /* draw the cells in view, of a GridView or BitGridView; without a list
+       of changes, the blocks in view are recounted whenever the cells
+       changed or the view moved, and else shown from the texture again */
+	template <class View>
+	void drawGrid(const View& grid, bool changed = true)
 	{
-		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-		for(int i = 0; i < width; i++)
+		int level = prepareView(grid);
+		if(level < 0)
 		{
-			for(int j = 0; j<height; j++)
+			return;
+		}
+		if(changed || !textureValid)
+		{
+			if(level >= PYRAMID_BASE_LEVEL)
 			{
-				if(grid[i][j] == 1)
-				{
-					SDL_RenderDrawPoint(renderer, i, j);
-				}
+				int side = 1 << level;
+				pyramid.update(grid, texelX * side, texelY * side, std::min((texelX + texelsWide) * side, grid.width()),
+				               std::min((texelY + texelsHigh) * side, grid.height()), level);
+				pyramidValid = false;   // only the blocks in view are
+			}
+			uploadTexels(grid, level, 0, 0, texelsWide, texelsHigh);
+			textureValid = true;
+		}
+		copyView(level);
+	}
+
+    /* draw the cells in view of a GridView, the texture and the pyramid keep
+       the tiles that did not change; count tiles, tile t lies at column
+       t % tileColumns */
+	template <class View>
+	void drawTiles(const View& grid, const int* tiles, std::size_t count, int tileColumns, int tileSize)
+	{
+		int level = prepareView(grid);
+		if(level < 0)
+		{
+			return;
+		}
+		bool pyramidLevel = level >= PYRAMID_BASE_LEVEL;
+		bool allTiles = count == (std::size_t)tileColumns * ((grid.height() + tileSize - 1) / tileSize);
+		if(pyramidLevel && (!pyramidValid || allTiles))
+		{
+			pyramid.update(grid);
+			pyramidValid = true;
+		}
+		else if(!pyramidLevel)
+		{
+			pyramidValid = false;   // not kept while the cells are drawn
+		}
+		bool redrawn = !textureValid;
+
+		// one run per row of tiles, spanning its leftmost to rightmost
+		// dirty tile; the tiles come sorted by row. A texture drawn anew is
+		// drawn after the pyramid is recounted
+		bool recount = pyramidLevel && !allTiles;
+		for(std::size_t i = 0; i<count && (recount || !redrawn); )
+		{
+			int ty = tiles[i] / tileColumns;
+			int txBegin = tiles[i] % tileColumns, txEnd = txBegin + 1;
+			for(; i<count && tiles[i] / tileColumns == ty; i++)
+			{
+				txEnd = tiles[i] % tileColumns + 1;
+			}
+			int x0 = txBegin * tileSize, y0 = ty * tileSize;
+			int x1 = std::min(txEnd * tileSize, grid.width()), y1 = std::min(y0 + tileSize, grid.height());
+			if(recount)
+			{
+				pyramid.update(grid, x0, y0, x1, y1, pyramid.topLevel());
 			}
+
+			// the texels of the run that are in view
+			int side = 1 << level;
+			int i0 = std::max(x0 / side - texelX, 0), i1 = std::min((x1 + side - 1) / side - texelX, texelsWide);
+			int j0 = std::max(y0 / side - texelY, 0), j1 = std::min((y1 + side - 1) / side - texelY, texelsHigh);
+			if(!redrawn && i0 < i1 && j0 < j1)
+			{
+				uploadTexels(grid, level, i0, j0, i1, j1);
+			}
+		}
+		if(redrawn)
+		{
+			uploadTexels(grid, level, 0, 0, texelsWide, texelsHigh);
+			textureValid = true;
 		}
+		copyView(level);
+	}
+
+#ifdef CONWAY_GPU
+    /* draw the cells of the GPU engine straight from its device buffer */
+	void drawGpu(GpuLife& life)
+	{
+		int width, height;
+		SDL_GL_GetDrawableSize(window, &width, &height);
+		life.draw(width, height, COLOR_ALIVE, COLOR_DEAD);
+	}
+#endif
+
+    /* look up a function of the OpenGL context */
+	static void* glFunction(const char* name)
+	{
+		return SDL_GL_GetProcAddress(name);
 	}
 
     /* show the result to the screen */
 	void present()
 	{
-		SDL_RenderPresent(renderer);
+		if(renderer != nullptr)
+		{
+			SDL_RenderPresent(renderer);
+		}
+		else
+		{
+			SDL_GL_SwapWindow(window);
+		}
 	}
     
-    /* set the pixel scaling ratio's */
-    void setScale(float scaleX, float scaleY)
-    {
-        SDL_RenderSetScale(renderer, scaleX, scaleY);
-    }
-    
     /* set the title of the window */
-    void setWindowTitle(std::string title)
+    void setWindowTitle(const char* title)
     {
-        SDL_SetWindowTitle(window, title.c_str());
+        SDL_SetWindowTitle(window, title);
     }
 
+    /* lay out lines of text for the overlay, one rectangle per lit pixel of
+       the font; drawn at every frame until it is set again */
+	void setOverlay(const char* text)
+	{
+		overlayRects.clear();
+		int column = 0, line = 0, columns = 0;
+		for(const char* c = text; *c != 0; c++)
+		{
+			if(*c == '\n')
+			{
+				column = 0;
+				line++;
+				continue;
+			}
+			int index = toupper((unsigned char)*c) - OVERLAY_FIRST;
+			int glyph = index >= 0 && index < (int)(sizeof(overlayFont) / sizeof(overlayFont[0])) ? overlayFont[index] : 0;
+			for(int bit = 0; bit<15; bit++)
+			{
+				if((glyph >> bit) & 1)
+				{
+					SDL_Rect rect = {(1 + column*4 + bit%3) * OVERLAY_SCALE, (1 + line*6 + bit/3) * OVERLAY_SCALE, OVERLAY_SCALE, OVERLAY_SCALE};
+					overlayRects.push_back(rect);
+				}
+			}
+			columns = std::max(columns, ++column);
+		}
+		overlayBox.x = overlayBox.y = 0;
+		overlayBox.w = (columns*4 + 1) * OVERLAY_SCALE;
+		overlayBox.h = ((line + 1)*6 + 1) * OVERLAY_SCALE;
+	}
+
+    /* draw the overlay over a darkened box, not over the GPU engine which
+       draws without a renderer */
+	void drawOverlay()
+	{
+		if(renderer == nullptr || overlayRects.empty())
+		{
+			return;
+		}
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+		SDL_RenderFillRect(renderer, &overlayBox);
+		SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+		SDL_RenderFillRects(renderer, overlayRects.data(), (int)overlayRects.size());
+	}
+
     /* clean up */
 	~GUI()
 	{
-		SDL_DestroyRenderer(renderer);
+		if(texture != nullptr)
+		{
+			SDL_DestroyTexture(texture);
+		}
+		if(context != nullptr)
+		{
+			SDL_GL_DeleteContext(context);
+		}
+		if(renderer != nullptr)
+		{
+			SDL_DestroyRenderer(renderer);
+		}
     	SDL_DestroyWindow(window);
     	SDL_Quit();
     	m_pInstance = nullptr;
@@ -293,10 +429,191 @@ public:
 
 private:
 
-	GUI(){};
+	GUI():renderer(nullptr), window(nullptr), context(nullptr), texture(nullptr), textureWidth(0), textureHeight(0), textureValid(false),
+		texelLevel(0), texelX(0), texelY(0), texelsWide(0), texelsHigh(0), pyramidValid(false)
+	{
+		// shades of the blocks, from the dead to the alive colour channel by channel
+		for(int d = 0; d<256; d++)
+		{
+			shades[d] = 0;
+			for(int shift = 0; shift<32; shift += 8)
+			{
+				int dead = (COLOR_DEAD >> shift) & 0xff, alive = (COLOR_ALIVE >> shift) & 0xff;
+				shades[d] |= (uint32_t)(dead + (alive - dead) * d / 255) << shift;
+			}
+		}
+	};
+
+    /* the command of a key, false for the others: R resets, P or space
+       pauses, N steps, the brackets change the speed and the number keys
+       pick one of keyRules */
+	static bool keyCommand(SDL_Keycode key, Command& command)
+	{
+		command.rule = LifeRule();
+		switch(key)
+		{
+			case SDLK_r:            command.type = COMMAND_RESET; return true;
+			case SDLK_p:
+			case SDLK_SPACE:        command.type = COMMAND_PAUSE; return true;
+			case SDLK_n:            command.type = COMMAND_STEP; return true;
+			case SDLK_RIGHTBRACKET: command.type = COMMAND_FASTER; return true;
+			case SDLK_LEFTBRACKET:  command.type = COMMAND_SLOWER; return true;
+		}
+		int rules = (int)(sizeof(keyRules) / sizeof(keyRules[0]));
+		if(key >= SDLK_1 && key < SDLK_1 + rules)
+		{
+			command.type = COMMAND_RULE;
+			command.rule = keyRules[key - SDLK_1];
+			return true;
+		}
+		return false;
+	}
+
+    /* move the view by a key, arrows pan, plus and minus zoom around the
+       centre, home shows the whole grid again */
+	void moveView(SDL_Keycode key)
+	{
+		switch(key)
+		{
+			case SDLK_LEFT:    view.pan(VIEWPORT_PAN_STEP, 0); break;
+			case SDLK_RIGHT:   view.pan(-VIEWPORT_PAN_STEP, 0); break;
+			case SDLK_UP:      view.pan(0, VIEWPORT_PAN_STEP); break;
+			case SDLK_DOWN:    view.pan(0, -VIEWPORT_PAN_STEP); break;
+			case SDLK_PLUS:
+			case SDLK_EQUALS:
+			case SDLK_KP_PLUS: view.zoom(1 / VIEWPORT_ZOOM_STEP, screenWidth / 2, screenHeight / 2); break;
+			case SDLK_MINUS:
+			case SDLK_KP_MINUS: view.zoom(VIEWPORT_ZOOM_STEP, screenWidth / 2, screenHeight / 2); break;
+			case SDLK_HOME:    view = Viewport(); break;    // fitted again at the next frame
+		}
+	}
+
+    /* fit the view to a grid it was not fitted to, and find the texels in
+       view at its level of detail; the texture is kept when they did not
+       move. The level, or -1 without a texture */
+	template <class View>
+	int prepareView(const View& grid)
+	{
+		if(!view.fitted(grid.width(), grid.height()))
+		{
+			view.fit(grid.width(), grid.height(), screenWidth, screenHeight);
+			pyramid.resize(grid.width(), grid.height());
+			pyramidValid = false;
+		}
+		// at most two texels per pixel and a partial one on either side
+		if(!useTexture(2*screenWidth + 2, 2*screenHeight + 2))
+		{
+			return -1;
+		}
+		int level = std::min(view.level(), pyramid.topLevel());
+		double side = std::ldexp(1.0, level);
+		int levelWidth = (int)(((long long)grid.width() + (1 << level) - 1) >> level);
+		int levelHeight = (int)(((long long)grid.height() + (1 << level) - 1) >> level);
+		int x0 = (int)std::min(std::max(std::floor(view.x / side), 0.0), (double)levelWidth);
+		int y0 = (int)std::min(std::max(std::floor(view.y / side), 0.0), (double)levelHeight);
+		int x1 = (int)std::min(std::max(std::ceil((view.x + screenWidth * view.scale) / side), 0.0), (double)levelWidth);
+		int y1 = (int)std::min(std::max(std::ceil((view.y + screenHeight * view.scale) / side), 0.0), (double)levelHeight);
+		if(level != texelLevel || x0 != texelX || y0 != texelY || x1 - x0 != texelsWide || y1 - y0 != texelsHigh)
+		{
+			textureValid = false;
+		}
+		texelLevel = level;
+		texelX = x0;
+		texelY = y0;
+		texelsWide = x1 - x0;
+		texelsHigh = y1 - y0;
+		return level;
+	}
+
+    /* make sure there is a streaming texture of a size */
+	bool useTexture(int width, int height)
+	{
+		if(texture != nullptr && textureWidth == width && textureHeight == height)
+		{
+			return true;
+		}
+		if(texture != nullptr)
+		{
+			SDL_DestroyTexture(texture);
+		}
+		texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+		textureValid = false;
+		if(texture == nullptr)
+		{
+			SDL_Log("Unable to create texture: %s", SDL_GetError());
+			textureWidth = textureHeight = 0;
+			return false;
+		}
+		textureWidth = width;
+		textureHeight = height;
+		return true;
+	}
+
+    /* draw texels [i0, i1) x [j0, j1) of the view to the texture, every pixel
+       of the rectangle is written: cells as they are at level 0, blocks as
+       shades between the dead and alive colours above it */
+	template <class View>
+	void uploadTexels(const View& grid, int level, int i0, int j0, int i1, int j1)
+	{
+		SDL_Rect rect = {i0, j0, i1 - i0, j1 - j0};
+		void* pixels;
+		int pitch;
+		if(rect.w <= 0 || rect.h <= 0)
+		{
+			return;
+		}
+		if(SDL_LockTexture(texture, &rect, &pixels, &pitch) != 0)
+		{
+			SDL_Log("Unable to lock texture: %s", SDL_GetError());
+			return;
+		}
+		int side = 1 << level;
+		for(int j = 0; j<rect.h; j++)
+		{
+			uint32_t* out = reinterpret_cast<uint32_t*>(static_cast<char*>(pixels) + j*pitch);
+			int y = texelY + j0 + j;
+			if(level == 0)
+			{
+				rowToPixels(grid, y, texelX + i0, texelX + i1, out, COLOR_ALIVE, COLOR_DEAD);
+			}
+			else if(level < PYRAMID_BASE_LEVEL)
+			{
+				// below the pyramid, counted from the cells
+				int rows = std::min(side, grid.height() - y*side);
+				for(int i = 0; i<rect.w; i++)
+				{
+					int x = (texelX + i0 + i) * side, n = std::min(side, grid.width() - x);
+					int count = 0;
+					for(int k = 0; k<rows; k++)
+					{
+						count += countCells(grid, x, n, y*side + k);
+					}
+					out[i] = shades[count * 255 / (side*side)];
+				}
+			}
+			else
+			{
+				for(int i = 0; i<rect.w; i++)
+				{
+					out[i] = shades[pyramid.density(level, texelX + i0 + i, y)];
+				}
+			}
+		}
+		SDL_UnlockTexture(texture);
+	}
+
+    /* copy the texels in view to the window, scaled to the cells they show */
+	void copyView(int level)
+	{
+		double side = std::ldexp(1.0, level);
+		SDL_Rect source = {0, 0, texelsWide, texelsHigh};
+		SDL_FRect target = {(float)((texelX * side - view.x) / view.scale), (float)((texelY * side - view.y) / view.scale),
+		                    (float)(texelsWide * side / view.scale), (float)(texelsHigh * side / view.scale)};
+		SDL_RenderCopyF(renderer, texture, &source, &target);
+	}
 
     /* initialize the window */
-	bool initWithSize(int width, int height)
+	bool initWithSize(int width, int height, bool openGL, bool hidden)
 	{
 		this->screenWidth = width;
 		this->screenHeight = height;
@@ -306,11 +623,27 @@ private:
 			SDL_Log("Unable to initialize SDL: %s", SDL_GetError());
 			return false;
 		}
+		if(openGL)
+		{
+			// compute shaders need OpenGL 4.3
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+			window = SDL_CreateWindow("Conway's Game of Life", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+			                          width, height, SDL_WINDOW_OPENGL | (hidden ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
+			if(window == nullptr || (context = SDL_GL_CreateContext(window)) == nullptr)
+			{
+				SDL_Log("Unable to create OpenGL context: %s", SDL_GetError());
+				return false;
+			}
+			return true;
+		}
 		if(SDL_CreateWindowAndRenderer(width, height, 0, &window, &renderer) != 0)
 		{
 			SDL_Log("Unable to create window and renderer: %s", SDL_GetError());
 			return false;
 		}
+		overlayRects.reserve(OVERLAY_TEXT_MAX * 15);   // every pixel of every glyph lit
    		return true;
 	}
 
@@ -320,123 +653,1533 @@ private:
 	SDL_Event event;
     SDL_Renderer *renderer;
     SDL_Window *window;
+	SDL_GLContext context;      // instead of the renderer for the GPU engine
+
+	// texels in view at one pixel each, scaled to the window when copied
+	SDL_Texture *texture;
+	int textureWidth, textureHeight;
+	bool textureValid;          // holds the texels in view
+	int texelLevel;             // level of detail of the texels
+	int texelX, texelY;         // first texel in view, in blocks of the level
+	int texelsWide, texelsHigh;
+
+	Viewport view;
+	DensityPyramid pyramid;
+	bool pyramidValid;          // every block is up to date
+	uint32_t shades[256];       // pixel of a block by its density
+
+	std::vector<SDL_Rect> overlayRects;     // lit pixels of the overlay text
+	SDL_Rect overlayBox;
 };
 GUI* GUI::m_pInstance = nullptr;
 
-/* String formatting function for std::string */
-// Taken from:
-// https://stackoverflow.com/questions/2342162/stdstring-formatting-like-sprintf/3742999
-inline std::string format(const char* fmt, ...)
-{
-    int size = 512;
-    char* buffer = 0;
-    buffer = new char[size];
-    va_list vl;
-    va_start(vl, fmt);
-    int nsize = vsnprintf(buffer, size, fmt, vl);
-    if(size<=nsize){ //fail delete buffer and try again
-        delete[] buffer;
-        buffer = 0;
-        buffer = new char[nsize+1]; //+1 for /0
-        nsize = vsnprintf(buffer, size, fmt, vl);
-    }
-    std::string ret(buffer);
-    va_end(vl);
-    delete[] buffer;
-    return ret;
+/* settings from the command line */
+struct Settings
+{
+    Settings():screenWidth(WINDOW_WIDTH_DEFAULT), screenHeight(WINDOW_HEIGHT_DEFAULT),
+        gridWidth(GRID_WIDTH_DEFAULT), gridHeight(GRID_HEIGHT_DEFAULT),
+        sparseness(SPARSENESS_DEFAULT), fps(FPS_DEFAULT), threads(THREADS_DEFAULT),
+        engine("byte"), kernel(nullptr), boundary(BOUNDARY_TORUS),
+        headless(false), generations(GENERATIONS_DEFAULT), hashlifeStep(0), tiles(true),
+        pipeline(-1), rate(0), pattern(nullptr), restore(nullptr), checkpoint(nullptr),
+        checkpointEvery(CHECKPOINT_EVERY_DEFAULT), checkpointCompress(false), displayEvery(DISPLAY_EVERY_DEFAULT),
+        stopOnCycle(false), cycleHistory(CYCLE_HISTORY_DEFAULT), soups(SOUP_LANES), soupSize(SOUP_SIZE_DEFAULT),
+        seed(0), density(0), census(nullptr), metricsLog(nullptr), prometheus(nullptr),
+        metricsEvery(METRICS_INTERVAL_DEFAULT), overlay(false), haloDepth(HALO_DEPTH_DEFAULT),
+        affinity(AFFINITY_NONE), hugePages(false), record(nullptr), recordScale(1),
+        recordThreads(RECORD_THREADS_DEFAULT), ruleText(nullptr),
+        rule(ConwayRule::lifeRule()){}
+
+    int screenWidth, screenHeight;
+    int gridWidth, gridHeight;
+    short sparseness;
+    short fps;
+    int threads;
+    std::string engine;
+    const char* kernel;         // nullptr for the best available
+    BoundaryPolicy boundary;
+    bool headless;              // run without window
+    long long generations;      // generations to run when headless
+    int hashlifeStep;           // HashLife advances 2^hashlifeStep generations per update
+    bool tiles;                 // only recompute tiles near changes
+    int pipeline;               // 1 to simulate on a thread of its own, 0 in the loop of the window, -1 for the engine's default
+    double rate;                // target updates per second when pipelined, 0 for as fast as possible
+    const char* pattern;        // pattern file to start from, nullptr for a random board
+    const char* restore;        // snapshot to start from, takes precedence over the pattern
+    const char* checkpoint;     // file the checkpoints are written to, nullptr for none
+    long long checkpointEvery;  // generations between checkpoints
+    bool checkpointCompress;    // run-length encode the checkpoints
+    int displayEvery;           // generations per update, only every one of them is shown
+    bool stopOnCycle;           // stop once the board repeats an earlier generation
+    int cycleHistory;           // generations compared against, the longest period found
+    long long soups;            // soups run by the soup engine
+    int soupSize;               // side of the random square of a soup
+    uint64_t seed;              // seed of the random board, or of the first soup
+    double density;             // of the random board, 0 for 1/(sparseness+1)
+    const char* census;         // file the soup census is written to, nullptr for none
+    const char* metricsLog;     // file the metrics are appended to as JSON lines, nullptr for none
+    const char* prometheus;     // file replaced with the metrics in the Prometheus format, nullptr for none
+    int metricsEvery;           // milliseconds between metrics reports
+    bool overlay;               // show the metrics over the grid
+    int haloDepth;              // halo cells of the mpi engine, generations per exchange
+    AffinityPolicy affinity;    // where the threads of the pool are pinned
+    bool hugePages;             // back large grids with transparent huge pages
+    const char* record;         // |command or name.png the frames are written to, nullptr for none
+    int recordScale;            // pixels per cell of a recorded frame, in either direction
+    int recordThreads;          // workers that encode the recorded frames
+    const char* ruleText;       // rule as given, read by the library for its engines
+    LifeRule rule;              // of the other engines, and the rule the window starts from
+};
+
+/* is an engine one of libconway, which the viewer steps through its C API */
+inline bool libraryEngine(const std::string& engine)
+{
+    return engine == "byte" || engine == "bit" || engine == "changes" || engine == "sparse" || engine == "hashlife" ||
+           engine == "ltl";
 }
 
-/* Main entry point */
-int main(int argc, char *argv[])
+/* does the window step the simulation on a thread of its own */
+inline bool pipelined(const Settings& settings)
 {
-    // default values
-    int screenWidth = WINDOW_WIDTH_DEFAULT;
-    int screenHeight = WINDOW_HEIGHT_DEFAULT;
-    int gridWidth = GRID_WIDTH_DEFAULT;
-    int gridHeight = GRID_HEIGHT_DEFAULT;
-    short sparseness = SPARSENESS_DEFAULT;
-    short fps = FPS_DEFAULT;
-    
-	// parse arguments, adjust values
-    if(argc == 7)
-    {
-        fps = atoi(argv[6]);
-    }
-    if(argc >= 6)
-    {
-        sparseness = atoi(argv[5]);
-    }
-    if(argc >= 5)
+    return settings.pipeline > 0 && !settings.headless;
+}
+
+/* a finished generation, packed a bit per cell for the screen */
+struct Frame
+{
+    Frame():width(0), height(0), updates(0){}
+
+    std::vector<uint64_t> cells;
+    int width, height;
+    long long updates;          // updates since the last reset
+
+    /* the cells as a view */
+    BitGridView view() const
     {
-        gridWidth = atoi(argv[3]);
-        gridHeight = atoi(argv[4]);
+        return BitGridView(cells.data(), width, height, (width + 63) / 64);
     }
-    if(argc >= 3)
+};
+
+/* pack a GridView or BitGridView into a frame */
+template <class View>
+void fillFrame(Frame& frame, const View& grid, long long updates)
+{
+    int wordsPerRow = (grid.width() + 63) / 64;
+    frame.width = grid.width();
+    frame.height = grid.height();
+    frame.cells.resize((std::size_t)wordsPerRow * frame.height);
+    for(int j = 0; j<frame.height; j++)
     {
-        screenWidth = atoi(argv[1]);
-        screenHeight = atoi(argv[2]);
+        packRow(grid, j, &frame.cells[(std::size_t)j * wordsPerRow]);
     }
-    else
+    frame.updates = updates;
+}
+
+/* a process of libconway, created and stepped through its C API */
+class LibraryProcess
+{
+public:
+
+    LibraryProcess():life(nullptr), pinning(CONWAY_PIN_NONE), stepLog(0), allocates(false), tiles(false){}
+
+    ~LibraryProcess()
     {
-        printf("usage: Conway [window width] [window height] [grid width] [grid height] [sparseness] [fps]\n");
-        printf("e.g.: Conway %d %d %d %d %d %d\n", WINDOW_WIDTH_DEFAULT, WINDOW_HEIGHT_DEFAULT, GRID_WIDTH_DEFAULT, GRID_HEIGHT_DEFAULT, SPARSENESS_DEFAULT, FPS_DEFAULT);
+        conway_destroy(life);
     }
 
-	// create GUI object as singleton
-	auto screen = GUI::createWithDimensions(screenWidth, screenHeight);
-	if(screen == nullptr)
-	{
-		return 0;
-	}
-    screen->setScale(screenWidth/gridWidth, screenHeight/gridHeight);
+    LibraryProcess(LibraryProcess const&) = delete;
+    LibraryProcess& operator=(LibraryProcess const&) = delete;
+
+    /* create the process of the settings, with its checkpoints written by the
+       library and its threads pinned, unless a simulation thread of the
+       window steps it; false if it cannot be */
+    bool open(const Settings& settings)
+    {
+        static const conway_pinning pinnings[] = {CONWAY_PIN_NONE, CONWAY_PIN_CORES, CONWAY_PIN_NODES};
+        pinning = pinnings[settings.affinity];
+        char error[256];
+        conway_use_huge_pages(settings.hugePages);
+        life = conway_create(settings.engine.c_str(), settings.gridWidth, settings.gridHeight, settings.ruleText,
+                             settings.threads, error, sizeof(error));
+        if(life == nullptr)
+        {
+            printf("%s\n", error);
+            return false;
+        }
+        bool bounded = settings.engine != "sparse" && settings.engine != "hashlife";
+        if((!pipelined(settings) && conway_pin_threads(life, pinning) != CONWAY_OK) ||
+           (bounded && conway_set_boundary(life, (conway_boundary)settings.boundary) != CONWAY_OK) ||
+           (settings.engine == "byte" && settings.kernel != nullptr && conway_set_kernel(life, settings.kernel) != CONWAY_OK) ||
+           (settings.engine == "byte" && conway_set_tiles(life, settings.tiles) != CONWAY_OK) ||
+           (settings.checkpoint != nullptr &&
+            conway_set_checkpoints(life, settings.checkpoint, settings.checkpointEvery, settings.checkpointCompress) != CONWAY_OK))
+        {
+            printf("%s\n", conway_error(life));
+            return false;
+        }
+        stepLog = settings.engine == "hashlife" ? std::max(0, std::min(settings.hashlifeStep, 63)) : 0;
+        allocates = !bounded;
+        tiles = settings.engine == "byte";
+        return true;
+    }
+
+    /* pin the threads of the pool, the calling thread with the first band;
+       false if they cannot be */
+    bool pin()
+    {
+        if(conway_pin_threads(life, pinning) != CONWAY_OK)
+        {
+            printf("%s\n", conway_error(life));
+            return false;
+        }
+        return true;
+    }
+
+    conway_life* handle() { return life; }
+
+    uint64_t generation() const { return conway_generation(life); }
+    uint64_t hash() { return conway_hash(life); }
+
+    /* does an update allocate, for the engines whose tables grow with the board */
+    bool allocatesInUpdate() const { return allocates; }
+
+    /* does the engine list the tiles that changed */
+    bool tracksTiles() const { return tiles; }
+
+    /* advance n updates, of 2^stepLog generations each for hashlife */
+    void advance(int n)
+    {
+        for(int i = 0; i<(stepLog == 0 ? 1 : n); i++)
+        {
+            if(conway_step(life, stepLog == 0 ? n : uint64_t(1) << stepLog) != CONWAY_OK)
+            {
+                printf("%s\n", conway_error(life));
+                return;
+            }
+        }
+    }
+
+    /* call f with the view of the cells, a GridView or a BitGridView */
+    template <class F>
+    void withGrid(F f)
+    {
+        conway_view view;
+        conway_get_view(life, &view);
+        if(view.format == CONWAY_CELLS_BITS)
+        {
+            f(BitGridView(static_cast<const uint64_t*>(view.cells), view.width, view.height, view.stride / sizeof(uint64_t)));
+        }
+        else
+        {
+            f(GridView<char>(static_cast<const char*>(view.cells), view.width, view.height, view.stride));
+        }
+    }
+
+private:
+
+    conway_life* life;
+    conway_pinning pinning;
+    int stepLog;                // generations per update of hashlife, as a power of two
+    bool allocates;
+    bool tiles;
+};
+
+/* call f with a view of the cells of a process, a GridView or a BitGridView */
+template <class Process, class F>
+void withGrid(Process& conway, F f)
+{
+    f(conway.fullGrid());
+}
+
+template <class F>
+void withGrid(LibraryProcess& conway, F f)
+{
+    conway.withGrid(f);
+}
+
+/* draw the cells of a process, of the byte engine only the tiles that changed */
+inline void draw(GUI* screen, LibraryProcess& conway)
+{
+    const int* tiles;
+    std::size_t count;
+    int columns, tileSize;
+    if(!conway.tracksTiles() || conway_get_changes(conway.handle(), &tiles, &count, &columns, &tileSize) != CONWAY_OK)
+    {
+        conway.withGrid([screen](const auto& grid){ screen->drawGrid(grid); });
+        return;
+    }
+    conway.withGrid([&](const auto& grid){ screen->drawTiles(grid, tiles, count, columns, tileSize); });
+}
+
+#ifdef CONWAY_GPU
+/* the GPU engine draws from its device buffer */
+inline void draw(GUI* screen, GpuLife& conway)
+{
+    screen->drawGpu(conway);
+}
+#endif
+
+/* wait until an update has finished, for processes that return before that */
+template <class Process>
+void waitForUpdate(Process&)
+{
+}
+
+#ifdef CONWAY_GPU
+inline void waitForUpdate(GpuLife& conway)
+{
+    conway.finish();
+}
+#endif
+
+/* make the update in progress on another thread, and the ones after it,
+   return early until cleared again, for processes that can */
+template <class Process>
+void interruptUpdate(Process&, bool)
+{
+}
+
+inline void interruptUpdate(LibraryProcess& conway, bool interrupt)
+{
+    conway_interrupt(conway.handle(), interrupt);
+}
+
+/* pin the threads that step a process from the thread calling it, false if
+   they cannot be; the viewer pinned the pools of its own engines already */
+template <class Process>
+bool pinUpdates(Process&)
+{
+    return true;
+}
+
+inline bool pinUpdates(LibraryProcess& conway)
+{
+    return conway.pin();
+}
+
+/* advance a process of the library by n updates */
+inline void advance(LibraryProcess& conway, int n)
+{
+    conway.advance(n);
+}
+
+/* does an update allocate, for processes whose tables grow with the board */
+template <class Process>
+bool allocatesInUpdate(const Process&)
+{
+    return false;
+}
+
+inline bool allocatesInUpdate(const LibraryProcess& conway)
+{
+    return conway.allocatesInUpdate();
+}
+
+/* hash of the cells of a process of the library, the same on every engine */
+inline uint64_t processHash(LibraryProcess& conway)
+{
+    return conway.hash();
+}
+
+/* seed a process from the snapshot or pattern file, or with random cells
+   when there is none; every reset draws the board of the next seed */
+template <class Process>
+bool initialize(Process& conway, const Settings& settings, uint64_t resets = 0)
+{
+    std::string error;
+    if(settings.restore != nullptr)
+    {
+        if(!restoreSnapshot(settings.restore, conway, settings.gridWidth, settings.gridHeight, error))
+        {
+            printf("cannot restore %s: %s\n", settings.restore, error.c_str());
+            return false;
+        }
+        return true;
+    }
+    if(settings.pattern == nullptr)
+    {
+        double density = settings.density > 0 ? settings.density : 1.0 / (settings.sparseness + 1);
+        conway.randomFill(settings.seed + resets, randomDensity(density));
+        return true;
+    }
+    if(!loadPattern(settings.pattern, conway, settings.gridWidth, settings.gridHeight, error))
+    {
+        printf("cannot load %s: %s\n", settings.pattern, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool initialize(LibraryProcess& conway, const Settings& settings, uint64_t resets = 0)
+{
+    int result;
+    if(settings.restore != nullptr)
+    {
+        result = conway_restore_snapshot(conway.handle(), settings.restore);
+    }
+    else if(settings.pattern == nullptr)
+    {
+        double density = settings.density > 0 ? settings.density : 1.0 / (settings.sparseness + 1);
+        result = conway_fill_random(conway.handle(), settings.seed + resets, density);
+    }
+    else
+    {
+        result = conway_load_pattern(conway.handle(), settings.pattern);
+    }
+    if(result != CONWAY_OK)
+    {
+        printf("%s\n", conway_error(conway.handle()));
+        return false;
+    }
+    return true;
+}
+
+/* how the window wants the simulation stepped: running or paused, and how
+   many generations an update advances or, slowed down below one, how many
+   frames of the window pass between updates */
+class Control
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    Control(int generations, double fps):running(true), steps(0), generations(generations), interval(1), retimed(false), fresh(false),
+        frame(fps > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)) : Clock::duration::zero()),
+        last(Clock::now()){}
+
+    /* carry out a command on the stepping, false for the commands on the cells */
+    bool apply(const Command& command)
+    {
+        switch(command.type)
+        {
+            case COMMAND_PAUSE:
+                running = !running;
+                steps = 0;
+                return true;
+            case COMMAND_STEP:
+                running = false;
+                steps++;
+                return true;
+            case COMMAND_FASTER:
+                retimed = true;
+                if(interval > 1)
+                {
+                    interval /= 2;
+                }
+                else
+                {
+                    generations = std::min(2 * generations, SPEED_MAX_GENERATIONS);
+                }
+                return true;
+            case COMMAND_SLOWER:
+                retimed = true;
+                if(generations > 1)
+                {
+                    generations /= 2;
+                }
+                else
+                {
+                    interval = std::min(2 * interval, SPEED_MAX_INTERVAL);
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /* generations to advance now, 0 while paused or until the interval
+       between updates has passed; first tells whether they are the first at
+       a new speed or of a renewed process, which may set up buffers of
+       their own */
+    int due(bool& first)
+    {
+        first = false;
+        if(!running)
+        {
+            if(steps == 0)
+            {
+                return 0;
+            }
+            steps--;
+            first = fresh;
+            fresh = false;
+            return 1;
+        }
+        Clock::time_point now = Clock::now();
+        if(interval > 1 && now - last < interval * frame)
+        {
+            return 0;
+        }
+        last = now;
+        first = retimed || fresh;
+        retimed = false;
+        fresh = false;
+        return generations;
+    }
+
+    bool paused() const { return !running; }
+
+    /* the process was set up anew, for another rule */
+    void renewed() { fresh = true; }
+
+private:
+
+    bool running;
+    int steps;                  // single generations asked for while paused
+    int generations;            // per update
+    int interval;               // frames per update, above 1 once slowed down below a generation per update
+    bool retimed;               // the speed changed since the last update
+    bool fresh;                 // the process was renewed since the last update
+    Clock::duration frame;      // of the window
+    Clock::time_point last;     // of the last update
+};
+
+/* what lives for the whole run: the outputs, the stepping, the resets so
+   far and the rule picked in the window */
+struct Session
+{
+    explicit Session(const Settings& settings):recorder(nullptr), checkpointer(nullptr), cycles(nullptr), log(nullptr),
+        metrics((double)settings.gridWidth * settings.gridHeight, settings.metricsEvery),
+        control(settings.displayEvery, settings.fps), resets(0), rule(settings.rule){}
+
+    Recorder* recorder;
+    Checkpointer* checkpointer;
+    CycleDetector* cycles;
+    FILE* log;
+    Metrics metrics;
+    Control control;            // used by the thread that steps the process
+    uint64_t resets;            // every reset draws the board of the next seed
+    LifeRule rule;              // of the process
+
+    /* open the outputs asked for, false if one cannot be */
+    bool open(const Settings& settings)
+    {
+        if(settings.record != nullptr)
+        {
+            recorder = new Recorder(settings.gridWidth, settings.gridHeight, settings.recordScale, settings.recordThreads,
+                                    COLOR_ALIVE, COLOR_DEAD);
+            std::string error;
+            if(!recorder->open(settings.record, error))
+            {
+                printf("cannot record to %s: %s\n", settings.record, error.c_str());
+                delete recorder;
+                recorder = nullptr;
+                return false;
+            }
+            printf("recording %dx%d frames to %s\n", recorder->frameWidth(), recorder->frameHeight(), settings.record);
+        }
+        if(settings.checkpoint != nullptr && !libraryEngine(settings.engine))
+        {
+            // the library writes the checkpoints of its own engines
+            checkpointer = new Checkpointer(settings.checkpoint, settings.checkpointEvery, settings.checkpointCompress);
+        }
+        cycles = settings.stopOnCycle ? new CycleDetector(settings.cycleHistory) : nullptr;
+        if(settings.metricsLog != nullptr && (log = fopen(settings.metricsLog, "a")) == nullptr)
+        {
+            printf("cannot open %s\n", settings.metricsLog);
+        }
+        return true;
+    }
+
+    /* finish the outputs */
+    void close()
+    {
+        if(log != nullptr)
+        {
+            fclose(log);
+        }
+        delete cycles;
+        delete checkpointer;    // finishes the checkpoint being written
+        if(recorder != nullptr)
+        {
+            recorder->close();  // encodes the frames still waiting
+            if(recorder->stalls() > 0)
+            {
+                printf("recording waited for the encoders %llu times\n", (unsigned long long)recorder->stalls());
+            }
+            delete recorder;
+        }
+        log = nullptr;
+        cycles = nullptr;
+        checkpointer = nullptr;
+        recorder = nullptr;
+    }
+};
+
+/* hand the current generation to the checkpoint writer when a checkpoint is due */
+template <class Process>
+void checkpoint(Checkpointer* checkpointer, const Process& conway, const Settings& settings)
+{
+    if(checkpointer == nullptr || !checkpointer->due(conway.generation()))
+    {
+        return;
+    }
+    AllowAllocations allow;     // the rule is stored as text
+    Snapshot& snapshot = checkpointer->spare();
+    captureSnapshot(conway, snapshot);
+    snapshot.boundary = settings.boundary;
+    snapshot.width = settings.gridWidth;
+    snapshot.height = settings.gridHeight;
+    checkpointer->submit();
+}
+
+inline void checkpoint(Checkpointer*, const LibraryProcess&, const Settings&)
+{
+}
+
+/* hand the current generation to the recorder as a frame, when there is one */
+template <class Process>
+void recordFrame(Recorder* recorder, Process& conway)
+{
+    if(recorder != nullptr)
+    {
+        uint64_t generation = conway.generation();
+        withGrid(conway, [recorder, generation](const auto& grid){ recorder->record(grid, generation); });
+    }
+}
+
+/* record the current generation, true when the board repeats one in the history */
+template <class Process>
+bool cycleReached(CycleDetector* cycles, Process& conway)
+{
+    return cycles != nullptr && cycles->add(processHash(conway), conway.generation());
+}
+
+/* advance a process by n generations as a timed update, or fewer when it
+   is interrupted; true if it advanced at all. The cells around it are
+   sampled when the next report wants them */
+template <class Process>
+bool timedAdvance(Process& conway, int n, Metrics& metrics, CellSampler& sampler)
+{
+    uint64_t generation = conway.generation();
+    bool sample = metrics.sampleDue();
+    if(sample)
+    {
+        withGrid(conway, [&sampler](const auto& grid){ sampler.capture(grid); });
+    }
+    {
+        ScopedTimer timer(metrics, PHASE_UPDATE);
+        AllowAllocations allow(allocatesInUpdate(conway));
+        advance(conway, n);
+        waitForUpdate(conway);
+    }
+    if(sample)
+    {
+        uint64_t population, births, deaths;
+        withGrid(conway, [&](const auto& grid){ sampler.compare(grid, population, births, deaths); });
+        metrics.setCells(population, births, deaths);
+    }
+    metrics.setGeneration(conway.generation());
+    return conway.generation() != generation;
+}
+
+/* step a process by another rule from the current generation on, false
+   with the reason printed if it cannot */
+inline bool setProcessRule(LibraryProcess& conway, const LifeRule& rule)
+{
+    AllowAllocations allow;     // the engines whose rule is a template parameter are created anew
+    if(conway_set_rule(conway.handle(), ruleString(rule).c_str()) != CONWAY_OK)
+    {
+        printf("%s\n", conway_error(conway.handle()));
+        return false;
+    }
+    return true;
+}
+
+#ifdef CONWAY_GPU
+inline bool setProcessRule(GpuLife& life, const LifeRule& rule)
+{
+    if(!life.setRule(rule))
+    {
+        printf("the gpu engine does not support Generations rules\n");
+        return false;
+    }
+    return true;
+}
+#endif
+
+/* carry out the commands the window queued */
+template <class Process>
+void runCommands(CommandQueue& commands, Process& conway, const Settings& settings, Session& session, bool& periodic)
+{
+    Command command;
+    while(commands.pop(command))
+    {
+        if(session.control.apply(command))
+        {
+            continue;
+        }
+        if(command.type == COMMAND_RESET)
+        {
+            AllowAllocations allow;     // pattern and snapshot files are read again
+            initialize(conway, settings, ++session.resets);
+        }
+        else if(command.rule == session.rule || !setProcessRule(conway, command.rule))
+        {
+            continue;
+        }
+        else
+        {
+            session.rule = command.rule;
+            session.control.renewed();
+        }
+        periodic = false;
+        if(session.cycles != nullptr)
+        {
+            session.cycles->clear();
+        }
+    }
+}
+
+/* write a report to the metrics log and the Prometheus file, and lay it out
+   on the overlay of the screen when there is one */
+void publish(const MetricsReport& report, const Settings& settings, FILE* log, GUI* screen)
+{
+    if(log != nullptr)
+    {
+        writeJsonLine(report, log);
+    }
+    std::string error;
+    if(settings.prometheus != nullptr && !writePrometheus(report, settings.prometheus, error))
+    {
+        printf("cannot write the metrics: %s\n", error.c_str());
+    }
+    if(screen == nullptr || !settings.overlay)
+    {
+        return;
+    }
+    char text[OVERLAY_TEXT_MAX];
+    int length = snprintf(text, sizeof(text), "GEN %llu POP %llu +%llu -%llu\nCELLS/S %.3e GEN/S %.1f",
+                          (unsigned long long)report.generation, (unsigned long long)report.population,
+                          (unsigned long long)report.births, (unsigned long long)report.deaths,
+                          report.cellsPerSecond, report.generationsPerSecond);
+    for(int phase = 0; phase<PHASE_COUNT && length < (int)sizeof(text); phase++)
+    {
+        length += snprintf(text + length, sizeof(text) - length, "\n%-7s P50 %7.3f P99 %7.3f MS", phaseName(phase),
+                           report.p50[phase] * 1000.0, report.p99[phase] * 1000.0);
+    }
+    screen->setOverlay(text);
+}
+
+/* run a Game of Life process in the window until it is closed; a periodic
+   board is held until it is reset. The commands of the window are carried
+   out between updates, on this thread */
+template <class Process>
+void runLoop(GUI* screen, Process& conway, const Settings& settings, Session& session)
+{
 
-	// create Conway Game of Life process
-    Conway<char> conway(gridWidth, gridHeight);
-    conway.randomInitialization(sparseness);
-    
     // loop
-    int frame_time = std::round((1.0 / (float)fps)*1000);
-    uint32_t startTime, currTime;
-    std::vector<float> elapsedTimes(5, 0.0);
+    FramePacer pacer(settings.fps);
+    CellSampler sampler;
+    withGrid(conway, [&sampler](const auto& grid){ sampler.prepare(grid); });
+    AllocationCheck check("main loop");
+    CommandQueue commands;
+    Metrics& metrics = session.metrics;
+    bool periodic = false;
     while(1)
     {
-        switch(screen->pollEvents())
+        // is close window pressed?
+        bool open;
         {
-            // is close window pressed?
-            case GUI::CALLBACK_QUIT:
-                goto exitapp;
-                break;
-            // is the mouse pressed?
-            case GUI::CALLBACK_RESET:
-                conway.randomInitialization(sparseness); // reset the game
-                break;
-            // no action
-            case GUI::CALLBACK_NOACTION:
-                break;
+            ScopedTimer timer(metrics, PHASE_EVENTS);
+            open = screen->pollEvents(commands);
+        }
+        if(!open)
+        {
+            return;
         }
+        runCommands(commands, conway, settings, session, periodic);
         
         // update the Conway way of life, measure the execution time
-        startTime = SDL_GetTicks();
-    	conway.update();
-        currTime = SDL_GetTicks();
-        std::rotate(elapsedTimes.rbegin(), elapsedTimes.rbegin() + 1, elapsedTimes.rend());
-        elapsedTimes[0] = currTime - startTime;
+        bool first;
+        int n = periodic ? 0 : session.control.due(first);
+        if(n > 0)
+        {
+            AllowAllocations allow(first);  // the first update at a new speed may set up buffers
+            if(timedAdvance(conway, n, metrics, sampler))
+            {
+                checkpoint(session.checkpointer, conway, settings);
+                recordFrame(session.recorder, conway);
+                periodic = cycleReached(session.cycles, conway);
+            }
+        }
         
         // update the visuals
-    	screen->clear();
-    	screen->drawGrid(conway.fullGrid(), gridWidth, gridHeight);
-    	screen->present();
-        screen->setWindowTitle(format("Conway's Game of Life. Press R to reset. Average computation time: %.1f ms",std::accumulate(elapsedTimes.begin(), elapsedTimes.end(), 0)/5.0));
+        {
+            ScopedTimer timer(metrics, PHASE_DRAW);
+            screen->clear();
+            draw(screen, conway);
+            screen->drawOverlay();
+        }
+        {
+            ScopedTimer timer(metrics, PHASE_PRESENT);
+            screen->present();
+        }
+
+        // report once per interval
+        if(metrics.reportDue())
+        {
+            MetricsReport report = metrics.report();
+            publish(report, settings, session.log, screen);
+            char title[128];
+            if(periodic)
+            {
+                snprintf(title, sizeof(title), "Conway's Game of Life. Press R to reset. Period %llu reached at generation %llu",
+                         (unsigned long long)session.cycles->period(), (unsigned long long)conway.generation());
+            }
+            else if(session.control.paused())
+            {
+                snprintf(title, sizeof(title), "Conway's Game of Life. Paused at generation %llu, press P to resume or N to step",
+                         (unsigned long long)conway.generation());
+            }
+            else
+            {
+                snprintf(title, sizeof(title), "Conway's Game of Life. Press R to reset. Computation time: %.1f ms, p99 %.1f ms",
+                         report.p50[PHASE_UPDATE] * 1000.0, report.p99[PHASE_UPDATE] * 1000.0);
+            }
+            screen->setWindowTitle(title);
+        }
         
-        // delay until next loop
-        SDL_Delay(frame_time);
+        // wait for the rest of the frame
+        check.frame();
+        pacer.wait();
+    }
+}
+
+/* run a Game of Life process on a thread of its own, the window shows the
+   newest generation it finished at every frame; a periodic board is held
+   until it is reset. The window queues its commands to the simulation and
+   cancels the update in progress, so that they are carried out at once
+   however long an update takes; false if its threads cannot be pinned */
+template <class Process>
+bool runPipelined(GUI* screen, Process& conway, const Settings& settings, Session& session)
+{
+    TripleBuffer<Frame> frames;
+    CommandQueue commands;
+    std::atomic<bool> quit(false);
+    bool pinned = true;
+    Metrics& metrics = session.metrics;
+
+    // size every slot before the threads share them
+    for(int i = 0; i<3; i++)
+    {
+        withGrid(conway, [&frames](const auto& grid){ fillFrame(frames.writeBuffer(), grid, 0); });
+        frames.publish();
+        frames.update();
+    }
+
+    // simulation thread, converts a generation only when the last one was
+    // shown; the only one to time updates, and to check the allocations of
+    // both threads. It runs the first band of every update, so it is pinned
+    // with the pool and the render thread is left free
+    std::thread simulation([&]()
+    {
+        if(!pinUpdates(conway))
+        {
+            pinned = false;
+            quit = true;
+            return;
+        }
+        FramePacer pacer(settings.rate);
+        CellSampler sampler;
+        withGrid(conway, [&sampler](const auto& grid){ sampler.prepare(grid); });
+        AllocationCheck check("pipelined loop");
+        long long updates = 0;
+        bool periodic = false;
+        bool shown = true;      // the window has the current generation
+        while(!quit.load(std::memory_order_relaxed))
+        {
+            // commands queued after this come with the interruption again
+            interruptUpdate(conway, false);
+            uint64_t resets = session.resets;
+            runCommands(commands, conway, settings, session, periodic);
+            if(session.resets != resets)
+            {
+                updates = 0;
+                shown = false;
+            }
+            bool first;
+            int n = periodic ? 0 : session.control.due(first);
+            if(n > 0)
+            {
+                AllowAllocations allow(first);  // the first update at a new speed may set up buffers
+                if(timedAdvance(conway, n, metrics, sampler))
+                {
+                    updates += n;
+                    shown = false;
+                    checkpoint(session.checkpointer, conway, settings);
+                    recordFrame(session.recorder, conway);
+                    periodic = cycleReached(session.cycles, conway);
+                }
+            }
+            if(!shown && frames.consumed())
+            {
+                withGrid(conway, [&](const auto& grid){ fillFrame(frames.writeBuffer(), grid, updates); });
+                frames.publish();
+                shown = true;
+            }
+            check.frame();
+            if(n == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(SIMULATION_IDLE_MS));
+            }
+            pacer.wait();
+        }
+    });
+
+    // render loop, times the other phases and reports
+    FramePacer pacer(settings.fps);
+    while(1)
+    {
+        bool open;
+        {
+            ScopedTimer timer(metrics, PHASE_EVENTS);
+            open = screen->pollEvents(commands);
+        }
+        if(!commands.empty())
+        {
+            interruptUpdate(conway, true);
+        }
+        if(!open || quit.load(std::memory_order_relaxed))
+        {
+            quit = true;
+            interruptUpdate(conway, true);
+            simulation.join();
+            return pinned;
+        }
+
+        // show the newest frame, or the last one again from the texture
+        bool fresh = frames.update();
+        const Frame& frame = frames.readBuffer();
+        if(!frame.cells.empty())
+        {
+            {
+                ScopedTimer timer(metrics, PHASE_DRAW);
+                screen->clear();
+                screen->drawGrid(frame.view(), fresh);
+                screen->drawOverlay();
+            }
+            ScopedTimer timer(metrics, PHASE_PRESENT);
+            screen->present();
+        }
+
+        // report once per interval
+        if(metrics.reportDue())
+        {
+            MetricsReport report = metrics.report();
+            publish(report, settings, session.log, screen);
+            char title[128];
+            snprintf(title, sizeof(title), "Conway's Game of Life. Press R to reset, P to pause. Generations per second: %.0f",
+                     report.generationsPerSecond);
+            screen->setWindowTitle(title);
+        }
+
+        pacer.wait();
+    }
+}
+
+/* run a Game of Life process without window for a number of generations,
+   or until the board is periodic, report the timings */
+template <class Process>
+void runHeadless(Process& conway, const Settings& settings, Session& session)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Metrics& metrics = session.metrics;
+    CellSampler sampler;
+    withGrid(conway, [&sampler](const auto& grid){ sampler.prepare(grid); });
+    std::vector<double> elapsedTimes;   // seconds per generation
+    elapsedTimes.reserve((settings.generations + settings.displayEvery - 1) / settings.displayEvery);
+    AllocationCheck check("headless loop");
+    Clock::time_point runStart = Clock::now();
+    long long g = 0;
+    while(g<settings.generations)
+    {
+        int n = (int)std::min<long long>(settings.displayEvery, settings.generations - g);
+        g += n;
+        Clock::time_point startTime = Clock::now();
+        timedAdvance(conway, n, metrics, sampler);
+        elapsedTimes.push_back(std::chrono::duration<double>(Clock::now() - startTime).count() / n);
+        checkpoint(session.checkpointer, conway, settings);
+        recordFrame(session.recorder, conway);
+        if(metrics.reportDue())
+        {
+            publish(metrics.report(), settings, session.log, nullptr);
+        }
+        if(cycleReached(session.cycles, conway))
+        {
+            printf("period %llu reached at generation %llu\n", (unsigned long long)session.cycles->period(),
+                   (unsigned long long)conway.generation());
+            break;
+        }
+        check.frame();
+    }
+    double total = std::chrono::duration<double>(Clock::now() - runStart).count();
+    if(elapsedTimes.empty())
+    {
+        return;
+    }
+    if(session.log != nullptr || settings.prometheus != nullptr)
+    {
+        publish(metrics.report(), settings, session.log, nullptr);  // the rest of the run
+    }
+
+    std::nth_element(elapsedTimes.begin(), elapsedTimes.begin() + elapsedTimes.size()/2, elapsedTimes.end());
+    double median = elapsedTimes[elapsedTimes.size()/2];
+    double cells = (double)settings.gridWidth * settings.gridHeight;
+    printf("engine: %s, grid: %dx%d, threads: %d, generations: %lld\n", settings.engine.c_str(),
+           settings.gridWidth, settings.gridHeight, settings.threads, g);
+    printf("total: %.3f s, median generation: %.3f ms, median cells/s: %.3e\n",
+           total, median*1000.0, median > 0 ? cells / median : 0.0);
+}
+
+/* run a Game of Life process in the window, or headless without one; false
+   if it could not be initialized */
+template <class Process>
+bool run(Process& conway, const Settings& settings, GUI* screen, Session& session)
+{
+    if(!initialize(conway, settings))
+    {
+        return false;
+    }
+    recordFrame(session.recorder, conway);  // the first generation
+    if(settings.headless)
+    {
+        runHeadless(conway, settings, session);
+    }
+    else if(pipelined(settings))
+    {
+        return runPipelined(screen, conway, settings, session);
+    }
+    else
+    {
+        runLoop(screen, conway, settings, session);
+    }
+    return true;
+}
+
+/* print how the soups of a search ended */
+void printCensus(const std::vector<SoupResult>& results, double seconds)
+{
+    std::map<uint32_t, uint64_t> periods;
+    uint64_t population = 0;
+    for(const SoupResult& soup: results)
+    {
+        periods[soup.period]++;
+        population += soup.population;
+    }
+    uint64_t unsettled = periods.count(0) ? periods[0] : 0;
+    printf("soups: %zu, periodic: %llu, not settled: %llu, mean final population: %.1f\n", results.size(),
+           (unsigned long long)(results.size() - unsettled), (unsigned long long)unsettled,
+           results.empty() ? 0.0 : (double)population / results.size());
+    for(const auto& period: periods)
+    {
+        if(period.first != 0)
+        {
+            printf("period %u: %llu\n", period.first, (unsigned long long)period.second);
+        }
+    }
+    printf("total: %.3f s, soups/s: %.0f\n", seconds, seconds > 0 ? results.size() / seconds : 0.0);
+}
+
+/* runs the soup search for the rule it is handed and writes the census */
+struct SoupRunner
+{
+    const Settings& settings;
+    ThreadPool& pool;
+    bool result;
+
+    template <class R>
+    void operator()(const R& rule)
+    {
+        SoupSettings soups;
+        soups.width = settings.gridWidth;
+        soups.height = settings.gridHeight;
+        soups.soupSize = settings.soupSize;
+        soups.boundary = settings.boundary;
+        soups.generations = settings.generations;
+        soups.soups = settings.soups;
+        soups.firstSeed = settings.seed;
+
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        std::vector<SoupResult> results;
+        searchSoups(soups, rule, &pool, results);
+        printCensus(results, std::chrono::duration<double>(Clock::now() - start).count());
+
+        std::string error;
+        if(settings.census != nullptr && !writeCensus(soups, rule.lifeRule(), results, settings.census, error))
+        {
+            printf("cannot write the census: %s\n", error.c_str());
+            result = false;
+        }
+    }
+
+    /* soups are bit-sliced, a cell holds no more than two states */
+    void operator()(const GenerationsRule&)
+    {
+        printf("the soup engine does not support Generations rules\n");
+        result = false;
+    }
+};
+
+#ifdef CONWAY_MPI
+/* runs the distributed engine for the rule it is handed, headless on every
+   rank; only rank 0 reports */
+struct DistributedRunner
+{
+    const Settings& settings;
+    ThreadPool& pool;
+    bool result;
+
+    template <class R>
+    void operator()(const R& rule)
+    {
+        DistributedLife<R> life(settings.gridWidth, settings.gridHeight, rule);
+        std::string error;
+        if(!life.open(MPI_COMM_WORLD, settings.haloDepth, error))
+        {
+            fail("cannot split the grid", error);
+            return;
+        }
+        life.setThreadPool(&pool);
+        if(settings.restore != nullptr)
+        {
+            if(!life.restoreSnapshot(settings.restore, error))
+            {
+                fail(std::string("cannot restore ") + settings.restore, error);
+                return;
+            }
+        }
+        else if(settings.pattern != nullptr)
+        {
+            // every rank reads the pattern and keeps the cells of its block
+            if(!loadPattern(settings.pattern, life, settings.gridWidth, settings.gridHeight, error))
+            {
+                fail(std::string("cannot load ") + settings.pattern, error);
+                return;
+            }
+        }
+        else
+        {
+            double density = settings.density > 0 ? settings.density : 1.0 / (settings.sparseness + 1);
+            life.randomFill(settings.seed, randomDensity(density));
+        }
+
+        // checkpoints are collective, the stepping waits for them
+        typedef std::chrono::steady_clock Clock;
+        CycleDetector cycles(settings.cycleHistory);
+        std::vector<double> elapsedTimes;   // seconds per generation
+        uint64_t nextCheckpoint = life.generation() + settings.checkpointEvery;
+        Clock::time_point runStart = Clock::now();
+        long long g = 0;
+        while(g<settings.generations)
+        {
+            int n = (int)std::min<long long>(settings.displayEvery, settings.generations - g);
+            g += n;
+            Clock::time_point startTime = Clock::now();
+            life.step(n);
+            elapsedTimes.push_back(std::chrono::duration<double>(Clock::now() - startTime).count() / n);
+            if(settings.checkpoint != nullptr && life.generation() >= nextCheckpoint)
+            {
+                if(!life.writeSnapshot(settings.checkpoint, error) && life.rank() == 0)
+                {
+                    printf("checkpoint failed: %s\n", error.c_str());
+                }
+                nextCheckpoint = life.generation() + settings.checkpointEvery;
+            }
+            if(settings.stopOnCycle && cycles.add(life.hash(), life.generation()))
+            {
+                if(life.rank() == 0)
+                {
+                    printf("period %llu reached at generation %llu\n", (unsigned long long)cycles.period(),
+                           (unsigned long long)life.generation());
+                }
+                break;
+            }
+        }
+        double total = std::chrono::duration<double>(Clock::now() - runStart).count();
+        uint64_t population = life.population();
+        if(life.rank() != 0 || elapsedTimes.empty())
+        {
+            return;
+        }
+        std::nth_element(elapsedTimes.begin(), elapsedTimes.begin() + elapsedTimes.size()/2, elapsedTimes.end());
+        double median = elapsedTimes[elapsedTimes.size()/2];
+        double cells = (double)settings.gridWidth * settings.gridHeight;
+        printf("engine: mpi, grid: %dx%d, ranks: %d (%dx%d blocks), halo: %d, threads: %d, generations: %lld\n",
+               settings.gridWidth, settings.gridHeight, life.ranks(), life.blockColumns(), life.blockRows(),
+               life.haloDepth(), settings.threads, g);
+        printf("total: %.3f s, median generation: %.3f ms, median cells/s: %.3e, population: %llu\n",
+               total, median*1000.0, median > 0 ? cells / median : 0.0, (unsigned long long)population);
+    }
+
+    /* the blocks are stepped by the two-state row kernels */
+    void operator()(const GenerationsRule&)
+    {
+        fail("the mpi engine does not support Generations rules", "");
+    }
+
+    /* every rank comes to the same conclusion, rank 0 tells */
+    void fail(const std::string& what, const std::string& error)
+    {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if(rank == 0)
+        {
+            printf(error.empty() ? "%s\n" : "%s: %s\n", what.c_str(), error.c_str());
+        }
+        result = false;
+    }
+};
+#endif
+
+/* Main entry point */
+int main(int argc, char *argv[])
+{
+    // default values
+    Settings settings;
+    
+    // parse options, keep the positional arguments
+    std::vector<char*> args(1, argv[0]);
+    for(int i = 1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--engine") == 0 && i+1 < argc)
+        {
+            settings.engine = argv[++i];
+        }
+        else if(strcmp(argv[i], "--kernel") == 0 && i+1 < argc)
+        {
+            settings.kernel = argv[++i];
+        }
+        else if(strcmp(argv[i], "--boundary") == 0 && i+1 < argc)
+        {
+            i++;
+            if(strcmp(argv[i], "dead") == 0)
+            {
+                settings.boundary = BOUNDARY_DEAD;
+            }
+            else if(strcmp(argv[i], "mirror") == 0)
+            {
+                settings.boundary = BOUNDARY_MIRROR;
+            }
+            else if(strcmp(argv[i], "torus") != 0)
+            {
+                printf("unknown boundary: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if(strcmp(argv[i], "--hashlife-step") == 0 && i+1 < argc)
+        {
+            settings.hashlifeStep = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--headless") == 0)
+        {
+            settings.headless = true;
+        }
+        else if(strcmp(argv[i], "--generations") == 0 && i+1 < argc)
+        {
+            settings.generations = atoll(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--no-tiles") == 0)
+        {
+            settings.tiles = false;
+        }
+        else if(strcmp(argv[i], "--display-every") == 0 && i+1 < argc)
+        {
+            settings.displayEvery = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--stop-on-cycle") == 0)
+        {
+            settings.stopOnCycle = true;
+        }
+        else if(strcmp(argv[i], "--cycle-history") == 0 && i+1 < argc)
+        {
+            settings.cycleHistory = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--soups") == 0 && i+1 < argc)
+        {
+            settings.soups = std::max(atoll(argv[++i]), 1LL);
+        }
+        else if(strcmp(argv[i], "--soup-size") == 0 && i+1 < argc)
+        {
+            settings.soupSize = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+        {
+            settings.seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(strcmp(argv[i], "--density") == 0 && i+1 < argc)
+        {
+            settings.density = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--census") == 0 && i+1 < argc)
+        {
+            settings.census = argv[++i];
+        }
+        else if(strcmp(argv[i], "--metrics") == 0 && i+1 < argc)
+        {
+            settings.metricsLog = argv[++i];
+        }
+        else if(strcmp(argv[i], "--prometheus") == 0 && i+1 < argc)
+        {
+            settings.prometheus = argv[++i];
+        }
+        else if(strcmp(argv[i], "--metrics-every") == 0 && i+1 < argc)
+        {
+            settings.metricsEvery = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--halo-depth") == 0 && i+1 < argc)
+        {
+            settings.haloDepth = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--pin") == 0 && i+1 < argc)
+        {
+            if(!parseAffinity(argv[++i], settings.affinity))
+            {
+                printf("unknown pinning: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if(strcmp(argv[i], "--huge-pages") == 0)
+        {
+            settings.hugePages = true;
+        }
+        else if(strcmp(argv[i], "--overlay") == 0)
+        {
+            settings.overlay = true;
+        }
+        else if(strcmp(argv[i], "--pipeline") == 0)
+        {
+            settings.pipeline = 1;
+        }
+        else if(strcmp(argv[i], "--no-pipeline") == 0)
+        {
+            settings.pipeline = 0;
+        }
+        else if(strcmp(argv[i], "--rate") == 0 && i+1 < argc)
+        {
+            settings.rate = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--pattern") == 0 && i+1 < argc)
+        {
+            settings.pattern = argv[++i];
+        }
+        else if(strcmp(argv[i], "--restore") == 0 && i+1 < argc)
+        {
+            settings.restore = argv[++i];
+        }
+        else if(strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc)
+        {
+            settings.checkpoint = argv[++i];
+        }
+        else if(strcmp(argv[i], "--checkpoint-every") == 0 && i+1 < argc)
+        {
+            settings.checkpointEvery = atoll(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--checkpoint-rle") == 0)
+        {
+            settings.checkpointCompress = true;
+        }
+        else if(strcmp(argv[i], "--record") == 0 && i+1 < argc)
+        {
+            settings.record = argv[++i];
+        }
+        else if(strcmp(argv[i], "--record-scale") == 0 && i+1 < argc)
+        {
+            settings.recordScale = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--record-threads") == 0 && i+1 < argc)
+        {
+            settings.recordThreads = std::max(atoi(argv[++i]), 1);
+        }
+        else if(strcmp(argv[i], "--rule") == 0 && i+1 < argc)
+        {
+            settings.ruleText = argv[++i];
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+    
+	// parse arguments, adjust values
+    if(argc == 8)
+    {
+        settings.threads = atoi(argv[7]);
+    }
+    if(argc >= 7)
+    {
+        settings.fps = atoi(argv[6]);
+    }
+    if(argc >= 6)
+    {
+        settings.sparseness = atoi(argv[5]);
+    }
+    if(argc >= 5)
+    {
+        settings.gridWidth = atoi(argv[3]);
+        settings.gridHeight = atoi(argv[4]);
+    }
+    if(argc >= 3)
+    {
+        settings.screenWidth = atoi(argv[1]);
+        settings.screenHeight = atoi(argv[2]);
+    }
+    else
+    {
+        printf("usage: Conway [window width] [window height] [grid width] [grid height] [sparseness] [fps] [threads] [--engine byte|bit|changes|sparse|hashlife|ltl|gpu|soup|mpi] [--halo-depth N] [--pin none|cores|nodes] [--huge-pages] [--hashlife-step log2] [--kernel avx2|sse2|neon|scalar] [--boundary torus|dead|mirror] [--headless] [--generations N] [--display-every N] [--stop-on-cycle] [--cycle-history N] [--no-tiles] [--pipeline|--no-pipeline] [--rate updates/s] [--pattern file.rle|.cells|.lif|.mc] [--restore snapshot] [--checkpoint snapshot] [--checkpoint-every N] [--checkpoint-rle] [--record |command|frames.png] [--record-scale N] [--record-threads N] [--soups N] [--soup-size N] [--seed N] [--density p] [--census file] [--metrics file.jsonl] [--prometheus file] [--metrics-every ms] [--overlay] [--rule B3/S23|B2/S/C3|R5,C0,M1,S34..58,B34..45,NM]\n");
+        printf("the window steps the simulation on a thread of its own (--pipeline), by default for every engine but gpu: it\n"
+               "stays responsive and cancels a long update for a command, which the bit, sparse and ltl engines can only do between\n"
+               "generations and hashlife between its steps. With --no-pipeline the window waits for every update to finish\n");
+        printf("e.g.: Conway %d %d %d %d %d %d %d\n", WINDOW_WIDTH_DEFAULT, WINDOW_HEIGHT_DEFAULT, GRID_WIDTH_DEFAULT, GRID_HEIGHT_DEFAULT, SPARSENESS_DEFAULT, FPS_DEFAULT, THREADS_DEFAULT);
+    }
+    if(settings.engine != "byte" && settings.engine != "bit" && settings.engine != "changes" && settings.engine != "sparse" && settings.engine != "hashlife" && settings.engine != "ltl" && settings.engine != "gpu" && settings.engine != "soup" && settings.engine != "mpi")
+    {
+        printf("unknown engine: %s\n", settings.engine.c_str());
+        return EXIT_FAILURE;
+    }
+#ifndef CONWAY_GPU
+    if(settings.engine == "gpu")
+    {
+        printf("built without the gpu engine\n");
+        return EXIT_FAILURE;
+    }
+#endif
+#ifndef CONWAY_MPI
+    if(settings.engine == "mpi")
+    {
+        printf("built without the mpi engine\n");
+        return EXIT_FAILURE;
+    }
+#endif
+    if(settings.engine == "mpi" && settings.boundary != BOUNDARY_TORUS)
+    {
+        printf("the mpi engine only runs on a torus\n");
+        return EXIT_FAILURE;
+    }
+    if(settings.record != nullptr && (settings.engine == "soup" || settings.engine == "mpi"))
+    {
+        printf("the %s engine does not support --record\n", settings.engine.c_str());
+        return EXIT_FAILURE;
+    }
+    if(settings.engine == "gpu" && settings.pipeline > 0)
+    {
+        printf("the gpu engine does not support --pipeline, its context belongs to the main thread\n");
+        return EXIT_FAILURE;
+    }
+    if(settings.pipeline < 0)
+    {
+        settings.pipeline = settings.engine != "gpu";
+    }
+    if(settings.ruleText != nullptr && settings.engine != "ltl" && !parseRule(settings.ruleText, settings.rule))
+    {
+        printf("unknown rule: %s\n", settings.ruleText);
+        return EXIT_FAILURE;
+    }
+
+	// create GUI object as singleton, unless running headless; the gpu
+    // engine always needs one for its OpenGL context, hidden when headless
+    GUI* screen = nullptr;
+    if((!settings.headless && settings.engine != "soup" && settings.engine != "mpi") || settings.engine == "gpu")
+    {
+        screen = GUI::createWithDimensions(settings.screenWidth, settings.screenHeight, settings.engine == "gpu", settings.headless);
+        if(screen == nullptr)
+        {
+            return 0;
+        }
+    }
+
+    // worker threads of the soup and mpi engines, kept alive for the whole
+    // run and pinned before any grid is written, so that their bands are
+    // placed on their nodes; the library keeps the pools of its own engines
+    bool library = libraryEngine(settings.engine);
+    ThreadPool pool(library ? 1 : settings.threads);
+    std::string error;
+    if(!library && !pinThreadPool(pool, settings.affinity, error))
+    {
+        printf("%s\n", error.c_str());
+        delete screen;
+        return EXIT_FAILURE;
+    }
+    gridHugePages() = settings.hugePages;
+
+    // outputs of the engines that step a single process
+    Session session(settings);
+    if(settings.engine != "soup" && settings.engine != "mpi" && !session.open(settings))
+    {
+        delete screen;
+        return EXIT_FAILURE;
+    }
+
+	// create Conway Game of Life process and run it
+    int result = EXIT_SUCCESS;
+    if(library)
+    {
+        LibraryProcess conway;
+        if(!conway.open(settings) || !run(conway, settings, screen, session))
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+#ifdef CONWAY_GPU
+    else if(settings.engine == "gpu")
+    {
+        GpuLife conway(settings.gridWidth, settings.gridHeight);
+        std::string error;
+        if(!conway.open(GUI::glFunction, error))
+        {
+            printf("cannot run on the GPU: %s\n", error.c_str());
+            result = EXIT_FAILURE;
+        }
+        else if(!conway.setRule(settings.rule))
+        {
+            printf("the gpu engine does not support Generations rules\n");
+            result = EXIT_FAILURE;
+        }
+        else
+        {
+            conway.setBoundaryPolicy(settings.boundary);
+            if(!run(conway, settings, screen, session))
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+    }
+#endif
+#ifdef CONWAY_MPI
+    else if(settings.engine == "mpi")
+    {
+        // the worker threads never call MPI themselves
+        int provided;
+        MPI_Init_thread(nullptr, nullptr, MPI_THREAD_FUNNELED, &provided);
+        {
+            DistributedRunner runner = {settings, pool, true};
+            dispatchRule(settings.rule, runner);
+            if(!runner.result)
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+        MPI_Finalize();
+    }
+#endif
+    else if(settings.engine == "soup")
+    {
+        SoupRunner runner = {settings, pool, true};
+        dispatchRule(settings.rule, runner);
+        if(!runner.result)
+        {
+            result = EXIT_FAILURE;
+        }
     }
-    
-exitapp:
     
     // clean up
+    session.close();
     delete screen;
     
     // finish
-    return EXIT_SUCCESS;
+    return result;
 }
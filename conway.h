@@ -0,0 +1,779 @@
+
+// Author: 	Stephan Meesters
+//
+// Byte-per-cell Game of Life process
+//
+// Conway<T, R> holds one cell per element of type T in two flat grids, the
+// generation that is being read and the one that is being written, and
+// steps them by rule R (see rule.h), B3/S23 unless given. With a
+// GenerationsRule a cell holds its state, from 0 to the number of states
+// minus one, and steps by the generic kernel.
+//
+// The grid is split in square tiles. A tile is only recomputed when a cell
+// in it or in one of its neighbouring tiles changed in the last generation,
+// so settled areas of the board cost nothing.
+//
+// step(n) advances several generations per pass over memory. Every tile is
+// copied out with a halo as deep as the number of generations, and stepped
+// in a cache-sized scratch buffer over a region that shrinks by a cell on
+// every side each generation. The tile itself is still exact at the end.
+// Beyond the grid the halo follows the boundary policy: wrapped and mirrored
+// cells evolve like the cells they copy, and dead ones are cleared again
+// after every generation.
+//
+// hash() returns the Zobrist hash of the grid (see cycle.h). The first call
+// hashes every tile, after that every generation only rehashes the tiles
+// that changed and swaps their old hashes in the grid hash for the new ones.
+// Settled areas of the board cost nothing here either.
+//
+// A generation can be given a flag that cancels it. The bands check it
+// between rows of tiles, step() between its tiles, and a generation that was
+// stopped halfway is dropped: the grid it read is still the current one, and
+// every tile counts as changed at the next.
+//
+// Both grids are first written by the threads of the pool, each its own band
+// of rows as update() hands them out, before anything else writes them. On
+// a NUMA machine the pages of a band then lie on the node of the thread that
+// steps it (see grid.h), instead of all on the node of the main thread.
+//
+
+#ifndef CONWAY_CONWAY_H
+#define CONWAY_CONWAY_H
+
+#include <functional>
+#include <random>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "kernels.h"
+#include "rule.h"
+#include "cycle.h"
+#include "random.h"
+
+#define TILE_SIZE LIFE_BLOCK_SIZE    // cells per side of an activity tracking tile
+#define STEP_TILE_SIZE 512         // side of a temporally blocked tile
+#define STEP_DEPTH 8               // generations computed per tile visit
+
+/* Conway's Game of Life process */
+template <class T, class R = ConwayRule>
+class Conway
+{
+public:
+    
+    /* constructor */
+    Conway(int width, int height, const R& rule = R()):newGrid(width, height), oldGrid(width, height),
+        gridWidth(width), gridHeight(height), rule(rule), boundary(BOUNDARY_TORUS), pool(nullptr),
+        rowKernel(findLifeRowKernel<R>()), tracking(true),
+        tilesWide((width + TILE_SIZE - 1) / TILE_SIZE), tilesHigh((height + TILE_SIZE - 1) / TILE_SIZE),
+        tileChanged(tilesWide * tilesHigh, 1), tileActive(tilesWide * tilesHigh, 1),
+        nextTileChanged(tilesWide * tilesHigh, 1), tileRunEnd(tilesWide * tilesHigh), allDirty(true), generations(0),
+        placed(false), cancel(nullptr), hashValid(false), hashValue(0)
+    {
+    }
+    ~Conway(){};
+    
+    /* initialize grid with random values */
+    void randomInitialization(short sparseness)
+    {
+        placeGrids();
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                short b = gen();
+                if(b == 0)
+                {
+                    newGrid(i,j) = 1;
+                    oldGrid(i,j) = 1;
+                }
+                else
+                {
+                    newGrid(i,j) = 0;
+                    oldGrid(i,j) = 0;
+                }
+            }
+        }
+        allDirty = true;
+        hashValid = false;
+        generations = 0;
+    }
+
+    /* fill the grid with random cells of a density in RANDOM_DENSITY_BITS
+       fractional bits, the board of the seed (see random.h); bands of rows
+       are filled on the thread pool, and only the grid the next generation
+       is read from is written */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        placeGrids();
+        uint64_t key = randomKey(seed);
+        auto fill = [this, key, density](int band, int numBands)
+        {
+            int begin, end;
+            bandRows(band, numBands, begin, end);
+            for(int j = begin; j<end; j++)
+            {
+                randomRow(key, j, gridWidth, density, newGrid.row(j));
+            }
+        };
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run(fill);
+        }
+        else
+        {
+            fill(0, 1);
+        }
+        allDirty = true;
+        hashValid = false;
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        placeGrids();
+        newGrid.fill(0);
+        oldGrid.fill(0);
+        allDirty = true;
+        hashValid = false;
+        generations = 0;
+    }
+
+    /* set a cell, cells outside the grid are ignored */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x < 0 || y < 0 || x >= gridWidth || y >= gridHeight)
+        {
+            return;
+        }
+        placeGrids();
+        newGrid((int)x, (int)y) = alive;
+        oldGrid((int)x, (int)y) = alive;
+        allDirty = true;
+        hashValid = false;
+    }
+
+    /* set row y from bit-packed words, cell x in bit x%64 of word x/64; with
+       more planes bit p of the state of cell x is in plane p */
+    void setRow(int y, const uint64_t* words, int planes = 1)
+    {
+        placeGrids();
+        int wordsPerRow = (gridWidth + 63) / 64, states = rule.lifeRule().states;
+        T* row = newGrid.row(y);
+        for(int x = 0; x<gridWidth; x++)
+        {
+            int state = 0;
+            for(int p = 0; p<planes; p++)
+            {
+                state |= int((words[p*wordsPerRow + (x >> 6)] >> (x & 63)) & 1) << p;
+            }
+            row[x] = T(state < states ? state : 0);
+        }
+        std::copy(row, row + gridWidth, oldGrid.row(y));
+        allDirty = true;
+        hashValid = false;
+    }
+
+    /* the rule the grid is stepped by */
+    LifeRule lifeRule() const { return rule.lifeRule(); }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* step in parallel bands on a pool of threads, nullptr for single-threaded */
+    void setThreadPool(ThreadPool* threadPool)
+    {
+        pool = threadPool;
+    }
+
+    /* set what lies beyond the edges of the grid */
+    void setBoundaryPolicy(BoundaryPolicy policy)
+    {
+        boundary = policy;
+        allDirty = true;
+    }
+
+    /* select the row kernel for byte cells, nullptr for the best one available */
+    bool setRowKernel(const char* name)
+    {
+        const LifeRowKernel<R>* kernel = findLifeRowKernel<R>(name);
+        if(kernel != nullptr)
+        {
+            rowKernel = kernel;
+        }
+        return kernel != nullptr;
+    }
+
+    /* only recompute tiles near cells that changed in the last generation */
+    void setTileTracking(bool enabled)
+    {
+        tracking = enabled;
+        allDirty = true;
+    }
+
+    /* return a view of the grid */
+    GridView<T> fullGrid() const
+    {
+        return newGrid.view();
+    }
+
+    /* let go of the grid of the previous generation, which the next update
+       only writes over, for a spare one; its cells stay in releasedGrid()
+       until the next call, and every tile is recomputed at the next update,
+       as the spare holds none of them */
+    void releasePreviousGrid()
+    {
+        if(released.width() != gridWidth)
+        {
+            released = GridBuffer<T>(gridWidth, gridHeight);
+        }
+        oldGrid.swap(released);
+        allDirty = true;
+    }
+
+    /* the grid let go of by releasePreviousGrid() */
+    GridView<T> releasedGrid() const
+    {
+        return released.view();
+    }
+
+    /* tiles that changed in the last update, as index y*tilesWide + x */
+    const std::vector<int>& dirtyTiles() const
+    {
+        return dirty;
+    }
+
+    /* Zobrist hash of the grid, maintained by every generation once asked for */
+    uint64_t hash()
+    {
+        if(!hashValid)
+        {
+            tileHashes.resize(tilesWide * tilesHigh);
+            hashValue = 0;
+            for(int i = 0; i<tilesWide*tilesHigh; i++)
+            {
+                tileHashes[i] = tileHash(i);
+                hashValue ^= tileHashes[i];
+            }
+            hashValid = true;
+        }
+        return hashValue;
+    }
+
+    /* number of tiles in a row of tiles */
+    int tileColumns() const
+    {
+        return tilesWide;
+    }
+
+    /* main update loop, dropped when stop is set before it finishes */
+    void update(const std::atomic<bool>* stop = nullptr)
+    {
+        placeGrids();
+        cancel = stop;
+
+        // swap old and new grids, surround the old grid by its halo so
+        // that neighbours can be read without bounds checks
+        oldGrid.swap(newGrid);
+        oldGrid.refreshHalo(boundary);
+        if(tracking)
+        {
+            markActiveTiles();
+        }
+
+        // update grid, split in bands of rows (or rows of tiles) when running on a thread pool
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run([this](int band, int numBands)
+            {
+                int begin, end;
+                bandRows(band, numBands, begin, end);
+                updateUnits(begin, end);
+            });
+        }
+        else
+        {
+            updateUnits(0, gridHeight);
+        }
+        if(cancelled())
+        {
+            abandonGeneration();
+            return;
+        }
+
+        collectDirtyTiles();
+        updateHash();
+        generations++;
+    }
+
+    /* advance n generations, STEP_DEPTH at a time per tile; once stop is set
+       no more generations are started, and the one in progress is dropped */
+    void step(int n, const std::atomic<bool>* stop = nullptr)
+    {
+        placeGrids();
+        cancel = stop;
+
+        // a mirrored halo reflects the grid once, so it cannot be deeper than the grid
+        int depth = boundary == BOUNDARY_MIRROR ? std::min(STEP_DEPTH, std::min(gridWidth, gridHeight)) : STEP_DEPTH;
+        while(n > 0 && !cancelled())
+        {
+            int k = std::min(n, depth);
+            if(k == 1)
+            {
+                update(stop);
+            }
+            else
+            {
+                stepTiles(k);
+            }
+            n -= k;
+        }
+    }
+
+    /* compute the next state of rows [begin, end) */
+    void updateRows(int begin, int end)
+    {
+        for(int j = begin; j<end; j++)
+        {
+            updateSpan(j, 0, gridWidth, nullptr);
+        }
+    }
+
+private:
+
+    /* rows [begin, end) of a band of update(), whole rows of tiles when tracking */
+    void bandRows(int band, int numBands, int& begin, int& end) const
+    {
+        int unit = tracking ? TILE_SIZE : 1;
+        ThreadPool::bandRange(band, numBands, (gridHeight + unit - 1) / unit, begin, end);
+        begin = std::min(begin * unit, gridHeight);
+        end = std::min(end * unit, gridHeight);
+    }
+
+    /* write both grids for the first time, every band of rows on the thread
+       that steps it; the padding rows go with the first and the last band */
+    void placeGrids()
+    {
+        if(placed)
+        {
+            return;
+        }
+        placed = true;
+        auto touch = [this](int band, int numBands)
+        {
+            int begin, end;
+            bandRows(band, numBands, begin, end);
+            begin = band == 0 ? -GRID_PADDING : begin;
+            end = band == numBands-1 ? gridHeight + GRID_PADDING : end;
+            newGrid.fillRows(begin, end, T(0));
+            oldGrid.fillRows(begin, end, T(0));
+        };
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run(touch);
+        }
+        else
+        {
+            touch(0, 1);
+        }
+    }
+
+    /* advance every tile k generations, in bands of rows of tiles on the thread pool */
+    void stepTiles(int k)
+    {
+        oldGrid.swap(newGrid);
+        int bands = pool != nullptr ? pool->size() : 1;
+        if((int)scratch.size() < 2*bands)
+        {
+            scratch.resize(2*bands);
+        }
+        int rows = (gridHeight + STEP_TILE_SIZE - 1) / STEP_TILE_SIZE;
+        if(bands > 1)
+        {
+            pool->run([this, k, rows](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, rows, begin, end);
+                stepTileRows(begin, end, k, band);
+            });
+        }
+        else
+        {
+            stepTileRows(0, rows, k, 0);
+        }
+        if(cancelled())
+        {
+            abandonGeneration();
+            return;
+        }
+        generations += k;
+
+        // the tiles were not tracked, the next update recomputes all of them
+        std::fill(tileChanged.begin(), tileChanged.end(), 1);
+        std::fill(nextTileChanged.begin(), nextTileChanged.end(), 1);
+        allDirty = true;
+        collectDirtyTiles();
+        updateHash();
+    }
+
+    /* advance rows of tiles [begin, end) in the scratch buffers of a band,
+       allocated by the thread of the band on its first call */
+    void stepTileRows(int begin, int end, int k, int band)
+    {
+        GridBuffer<T>& first = scratch[2*band];
+        GridBuffer<T>& second = scratch[2*band+1];
+        if(first.width() == 0)
+        {
+            int side = STEP_TILE_SIZE + 2*STEP_DEPTH;
+            first = GridBuffer<T>(side + LIFE_BLOCK_SIZE, side);
+            second = GridBuffer<T>(side + LIFE_BLOCK_SIZE, side);
+        }
+        for(int y0 = begin * STEP_TILE_SIZE; y0<std::min(end * STEP_TILE_SIZE, gridHeight); y0 += STEP_TILE_SIZE)
+        {
+            for(int x0 = 0; x0<gridWidth && !cancelled(); x0 += STEP_TILE_SIZE)
+            {
+                stepTile(x0, y0, k, first, second);
+            }
+        }
+    }
+
+    /* advance the tile at (x0, y0) k generations; local cell (i, j) is cell
+       (x0-k+i, y0-k+j) of the grid */
+    void stepTile(int x0, int y0, int k, GridBuffer<T>& first, GridBuffer<T>& second)
+    {
+        int x1 = std::min(x0 + STEP_TILE_SIZE, gridWidth), y1 = std::min(y0 + STEP_TILE_SIZE, gridHeight);
+        int width = x1 - x0 + 2*k, height = y1 - y0 + 2*k;
+
+        // copy the tile and its halo, cells beyond the grid by the boundary policy
+        int inBegin = std::max(0, k - x0), inEnd = std::min(width, gridWidth - x0 + k);
+        for(int j = 0; j<height; j++)
+        {
+            T* out = first.row(j);
+            int y = y0 - k + j;
+            int src = y >= 0 && y < gridHeight ? y : haloSource(y, gridHeight, boundary);
+            if(src < 0)
+            {
+                std::fill(out, out + width, T(0));
+                continue;
+            }
+            const T* in = oldGrid.row(src);
+            std::copy(in + x0 - k + inBegin, in + x0 - k + inEnd, out + inBegin);
+            for(int i = 0; i<inBegin; i++)
+            {
+                out[i] = haloCell(in, x0 - k + i);
+            }
+            for(int i = inEnd; i<width; i++)
+            {
+                out[i] = haloCell(in, x0 - k + i);
+            }
+        }
+
+        // every generation is valid one cell less deep into the halo; spans
+        // are rounded up to whole blocks, which keeps the SIMD kernels off
+        // their scalar tails, into the spare columns of the scratch buffers
+        GridBuffer<T>* from = &first;
+        GridBuffer<T>* to = &second;
+        for(int s = 1; s<=k; s++)
+        {
+            int end = s + (width - 2*s + LIFE_BLOCK_SIZE - 1) / LIFE_BLOCK_SIZE * LIFE_BLOCK_SIZE;
+            for(int j = s; j<height-s; j++)
+            {
+                computeSpan(from->row(j-1), from->row(j), from->row(j+1), to->row(j), s, end, nullptr);
+            }
+            if(boundary == BOUNDARY_DEAD)
+            {
+                clearBeyondGrid(*to, x0, y0, k, s, width, height);
+            }
+            std::swap(from, to);
+        }
+
+        for(int j = k; j<height-k; j++)
+        {
+            std::copy(from->row(j) + k, from->row(j) + width - k, newGrid.row(y0 - k + j) + x0);
+        }
+    }
+
+    /* cell x beyond the ends of a row, by the boundary policy */
+    T haloCell(const T* row, int x) const
+    {
+        int src = haloSource(x, gridWidth, boundary);
+        return src < 0 ? T(0) : row[src];
+    }
+
+    /* clear the cells of a scratch buffer that lie beyond the grid, in the
+       region computed for generation s */
+    void clearBeyondGrid(GridBuffer<T>& buffer, int x0, int y0, int k, int s, int width, int height)
+    {
+        int left = std::min(std::max(k - x0, s), width - s);
+        int right = std::max(std::min(gridWidth - x0 + k, width - s), left);
+        for(int j = s; j<height-s; j++)
+        {
+            T* row = buffer.row(j);
+            if(y0 - k + j < 0 || y0 - k + j >= gridHeight)
+            {
+                std::fill(row + s, row + width - s, T(0));
+            }
+            else
+            {
+                std::fill(row + s, row + left, T(0));
+                std::fill(row + right, row + width - s, T(0));
+            }
+        }
+    }
+
+    /* rows [begin, end), by the rows of tiles they cover when tracking */
+    void updateUnits(int begin, int end)
+    {
+        if(begin >= end)
+        {
+            return;
+        }
+        if(tracking)
+        {
+            updateTileRows(begin / TILE_SIZE, (end + TILE_SIZE - 1) / TILE_SIZE);
+        }
+        else
+        {
+            for(int j = begin; j<end && !cancelled(); j += TILE_SIZE)
+            {
+                updateRows(j, std::min(j + TILE_SIZE, end));
+            }
+        }
+    }
+
+    /* has the generation in progress been cancelled */
+    bool cancelled() const
+    {
+        return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+    }
+
+    /* drop a generation that was stopped halfway; the other grid is partly
+       written, so no tile can be skipped as equal in both at the next */
+    void abandonGeneration()
+    {
+        oldGrid.swap(newGrid);
+        allDirty = true;
+    }
+
+    /* a tile is active when it or one of its eight neighbours changed */
+    void markActiveTiles()
+    {
+        for(int ty = 0; ty<tilesHigh; ty++)
+        {
+            for(int tx = 0; tx<tilesWide; tx++)
+            {
+                char active = allDirty;
+                for(int dy = -1; dy<=1 && !active; dy++)
+                {
+                    // wrap around, tiles on opposite edges meet through the halo
+                    int y = (ty + dy + tilesHigh) % tilesHigh;
+                    for(int dx = -1; dx<=1 && !active; dx++)
+                    {
+                        int x = (tx + dx + tilesWide) % tilesWide;
+                        active = tileChanged[y*tilesWide + x];
+                    }
+                }
+                tileActive[ty*tilesWide + tx] = active;
+            }
+
+            // point every tile at the end of its run of equally active tiles
+            int* next = &tileRunEnd[ty*tilesWide];
+            const char* active = &tileActive[ty*tilesWide];
+            next[tilesWide-1] = tilesWide;
+            for(int tx = tilesWide-2; tx>=0; tx--)
+            {
+                next[tx] = active[tx] == active[tx+1] ? next[tx+1] : tx+1;
+            }
+        }
+    }
+
+    /* compute the active tiles of rows of tiles [begin, end); inactive tiles
+       did not change in the last generation, so both grids already agree there */
+    void updateTileRows(int begin, int end)
+    {
+        for(int ty = begin; ty<end && !cancelled(); ty++)
+        {
+            const char* active = &tileActive[ty*tilesWide];
+            const int* next = &tileRunEnd[ty*tilesWide];
+            char* changed = &nextTileChanged[ty*tilesWide];
+            std::fill(changed, changed + tilesWide, 0);
+
+            // row by row through runs of consecutive active tiles, the row
+            // kernel flags the tiles in which a cell changed
+            int y1 = std::min((ty+1) * TILE_SIZE, gridHeight);
+            for(int j = ty * TILE_SIZE; j<y1; j++)
+            {
+                for(int tx = 0; tx<tilesWide; tx = next[tx])
+                {
+                    if(active[tx])
+                    {
+                        updateSpan(j, tx * TILE_SIZE, std::min(next[tx] * TILE_SIZE, gridWidth), changed);
+                    }
+                }
+            }
+        }
+    }
+
+    /* list the tiles that changed, all of them after a reset */
+    void collectDirtyTiles()
+    {
+        dirty.clear();
+        if(tracking)
+        {
+            tileChanged.swap(nextTileChanged);
+        }
+        for(int i = 0; i<tilesWide*tilesHigh; i++)
+        {
+            if(allDirty || !tracking || tileChanged[i])
+            {
+                dirty.push_back(i);
+            }
+        }
+        allDirty = false;
+    }
+
+    /* swap the hashes of the tiles that changed in the grid hash, when it is being kept */
+    void updateHash()
+    {
+        if(!hashValid)
+        {
+            return;
+        }
+        int bands = pool != nullptr ? pool->size() : 1;
+        if(bands > 1)
+        {
+            bandHashes.assign(bands, 0);
+            pool->run([this](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, (int)dirty.size(), begin, end);
+                bandHashes[band] = rehashTiles(begin, end);
+            });
+            for(uint64_t hash: bandHashes)
+            {
+                hashValue ^= hash;
+            }
+        }
+        else
+        {
+            hashValue ^= rehashTiles(0, (int)dirty.size());
+        }
+    }
+
+    /* rehash dirty tiles [begin, end), return the XOR of their old and new hashes */
+    uint64_t rehashTiles(int begin, int end)
+    {
+        uint64_t hash = 0;
+        for(int i = begin; i<end; i++)
+        {
+            uint64_t tile = tileHash(dirty[i]);
+            hash ^= tileHashes[dirty[i]] ^ tile;
+            tileHashes[dirty[i]] = tile;
+        }
+        return hash;
+    }
+
+    /* XOR of the keys of the words of cells in tile i of newGrid */
+    uint64_t tileHash(int i) const
+    {
+        int tx = i % tilesWide, ty = i / tilesWide;
+        int x1 = std::min((tx+1) * TILE_SIZE, gridWidth), y1 = std::min((ty+1) * TILE_SIZE, gridHeight);
+        uint64_t hash = 0;
+        for(int y = ty * TILE_SIZE; y<y1; y++)
+        {
+            const T* row = newGrid.row(y);
+            for(int x = tx * TILE_SIZE; x<x1; x += 8)
+            {
+                hash ^= wordKey(x, y, cellWord(row, x, gridWidth));
+            }
+        }
+        return hash;
+    }
+
+    /* compute the next state of cells [begin, end) of row j, flag changed tiles unless nullptr */
+    void updateSpan(int j, int begin, int end, char* changed)
+    {
+        computeSpan(oldGrid.row(j-1), oldGrid.row(j), oldGrid.row(j+1), newGrid.row(j), begin, end, changed);
+    }
+
+    /* next state of cells [begin, end) of row b, between rows a and c, into out */
+    void computeSpan(const T* a, const T* b, const T* c, T* out, int begin, int end, char* changed)
+    {
+        computeSpan(a, b, c, out, begin, end, changed, std::integral_constant<bool, sizeof(T) == 1>());
+    }
+
+    /* byte cells: the selected row kernel */
+    void computeSpan(const T* a, const T* b, const T* c, T* out, int begin, int end, char* changed, std::true_type)
+    {
+        rowKernel->run(rule, reinterpret_cast<const char*>(a), reinterpret_cast<const char*>(b),
+                       reinterpret_cast<const char*>(c), reinterpret_cast<char*>(out), begin, end, changed);
+    }
+
+    /* other cell types: the generic row kernel */
+    void computeSpan(const T* a, const T* b, const T* c, T* out, int begin, int end, char* changed, std::false_type)
+    {
+        lifeRowGeneric(rule, a, b, c, out, begin, end, changed);
+    }
+
+    GridBuffer<T> newGrid;
+    GridBuffer<T> oldGrid;
+    GridBuffer<T> released;             // of a past generation, empty until releasePreviousGrid()
+
+    int gridWidth, gridHeight;
+    R rule;
+    BoundaryPolicy boundary;
+    ThreadPool* pool;
+    const LifeRowKernel<R>* rowKernel;  // byte cells only
+
+    // activity tracking, one flag per tile
+    bool tracking;
+    int tilesWide, tilesHigh;
+    std::vector<char> tileChanged;      // changed in the last generation
+    std::vector<char> tileActive;       // recomputed in this generation
+    std::vector<char> nextTileChanged;
+    std::vector<int> tileRunEnd;        // first tile after a run of equally active tiles
+    std::vector<int> dirty;
+    bool allDirty;                      // every tile counts as changed, after a reset
+    uint64_t generations;
+    bool placed;                        // both grids were written by their bands
+    const std::atomic<bool>* cancel;    // stops the generation in progress when set, nullptr for none
+    std::vector<GridBuffer<T> > scratch;    // two buffers per band of step()
+
+    // Zobrist hash of newGrid
+    bool hashValid;                     // kept up to date, since hash() was called
+    uint64_t hashValue;
+    std::vector<uint64_t> tileHashes;   // XOR of the keys in every tile
+    std::vector<uint64_t> bandHashes;   // changes of the grid hash per band
+};
+
+/* advance a process n generations, by step() where it has one; once cancel
+   is set it stops between generations, a byte grid between tiles */
+template <class Process>
+void advance(Process& process, int n, const std::atomic<bool>* cancel = nullptr)
+{
+    for(int i = 0; i<n && (cancel == nullptr || !cancel->load(std::memory_order_relaxed)); i++)
+    {
+        process.update();
+    }
+}
+
+template <class T, class R>
+void advance(Conway<T, R>& conway, int n, const std::atomic<bool>* cancel = nullptr)
+{
+    conway.step(n, cancel);
+}
+
+template <class T, class R>
+uint64_t processHash(Conway<T, R>& conway)
+{
+    return conway.hash();
+}
+
+#endif
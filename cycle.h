@@ -0,0 +1,167 @@
+
+// Author: 	Stephan Meesters
+//
+// Grid hashing and cycle detection
+//
+// A board is hashed Zobrist style, by words of eight cells: every group of
+// eight cells that starts at a column divisible by eight has a pseudo-random
+// 64-bit key, mixed from its position and the states of its cells, and the
+// hash of the board is the XOR of the keys. The XOR does not care in which
+// order the keys are combined, so a process can keep the hash of every part
+// of the board and only rehash the parts that changed. Keys are mixed rather
+// than stored, a table would be as large as the grid.
+//
+// CycleDetector keeps the hashes of the last generations in a ring buffer.
+// When a generation hashes like one in the buffer, the board has become
+// periodic (or still, period 1) and the distance between the two is its
+// period.
+//
+
+#ifndef CONWAY_CYCLE_H
+#define CONWAY_CYCLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+#include "random.h"
+
+#define CYCLE_HISTORY_DEFAULT 64    // generations remembered, the longest period found
+
+/* states of cells [x, x+8) of a row as the bytes of a word, cells at or
+   beyond width count as dead */
+template <class T>
+uint64_t cellWord(const T* row, int x, int width)
+{
+    char bytes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for(int i = 0; i<8 && x+i < width; i++)
+    {
+        bytes[i] = (char)row[x+i];
+    }
+    uint64_t word;
+    std::memcpy(&word, bytes, 8);
+    return word;
+}
+
+inline uint64_t cellWord(const char* row, int x, int width)
+{
+    uint64_t word = 0;
+    if(x + 8 <= width)
+    {
+        std::memcpy(&word, row + x, 8);
+    }
+    else
+    {
+        std::memcpy(&word, row + x, (std::size_t)(width - x));
+    }
+    return word;
+}
+
+/* Zobrist key of the cells word starting at column x of row y */
+inline uint64_t wordKey(int x, int y, uint64_t word)
+{
+    return mixHash((((uint64_t)(uint32_t)y << 32 | (uint32_t)x) * RANDOM_GAMMA) ^ word);
+}
+
+/* hash of a grid of any cell type */
+template <class T>
+uint64_t gridHash(const GridView<T>& grid)
+{
+    uint64_t hash = 0;
+    for(int y = 0; y<grid.height(); y++)
+    {
+        const T* row = grid.row(y);
+        for(int x = 0; x<grid.width(); x += 8)
+        {
+            hash ^= wordKey(x, y, cellWord(row, x, grid.width()));
+        }
+    }
+    return hash;
+}
+
+/* hash of a bit-packed grid, eight bits at a time */
+inline uint64_t gridHash(const BitGridView& grid)
+{
+    uint64_t hash = 0;
+    for(int y = 0; y<grid.height(); y++)
+    {
+        const uint64_t* row = grid.row(y);
+        for(int x = 0; x<grid.width(); x += 8)
+        {
+            unsigned bits = (unsigned)(row[x >> 6] >> (x & 63)) & 0xff;
+            if(x + 8 > grid.width())
+            {
+                bits &= (1u << (grid.width() - x)) - 1;
+            }
+            char bytes[8];
+            for(int i = 0; i<8; i++)
+            {
+                bytes[i] = (char)((bits >> i) & 1);
+            }
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            hash ^= wordKey(x, y, word);
+        }
+    }
+    return hash;
+}
+
+/* hash of the grid of a process, processes that keep their hash overload it */
+template <class Process>
+uint64_t processHash(Process& process)
+{
+    return gridHash(process.fullGrid());
+}
+
+/* hashes of the last generations of a board */
+class CycleDetector
+{
+public:
+
+    /* constructor, remembers history generations */
+    explicit CycleDetector(int history = CYCLE_HISTORY_DEFAULT):hashes(history > 0 ? history : 1),
+        generations(hashes.size()), count(0), next(0), cyclePeriod(0)
+    {
+    }
+
+    /* forget all generations */
+    void clear()
+    {
+        count = next = 0;
+        cyclePeriod = 0;
+    }
+
+    /* record the hash of a generation, true when an earlier generation in
+       the history hashed the same */
+    bool add(uint64_t hash, uint64_t generation)
+    {
+        for(int i = 0; i<count; i++)
+        {
+            if(hashes[i] == hash && generations[i] < generation)
+            {
+                cyclePeriod = generation - generations[i];
+                return true;
+            }
+        }
+        hashes[next] = hash;
+        generations[next] = generation;
+        next = (next + 1) % (int)hashes.size();
+        count = std::min(count + 1, (int)hashes.size());
+        return false;
+    }
+
+    /* generations between the repeating generations, once add() found them */
+    uint64_t period() const { return cyclePeriod; }
+
+private:
+
+    std::vector<uint64_t> hashes;
+    std::vector<uint64_t> generations;
+    int count;              // hashes in the ring buffer
+    int next;               // slot of the next hash
+    uint64_t cyclePeriod;
+};
+
+#endif
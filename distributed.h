@@ -0,0 +1,578 @@
+
+// Author: 	Stephan Meesters
+//
+// Game of Life distributed over MPI ranks
+//
+// DistributedLife splits a torus into a 2D grid of blocks, one per rank of
+// a periodic Cartesian communicator. Block columns start at multiples of
+// 64 cells, so every rank owns whole words of the bit-packed rows of a
+// snapshot. A rank keeps its block in byte cells, surrounded by a halo of
+// haloDepth cells that mirrors the edges of the eight neighbouring blocks,
+// and steps it with the row kernels of the byte engine (see kernels.h).
+//
+// The halo is exchanged once every haloDepth generations. Its eight strips
+// are packed, sent and received without blocking, and while they are in
+// flight every generation is computed over the inner part of the block
+// that only depends on cells the rank owns, one cell smaller on every side
+// per generation. Once the strips have arrived the frame between the inner
+// part and the shrinking valid region is filled in. After k generations the
+// region that is still exact is the block itself, so a deeper halo trades a
+// little redundant computation for k times fewer messages.
+//
+// Snapshots are read and written with collective MPI-IO in the format of
+// snapshot.h: rank 0 writes the header, every rank its rows of words through
+// a subarray view of the file.
+//
+
+#ifndef CONWAY_DISTRIBUTED_H
+#define CONWAY_DISTRIBUTED_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "kernels.h"
+#include "rule.h"
+#include "cycle.h"
+#include "random.h"
+#include "snapshot.h"
+
+#define DISTRIBUTED_DIRECTIONS 9        // (dx+1) + 3*(dy+1), the middle one unused
+
+/* Game of Life on the blocks of a torus, one per rank */
+template <class R = ConwayRule>
+class DistributedLife
+{
+public:
+
+    /* constructor, open() splits the grid between the ranks */
+    DistributedLife(int width, int height, const R& rule = R()):gridWidth(width), gridHeight(height), rule(rule),
+        comm(MPI_COMM_NULL), rankIndex(0), rankCount(1), depth(1), x0(0), y0(0), blockWidth(0), blockHeight(0),
+        pool(nullptr), rowKernel(findLifeRowKernel<R>()), generations(0)
+    {
+    }
+
+    ~DistributedLife()
+    {
+        if(comm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&comm);
+        }
+    }
+
+    DistributedLife(DistributedLife const&) = delete;
+    DistributedLife& operator=(DistributedLife const&) = delete;
+
+    /* split the grid between the ranks of a communicator, with a halo of
+       haloDepth cells or as deep as the smallest block allows; collective,
+       false with the reason on every rank if the grid is too small */
+    bool open(MPI_Comm world, int haloDepth, std::string& error)
+    {
+        // blocks as square as they come, but no more columns of blocks than words in a row
+        int size, dims[2] = {0, 0}, periods[2] = {1, 1}, coords[2], wordsPerRow = (gridWidth + 63) / 64;
+        MPI_Comm_size(world, &size);
+        MPI_Dims_create(size, 2, dims);
+        for(int columns = dims[1]; columns > wordsPerRow; )
+        {
+            for(columns = wordsPerRow; size % columns != 0; columns--);
+            dims[0] = size / columns;
+            dims[1] = columns;
+        }
+        MPI_Cart_create(world, 2, dims, periods, 1, &comm);
+        MPI_Comm_rank(comm, &rankIndex);
+        MPI_Comm_size(comm, &rankCount);
+        MPI_Cart_coords(comm, rankIndex, 2, coords);
+        blocksWide = dims[1];
+        blocksHigh = dims[0];
+
+        // columns in whole words, rows as they come
+        int begin, end;
+        ThreadPool::bandRange(coords[1], blocksWide, wordsPerRow, begin, end);
+        x0 = begin * 64;
+        blockWidth = std::max(std::min(end * 64, gridWidth) - x0, 0);
+        ThreadPool::bandRange(coords[0], blocksHigh, gridHeight, begin, end);
+        y0 = begin;
+        blockHeight = end - begin;
+
+        int smallest = std::min(blockWidth, blockHeight);
+        MPI_Allreduce(MPI_IN_PLACE, &smallest, 1, MPI_INT, MPI_MIN, comm);
+        if(smallest < 1)
+        {
+            error = "the grid is too small for " + std::to_string(rankCount) + " ranks of " +
+                    std::to_string(blocksWide) + "x" + std::to_string(blocksHigh) + " blocks";
+            return false;
+        }
+        depth = std::max(std::min(haloDepth, smallest), 1);
+
+        for(int dy = -1; dy<=1; dy++)
+        {
+            for(int dx = -1; dx<=1; dx++)
+            {
+                int d = direction(dx, dy), at[2] = {coords[0] + dy, coords[1] + dx};
+                MPI_Cart_rank(comm, at, &neighbours[d]);
+                int w = dx == 0 ? blockWidth : depth, h = dy == 0 ? blockHeight : depth;
+                sendStrips[d].resize((std::size_t)w * h);
+                receiveStrips[d].resize((std::size_t)w * h);
+            }
+        }
+        newGrid = GridBuffer<char>(blockWidth + 2*depth, blockHeight + 2*depth);
+        oldGrid = GridBuffer<char>(blockWidth + 2*depth, blockHeight + 2*depth);
+        generations = 0;
+        return true;
+    }
+
+    /* step the inner part of the block in parallel bands, nullptr for single-threaded */
+    void setThreadPool(ThreadPool* threadPool)
+    {
+        pool = threadPool;
+    }
+
+    /* fill the block with its part of the board of a seed (see random.h), the
+       same board a single process draws */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        uint64_t wordsPerRow = (gridWidth + 63) / 64;
+        for(int y = 0; y<blockHeight; y++)
+        {
+            char* row = cells(y);
+            for(int x = 0; x<blockWidth; x += 64)
+            {
+                uint64_t word = randomCells(key, (uint64_t)(y0 + y) * wordsPerRow + (x0 + x) / 64, density);
+                for(int i = 0; i<std::min(64, blockWidth - x); i++)
+                {
+                    row[x+i] = char((word >> i) & 1);
+                }
+            }
+        }
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        newGrid.fill(0);
+        generations = 0;
+    }
+
+    /* set a cell, cells of other blocks are left to their ranks */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x >= x0 && x < x0 + blockWidth && y >= y0 && y < y0 + blockHeight)
+        {
+            cells((int)(y - y0))[x - x0] = alive;
+        }
+    }
+
+    /* the rule the grid is stepped by */
+    LifeRule lifeRule() const { return rule.lifeRule(); }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* one generation, collective */
+    void update()
+    {
+        step(1);
+    }
+
+    /* advance n generations, one halo exchange per depth of them; collective */
+    void step(int n)
+    {
+        while(n > 0)
+        {
+            int k = std::min(n, depth);
+            stepBlock(k);
+            n -= k;
+        }
+    }
+
+    /* the cells of this rank's block; cell (0, 0) is cell (blockX(), blockY()) of the grid */
+    GridView<char> localGrid() const
+    {
+        return GridView<char>(newGrid.row(depth) + depth, blockWidth, blockHeight, newGrid.stride());
+    }
+
+    int blockX() const { return x0; }
+    int blockY() const { return y0; }
+    int rank() const { return rankIndex; }
+    int ranks() const { return rankCount; }
+    int blockColumns() const { return blocksWide; }
+    int blockRows() const { return blocksHigh; }
+    int haloDepth() const { return depth; }
+
+    /* live cells of the whole grid, collective */
+    uint64_t population() const
+    {
+        uint64_t count = 0;
+        for(int y = 0; y<blockHeight; y++)
+        {
+            const char* row = cells(y);
+            for(int x = 0; x<blockWidth; x++)
+            {
+                count += row[x] != 0;
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_UINT64_T, MPI_SUM, comm);
+        return count;
+    }
+
+    /* Zobrist hash of the whole grid (see cycle.h), the XOR of the hashes of
+       the blocks; blocks start at multiples of 8 columns, so their words are
+       the words of the grid; collective */
+    uint64_t hash() const
+    {
+        uint64_t value = 0;
+        for(int y = 0; y<blockHeight; y++)
+        {
+            const char* row = cells(y);
+            for(int x = 0; x<blockWidth; x += 8)
+            {
+                value ^= wordKey(x0 + x, y0 + y, cellWord(row, x, blockWidth));
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_UINT64_T, MPI_BXOR, comm);
+        return value;
+    }
+
+    /* write the grid as an uncompressed snapshot, through a temporary file;
+       collective, false with the reason on every rank */
+    bool writeSnapshot(const char* path, std::string& error)
+    {
+        Snapshot snapshot;
+        snapshot.backend = SNAPSHOT_BYTE;
+        snapshot.boundary = BOUNDARY_TORUS;
+        snapshot.rule = ruleString(rule.lifeRule());
+        snapshot.width = gridWidth;
+        snapshot.height = gridHeight;
+        snapshot.generation = generations;
+        snapshot.wordsPerRow = (gridWidth + 63) / 64;
+        SnapshotHeader header = snapshotHeader(snapshot, SNAPSHOT_RAW, snapshot.wordsPerRow * gridHeight);
+
+        int localWords = (blockWidth + 63) / 64;
+        std::vector<uint64_t> words((std::size_t)localWords * blockHeight);
+        GridView<char> grid = localGrid();
+        for(int y = 0; y<blockHeight; y++)
+        {
+            packRow(grid, y, &words[(std::size_t)y * localWords]);
+        }
+
+        std::string temporary = std::string(path) + ".tmp";
+        MPI_File file;
+        if(MPI_File_open(comm, temporary.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        {
+            error = "cannot create " + temporary;
+            return false;
+        }
+        bool written = MPI_File_set_size(file, sizeof(header) + header.payloadWords * sizeof(uint64_t)) == MPI_SUCCESS;
+        if(rankIndex == 0)
+        {
+            written = MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS && written;
+        }
+        written = transferBlock(file, words, localWords, true) && written;
+        written = MPI_File_close(&file) == MPI_SUCCESS && written;
+        int renamed = agree(written);
+        if(renamed && rankIndex == 0)
+        {
+            renamed = std::rename(temporary.c_str(), path) == 0;
+        }
+        MPI_Bcast(&renamed, 1, MPI_INT, 0, comm);
+        written = renamed != 0;
+        if(!written)
+        {
+            error = std::string("cannot write ") + path;
+        }
+        return written;
+    }
+
+    /* restore the grid from an uncompressed snapshot of a bounded grid of the
+       same size and rule; collective, false with the reason on every rank */
+    bool restoreSnapshot(const char* path, std::string& error)
+    {
+        MPI_File file;
+        if(MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        {
+            error = "cannot open file";
+            return false;
+        }
+        SnapshotHeader header;
+        MPI_Offset size = 0;
+        MPI_File_get_size(file, &size);
+        bool valid = size >= (MPI_Offset)sizeof(header) &&
+                     MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        if(!valid)
+        {
+            error = "not a snapshot";
+        }
+        else if(!checkSnapshotHeader(header, ruleString(rule.lifeRule()), error))
+        {
+            valid = false;
+        }
+        else if(header.backend != SNAPSHOT_BYTE && header.backend != SNAPSHOT_BIT && header.backend != SNAPSHOT_LTL)
+        {
+            error = "snapshot is not of a bounded grid";
+            valid = false;
+        }
+        else if(header.width != gridWidth || header.height != gridHeight || header.wordsPerRow != (uint64_t)(gridWidth + 63) / 64 ||
+                std::max<int>(header.planes, 1) != 1)
+        {
+            error = "snapshot is of a " + std::to_string(header.width) + "x" + std::to_string(header.height) + " grid";
+            valid = false;
+        }
+        else if(header.compression != SNAPSHOT_RAW)
+        {
+            error = "snapshots are only restored in parallel without run-length encoding";
+            valid = false;
+        }
+        else if(header.payloadWords != header.wordsPerRow * gridHeight ||
+                (uint64_t)size != sizeof(header) + header.payloadWords * sizeof(uint64_t))
+        {
+            error = "snapshot is damaged";
+            valid = false;
+        }
+
+        // every rank read the same header, they agree on all but the payload
+        int localWords = (blockWidth + 63) / 64;
+        std::vector<uint64_t> words((std::size_t)localWords * blockHeight);
+        if(valid && !agree(transferBlock(file, words, localWords, false)))
+        {
+            error = "snapshot is truncated";
+            valid = false;
+        }
+        MPI_File_close(&file);
+        if(!valid)
+        {
+            return false;
+        }
+        for(int y = 0; y<blockHeight; y++)
+        {
+            char* row = cells(y);
+            const uint64_t* in = &words[(std::size_t)y * localWords];
+            for(int x = 0; x<blockWidth; x++)
+            {
+                row[x] = char((in[x >> 6] >> (x & 63)) & 1);
+            }
+        }
+        generations = header.generation;
+        return true;
+    }
+
+private:
+
+    /* index of a direction, the strips of opposite directions add up to 8 */
+    static int direction(int dx, int dy)
+    {
+        return (dx + 1) + 3*(dy + 1);
+    }
+
+    /* row y of the block, -depth <= y < blockHeight + depth */
+    char* cells(int y)
+    {
+        return newGrid.row(depth + y) + depth;
+    }
+    const char* cells(int y) const
+    {
+        return newGrid.row(depth + y) + depth;
+    }
+
+    /* the strip of a direction in buffer coordinates, the edge of the block
+       that is sent or the part of the halo it is received in */
+    void strip(int dx, int dy, bool halo, int& x, int& y, int& w, int& h) const
+    {
+        x = dx < 0 ? (halo ? 0 : depth) : dx == 0 ? depth : (halo ? blockWidth + depth : blockWidth);
+        y = dy < 0 ? (halo ? 0 : depth) : dy == 0 ? depth : (halo ? blockHeight + depth : blockHeight);
+        w = dx == 0 ? blockWidth : depth;
+        h = dy == 0 ? blockHeight : depth;
+    }
+
+    /* copy a strip of newGrid to or from its buffer */
+    void copyStrip(int dx, int dy, bool halo, std::vector<char>& buffer, bool pack)
+    {
+        int x, y, w, h;
+        strip(dx, dy, halo, x, y, w, h);
+        for(int j = 0; j<h; j++)
+        {
+            char* row = newGrid.row(y + j) + x;
+            char* packed = &buffer[(std::size_t)j * w];
+            if(pack)
+            {
+                std::copy(row, row + w, packed);
+            }
+            else
+            {
+                std::copy(packed, packed + w, row);
+            }
+        }
+    }
+
+    /* advance k <= depth generations with one halo exchange */
+    void stepBlock(int k)
+    {
+        // post the exchange: the strip sent towards a neighbour is the one it
+        // receives from the opposite direction, and is tagged with the direction
+        MPI_Request requests[2 * DISTRIBUTED_DIRECTIONS];
+        int count = 0;
+        for(int dy = -1; dy<=1; dy++)
+        {
+            for(int dx = -1; dx<=1; dx++)
+            {
+                int d = direction(dx, dy);
+                if(dx == 0 && dy == 0)
+                {
+                    continue;
+                }
+                MPI_Irecv(receiveStrips[d].data(), (int)receiveStrips[d].size(), MPI_CHAR, neighbours[d],
+                          DISTRIBUTED_DIRECTIONS - 1 - d, comm, &requests[count++]);
+                copyStrip(dx, dy, false, sendStrips[d], true);
+                MPI_Isend(sendStrips[d].data(), (int)sendStrips[d].size(), MPI_CHAR, neighbours[d], d, comm, &requests[count++]);
+            }
+        }
+
+        // generation s lives in newGrid for even s and in oldGrid for odd s;
+        // the inner part of generation s + 2 never covers the cells the frame
+        // of generation s + 1 reads, so both passes share the two buffers
+        int width = blockWidth + 2*depth, height = blockHeight + 2*depth;
+        for(int s = 1; s<=k; s++)
+        {
+            int left = depth + s, right = std::max(left, blockWidth + depth - s);
+            int top = depth + s, bottom = std::max(top, blockHeight + depth - s);
+            GridBuffer<char>& from = s % 2 ? newGrid : oldGrid;
+            GridBuffer<char>& to = s % 2 ? oldGrid : newGrid;
+            computeRows(from, to, top, bottom, left, right);
+
+            // let the transfers progress between generations
+            int done;
+            MPI_Testall(count, requests, &done, MPI_STATUSES_IGNORE);
+        }
+        MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+        for(int dy = -1; dy<=1; dy++)
+        {
+            for(int dx = -1; dx<=1; dx++)
+            {
+                if(dx != 0 || dy != 0)
+                {
+                    copyStrip(dx, dy, true, receiveStrips[direction(dx, dy)], false);
+                }
+            }
+        }
+
+        // the frame between the valid region and the inner part
+        for(int s = 1; s<=k; s++)
+        {
+            int left = depth + s, right = std::max(left, blockWidth + depth - s);
+            int top = depth + s, bottom = std::max(top, blockHeight + depth - s);
+            const GridBuffer<char>& from = s % 2 ? newGrid : oldGrid;
+            GridBuffer<char>& to = s % 2 ? oldGrid : newGrid;
+            for(int j = s; j<height-s; j++)
+            {
+                if(j >= top && j < bottom)
+                {
+                    computeSpan(from, to, j, s, left);
+                    computeSpan(from, to, j, right, width - s);
+                }
+                else
+                {
+                    computeSpan(from, to, j, s, width - s);
+                }
+            }
+        }
+        if(k % 2)
+        {
+            newGrid.swap(oldGrid);
+        }
+        generations += k;
+    }
+
+    /* rows [top, bottom) of cells [left, right), in bands on the thread pool */
+    void computeRows(const GridBuffer<char>& from, GridBuffer<char>& to, int top, int bottom, int left, int right)
+    {
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run([&](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, bottom - top, begin, end);
+                for(int j = top + begin; j<top + end; j++)
+                {
+                    computeSpan(from, to, j, left, right);
+                }
+            });
+        }
+        else
+        {
+            for(int j = top; j<bottom; j++)
+            {
+                computeSpan(from, to, j, left, right);
+            }
+        }
+    }
+
+    /* next state of cells [begin, end) of row j */
+    void computeSpan(const GridBuffer<char>& from, GridBuffer<char>& to, int j, int begin, int end)
+    {
+        if(begin < end)
+        {
+            rowKernel->run(rule, from.row(j-1), from.row(j), from.row(j+1), to.row(j), begin, end, nullptr);
+        }
+    }
+
+    /* read or write the words of the block through a subarray view of the
+       payload of a snapshot file; collective */
+    bool transferBlock(MPI_File file, std::vector<uint64_t>& words, int localWords, bool write)
+    {
+        int sizes[2] = {gridHeight, (gridWidth + 63) / 64};
+        int subsizes[2] = {blockHeight, localWords};
+        int starts[2] = {y0, x0 / 64};
+        MPI_Datatype block;
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_UINT64_T, &block);
+        MPI_Type_commit(&block);
+        bool done = MPI_File_set_view(file, sizeof(SnapshotHeader), MPI_UINT64_T, block, "native", MPI_INFO_NULL) == MPI_SUCCESS;
+        if(write)
+        {
+            done = MPI_File_write_all(file, words.data(), (int)words.size(), MPI_UINT64_T, MPI_STATUS_IGNORE) == MPI_SUCCESS && done;
+        }
+        else
+        {
+            done = MPI_File_read_all(file, words.data(), (int)words.size(), MPI_UINT64_T, MPI_STATUS_IGNORE) == MPI_SUCCESS && done;
+        }
+        MPI_Type_free(&block);
+        return done;
+    }
+
+    /* true when every rank is; collective */
+    bool agree(bool value) const
+    {
+        int all = value;
+        MPI_Allreduce(MPI_IN_PLACE, &all, 1, MPI_INT, MPI_LAND, comm);
+        return all != 0;
+    }
+
+    int gridWidth, gridHeight;
+    R rule;
+
+    MPI_Comm comm;              // periodic Cartesian communicator
+    int rankIndex, rankCount;
+    int blocksWide, blocksHigh;
+    int depth;                  // of the halo
+    int x0, y0;                 // position of the block in the grid
+    int blockWidth, blockHeight;
+    int neighbours[DISTRIBUTED_DIRECTIONS];
+    std::vector<char> sendStrips[DISTRIBUTED_DIRECTIONS];
+    std::vector<char> receiveStrips[DISTRIBUTED_DIRECTIONS];
+
+    // the block and its halo, the current generation and a buffer for the next
+    GridBuffer<char> newGrid;
+    GridBuffer<char> oldGrid;
+
+    ThreadPool* pool;
+    const LifeRowKernel<R>* rowKernel;
+    uint64_t generations;
+};
+
+#endif
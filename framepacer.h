@@ -0,0 +1,57 @@
+
+// Author: 	Stephan Meesters
+//
+// Deadline based pacing of a loop to a fixed rate
+//
+// Instead of sleeping a fixed time after every iteration, the pacer sleeps
+// until the next deadline, so the time already spent on an iteration counts
+// towards its period. When a loop falls more than a period behind it starts
+// counting again from now instead of rushing to catch up.
+//
+
+#ifndef CONWAY_FRAMEPACER_H
+#define CONWAY_FRAMEPACER_H
+
+#include <chrono>
+#include <thread>
+
+/* paces a loop to a number of iterations per second */
+class FramePacer
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    /* constructor, a rate of zero or less does not wait at all */
+    explicit FramePacer(double rate):
+        period(rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)) : Clock::duration::zero()),
+        deadline(Clock::now() + period)
+    {
+    }
+
+    /* wait until the end of the current period */
+    void wait()
+    {
+        if(period == Clock::duration::zero())
+        {
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        if(now < deadline)
+        {
+            std::this_thread::sleep_until(deadline);
+        }
+        else if(now - deadline > period)
+        {
+            deadline = now;
+        }
+        deadline += period;
+    }
+
+private:
+
+    Clock::duration period;
+    Clock::time_point deadline;
+};
+
+#endif
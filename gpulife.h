@@ -0,0 +1,525 @@
+
+// Author: 	Stephan Meesters
+//
+// Game of Life process on the GPU with OpenGL compute shaders
+//
+// Both generations live in shader storage buffers on the device, bit-packed
+// like BitConway: 32 cells to a uint, with every row padded to whole 64-bit
+// words so that a row reads back as the words of a BitGridView. A
+// generation is a single dispatch of one invocation per word that sums the
+// neighbours with bit-sliced adders and writes the other buffer. Then the
+// two buffers swap roles.
+//
+// The cells stay on the device. draw() renders them with a fragment shader
+// that reads the current buffer directly, so the window needs no readback.
+// fullGrid() copies the grid back to the host only when it is asked for,
+// e.g. for snapshots and headless output. Cells set on the host are
+// uploaded before the next step or draw.
+//
+// OpenGL 4.3 is needed. The functions are looked up through the loader of
+// the context, SDL_GL_GetProcAddress or eglGetProcAddress, so nothing links
+// against libGL.
+//
+
+#ifndef CONWAY_GPULIFE_H
+#define CONWAY_GPULIFE_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+#include <GL/glcorearb.h>
+
+#include "grid.h"
+#include "rule.h"
+#include "random.h"
+
+#define GPU_WORKGROUP_SIZE 64   // invocations per workgroup, one word each
+
+/* looks up an OpenGL function of the current context */
+typedef void* (*GpuLoader)(const char* name);
+
+/* the OpenGL functions the process uses, as X(type, name) */
+#define GPU_FUNCTIONS(X) \
+    X(PFNGLGETSTRINGPROC, GetString) \
+    X(PFNGLGETINTEGERVPROC, GetIntegerv) \
+    X(PFNGLGENBUFFERSPROC, GenBuffers) \
+    X(PFNGLDELETEBUFFERSPROC, DeleteBuffers) \
+    X(PFNGLBINDBUFFERPROC, BindBuffer) \
+    X(PFNGLBUFFERDATAPROC, BufferData) \
+    X(PFNGLBUFFERSUBDATAPROC, BufferSubData) \
+    X(PFNGLGETBUFFERSUBDATAPROC, GetBufferSubData) \
+    X(PFNGLBINDBUFFERBASEPROC, BindBufferBase) \
+    X(PFNGLCREATESHADERPROC, CreateShader) \
+    X(PFNGLSHADERSOURCEPROC, ShaderSource) \
+    X(PFNGLCOMPILESHADERPROC, CompileShader) \
+    X(PFNGLGETSHADERIVPROC, GetShaderiv) \
+    X(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog) \
+    X(PFNGLDELETESHADERPROC, DeleteShader) \
+    X(PFNGLCREATEPROGRAMPROC, CreateProgram) \
+    X(PFNGLATTACHSHADERPROC, AttachShader) \
+    X(PFNGLLINKPROGRAMPROC, LinkProgram) \
+    X(PFNGLGETPROGRAMIVPROC, GetProgramiv) \
+    X(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog) \
+    X(PFNGLDELETEPROGRAMPROC, DeleteProgram) \
+    X(PFNGLUSEPROGRAMPROC, UseProgram) \
+    X(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation) \
+    X(PFNGLUNIFORM1IPROC, Uniform1i) \
+    X(PFNGLUNIFORM1UIPROC, Uniform1ui) \
+    X(PFNGLUNIFORM2IPROC, Uniform2i) \
+    X(PFNGLUNIFORM2FPROC, Uniform2f) \
+    X(PFNGLUNIFORM4FPROC, Uniform4f) \
+    X(PFNGLDISPATCHCOMPUTEPROC, DispatchCompute) \
+    X(PFNGLMEMORYBARRIERPROC, MemoryBarrier) \
+    X(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays) \
+    X(PFNGLDELETEVERTEXARRAYSPROC, DeleteVertexArrays) \
+    X(PFNGLBINDVERTEXARRAYPROC, BindVertexArray) \
+    X(PFNGLDRAWARRAYSPROC, DrawArrays) \
+    X(PFNGLVIEWPORTPROC, Viewport) \
+    X(PFNGLFINISHPROC, Finish)
+
+/* one generation, an invocation per word of the new grid */
+static const char* const gpuStepShader = R"(#version 430
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) readonly buffer OldGrid { uint oldCells[]; };
+layout(std430, binding = 1) writeonly buffer NewGrid { uint newCells[]; };
+uniform ivec2 size;         // cells
+uniform int rowWords;       // uints per row, including the padding
+uniform int boundary;       // BoundaryPolicy
+uniform uint birth, survival;
+
+// cell inside [0, n) at i, -1 for a dead cell, as haloSource()
+int source(int i, int n)
+{
+    if(i >= 0 && i < n) return i;
+    if(boundary == 0) return i < 0 ? n - 1 - (-i - 1) % n : i % n;     // % of a negative is undefined
+    if(boundary == 2) return i < 0 ? min(-i-1, n-1) : max(2*n-1-i, 0);
+    return -1;
+}
+
+uint word(int row, int x)
+{
+    return row < 0 ? 0u : oldCells[row*rowWords + x];
+}
+
+uint cell(int row, int x)
+{
+    x = source(x, size.x);
+    return row < 0 || x < 0 ? 0u : (oldCells[row*rowWords + (x >> 5)] >> (x & 31)) & 1u;
+}
+
+// a row of words shifted west and east, with the halo cells at both ends
+void shifted(int row, int i, int lastWord, int lastBit, out uint w, out uint c, out uint e)
+{
+    c = word(row, i);
+    w = (c << 1) | (i > 0 ? word(row, i-1) >> 31 : cell(row, -1));
+    e = (c >> 1) | (i < lastWord ? word(row, i+1) << 31 : cell(row, size.x) << lastBit);
+}
+
+// add a one-bit number to the bit planes of the counts
+void add(inout uint n0, inout uint n1, inout uint n2, inout uint n3, uint x)
+{
+    uint k0 = n0 & x;
+    n0 ^= x;
+    uint k1 = n1 & k0;
+    n1 ^= k0;
+    uint k2 = n2 & k1;
+    n2 ^= k1;
+    n3 |= k2;
+}
+
+void main()
+{
+    int i = int(gl_GlobalInvocationID.x), y = int(gl_GlobalInvocationID.y);
+    int lastWord = (size.x - 1) >> 5, lastBit = (size.x - 1) & 31;
+    if(i >= rowWords || y >= size.y) return;
+    if(i > lastWord)
+    {
+        newCells[y*rowWords + i] = 0u;
+        return;
+    }
+    uint aw, a, ae, bw, b, be, cw, c, ce;
+    shifted(source(y-1, size.y), i, lastWord, lastBit, aw, a, ae);
+    shifted(y, i, lastWord, lastBit, bw, b, be);
+    shifted(source(y+1, size.y), i, lastWord, lastBit, cw, c, ce);
+    uint n0 = 0u, n1 = 0u, n2 = 0u, n3 = 0u;
+    add(n0, n1, n2, n3, aw); add(n0, n1, n2, n3, a); add(n0, n1, n2, n3, ae);
+    add(n0, n1, n2, n3, bw); add(n0, n1, n2, n3, be);
+    add(n0, n1, n2, n3, cw); add(n0, n1, n2, n3, c); add(n0, n1, n2, n3, ce);
+
+    uint next = 0u;
+    for(int k = 0; k<9; k++)
+    {
+        uint count = ((k & 1) != 0 ? n0 : ~n0) & ((k & 2) != 0 ? n1 : ~n1) &
+                     ((k & 4) != 0 ? n2 : ~n2) & ((k & 8) != 0 ? n3 : ~n3);
+        uint born = ((birth >> k) & 1u) != 0u ? ~b : 0u;
+        uint kept = ((survival >> k) & 1u) != 0u ? b : 0u;
+        next |= count & (born | kept);
+    }
+    if(i == lastWord && lastBit < 31)
+    {
+        next &= (2u << lastBit) - 1u;    // keep the bits past the width clear
+    }
+    newCells[y*rowWords + i] = next;
+}
+)";
+
+/* a triangle covering the viewport */
+static const char* const gpuVertexShader = R"(#version 430
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+/* the cell under every pixel, read from the grid buffer */
+static const char* const gpuFragmentShader = R"(#version 430
+layout(std430, binding = 0) readonly buffer Grid { uint cells[]; };
+uniform ivec2 size;
+uniform int rowWords;
+uniform vec2 viewport;
+uniform vec4 alive, dead;
+out vec4 colour;
+
+void main()
+{
+    int x = min(int(gl_FragCoord.x * float(size.x) / viewport.x), size.x - 1);
+    int y = min(int((viewport.y - gl_FragCoord.y) * float(size.y) / viewport.y), size.y - 1);
+    uint bit = (cells[y*rowWords + (x >> 5)] >> (x & 31)) & 1u;
+    colour = bit != 0u ? alive : dead;
+}
+)";
+
+/* Game of Life process with its grid on the GPU */
+class GpuLife
+{
+public:
+
+    /* constructor, open() sets up the device side */
+    GpuLife(int width, int height):gridWidth(width), gridHeight(height),
+        wordsPerRow((width + 63) / 64), rule(ConwayRule::lifeRule()), boundary(BOUNDARY_TORUS),
+        host((std::size_t)wordsPerRow * height, 0), hostNewer(true), deviceNewer(false), generations(0),
+        stepProgram(0), drawProgram(0), vertexArray(0), current(0)
+    {
+        buffers[0] = buffers[1] = 0;
+    }
+
+    ~GpuLife()
+    {
+        if(gl.DeleteBuffers != nullptr)
+        {
+            gl.DeleteBuffers(2, buffers);
+            gl.DeleteProgram(stepProgram);
+            gl.DeleteProgram(drawProgram);
+            gl.DeleteVertexArrays(1, &vertexArray);
+        }
+    }
+
+    GpuLife(GpuLife const&) = delete;
+    GpuLife& operator=(GpuLife const&) = delete;
+
+    /* look up the functions, compile the shaders and create the grid buffers
+       in the current OpenGL context; false with a message if it cannot */
+    bool open(GpuLoader loader, std::string& error)
+    {
+#define GPU_LOAD(type, name) gl.name = reinterpret_cast<type>(loader("gl" #name)); \
+        if(gl.name == nullptr) { error = "OpenGL function gl" #name " is missing"; return false; }
+        GPU_FUNCTIONS(GPU_LOAD)
+#undef GPU_LOAD
+        GLint major = 0, minor = 0;
+        gl.GetIntegerv(GL_MAJOR_VERSION, &major);
+        gl.GetIntegerv(GL_MINOR_VERSION, &minor);
+        if(major < 4 || (major == 4 && minor < 3))
+        {
+            error = "OpenGL 4.3 is needed, the context has " + std::to_string(major) + "." + std::to_string(minor);
+            return false;
+        }
+        stepProgram = link({compile(GL_COMPUTE_SHADER, gpuStepShader, error)}, error);
+        drawProgram = link({compile(GL_VERTEX_SHADER, gpuVertexShader, error),
+                            compile(GL_FRAGMENT_SHADER, gpuFragmentShader, error)}, error);
+        if(stepProgram == 0 || drawProgram == 0)
+        {
+            return false;
+        }
+        gl.GenVertexArrays(1, &vertexArray);
+        gl.GenBuffers(2, buffers);
+        for(int k = 0; k<2; k++)
+        {
+            gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[k]);
+            gl.BufferData(GL_SHADER_STORAGE_BUFFER, host.size() * sizeof(uint64_t), nullptr, GL_DYNAMIC_COPY);
+        }
+        gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        hostNewer = true;
+        return true;
+    }
+
+    /* initialize grid with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        std::fill(host.begin(), host.end(), uint64_t(0));
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                if(gen() == 0)
+                {
+                    host[(std::size_t)j * wordsPerRow + (i >> 6)] |= uint64_t(1) << (i & 63);
+                }
+            }
+        }
+        hostChanged();
+        generations = 0;
+    }
+
+    /* fill the grid with random cells of a density in RANDOM_DENSITY_BITS
+       fractional bits, the board of the seed (see random.h) */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        for(int j = 0; j<gridHeight; j++)
+        {
+            randomRow(key, j, gridWidth, density, &host[(std::size_t)j * wordsPerRow]);
+        }
+        hostChanged();
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        std::fill(host.begin(), host.end(), uint64_t(0));
+        hostChanged();
+        generations = 0;
+    }
+
+    /* set a cell, cells outside the grid are ignored */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x < 0 || y < 0 || x >= gridWidth || y >= gridHeight)
+        {
+            return;
+        }
+        readBack();
+        uint64_t bit = uint64_t(1) << (x & 63);
+        uint64_t& word = host[(std::size_t)y * wordsPerRow + (x >> 6)];
+        word = alive ? word | bit : word & ~bit;
+        hostChanged();
+    }
+
+    /* set row y from bit-packed words, cell x in bit x%64 of word x/64 */
+    void setRow(int y, const uint64_t* words)
+    {
+        readBack();
+        uint64_t* row = &host[(std::size_t)y * wordsPerRow];
+        std::copy(words, words + wordsPerRow, row);
+        if(gridWidth % 64 != 0)
+        {
+            row[wordsPerRow-1] &= (uint64_t(1) << (gridWidth % 64)) - 1;
+        }
+        hostChanged();
+    }
+
+    /* step by another rule, false for rules with more than two states */
+    bool setRule(const LifeRule& newRule)
+    {
+        if(newRule.states > 2)
+        {
+            return false;
+        }
+        rule = newRule;
+        return true;
+    }
+
+    /* the rule the grid is stepped by */
+    LifeRule lifeRule() const { return rule; }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* set what lies beyond the edges of the grid */
+    void setBoundaryPolicy(BoundaryPolicy policy)
+    {
+        boundary = policy;
+    }
+
+    /* a view of the grid, copied back from the device if it changed there */
+    BitGridView fullGrid() const
+    {
+        readBack();
+        return BitGridView(host.data(), gridWidth, gridHeight, wordsPerRow);
+    }
+
+    /* main update loop, one dispatch; returns before the GPU has finished */
+    void update()
+    {
+        upload();
+        gl.UseProgram(stepProgram);
+        gl.Uniform2i(gl.GetUniformLocation(stepProgram, "size"), gridWidth, gridHeight);
+        gl.Uniform1i(gl.GetUniformLocation(stepProgram, "rowWords"), 2*wordsPerRow);
+        gl.Uniform1i(gl.GetUniformLocation(stepProgram, "boundary"), boundary);
+        gl.Uniform1ui(gl.GetUniformLocation(stepProgram, "birth"), rule.birth);
+        gl.Uniform1ui(gl.GetUniformLocation(stepProgram, "survival"), rule.survival);
+        gl.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[current]);
+        gl.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1 - current]);
+        gl.DispatchCompute((2*wordsPerRow + GPU_WORKGROUP_SIZE - 1) / GPU_WORKGROUP_SIZE, gridHeight, 1);
+        gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        current = 1 - current;
+        deviceNewer = true;
+        generations++;
+    }
+
+    /* wait until the GPU has finished the steps issued so far */
+    void finish()
+    {
+        gl.Finish();
+    }
+
+    /* draw the grid over a viewport of the current framebuffer, colours as ARGB8888 */
+    void draw(int width, int height, uint32_t alive, uint32_t dead)
+    {
+        upload();
+        gl.Viewport(0, 0, width, height);
+        gl.UseProgram(drawProgram);
+        gl.Uniform2i(gl.GetUniformLocation(drawProgram, "size"), gridWidth, gridHeight);
+        gl.Uniform1i(gl.GetUniformLocation(drawProgram, "rowWords"), 2*wordsPerRow);
+        gl.Uniform2f(gl.GetUniformLocation(drawProgram, "viewport"), (float)width, (float)height);
+        setColour(gl.GetUniformLocation(drawProgram, "alive"), alive);
+        setColour(gl.GetUniformLocation(drawProgram, "dead"), dead);
+        gl.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[current]);
+        gl.BindVertexArray(vertexArray);
+        gl.DrawArrays(GL_TRIANGLES, 0, 3);
+        gl.BindVertexArray(0);
+    }
+
+    /* the renderer of the context */
+    std::string deviceName() const
+    {
+        const GLubyte* name = gl.GetString(GL_RENDERER);
+        return name != nullptr ? reinterpret_cast<const char*>(name) : "";
+    }
+
+private:
+
+    /* the host copy changed, the device copy is stale */
+    void hostChanged()
+    {
+        hostNewer = true;
+        deviceNewer = false;
+    }
+
+    /* copy the host grid to the current buffer if it changed */
+    void upload()
+    {
+        if(!hostNewer || stepProgram == 0)
+        {
+            return;
+        }
+        gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[current]);
+        gl.BufferSubData(GL_SHADER_STORAGE_BUFFER, 0, host.size() * sizeof(uint64_t), host.data());
+        gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        hostNewer = false;
+    }
+
+    /* copy the current buffer to the host grid if it changed; the rows are
+       whole 64-bit words of little-endian uints */
+    void readBack() const
+    {
+        if(!deviceNewer)
+        {
+            return;
+        }
+        gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[current]);
+        gl.GetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, host.size() * sizeof(uint64_t), host.data());
+        gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        deviceNewer = false;
+    }
+
+    /* a shader of a type, 0 with the compiler log as error if it fails */
+    GLuint compile(GLenum type, const char* text, std::string& error)
+    {
+        GLuint shader = gl.CreateShader(type);
+        gl.ShaderSource(shader, 1, &text, nullptr);
+        gl.CompileShader(shader);
+        GLint compiled = 0;
+        gl.GetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if(!compiled)
+        {
+            char log[1024] = "";
+            gl.GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            error = std::string("cannot compile shader: ") + log;
+            gl.DeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    /* a program of compiled shaders, 0 if one of them failed or it does not link */
+    GLuint link(std::initializer_list<GLuint> shaders, std::string& error)
+    {
+        GLuint program = 0;
+        if(std::find(shaders.begin(), shaders.end(), 0u) == shaders.end())
+        {
+            program = gl.CreateProgram();
+            for(GLuint shader: shaders)
+            {
+                gl.AttachShader(program, shader);
+            }
+            gl.LinkProgram(program);
+            GLint linked = 0;
+            gl.GetProgramiv(program, GL_LINK_STATUS, &linked);
+            if(!linked)
+            {
+                char log[1024] = "";
+                gl.GetProgramInfoLog(program, sizeof(log), nullptr, log);
+                error = std::string("cannot link shaders: ") + log;
+                gl.DeleteProgram(program);
+                program = 0;
+            }
+        }
+        for(GLuint shader: shaders)
+        {
+            if(shader != 0)
+            {
+                gl.DeleteShader(shader);
+            }
+        }
+        return program;
+    }
+
+    /* set a vec4 uniform to an ARGB8888 colour */
+    void setColour(GLint location, uint32_t argb)
+    {
+        gl.Uniform4f(location, ((argb >> 16) & 0xff) / 255.0f, ((argb >> 8) & 0xff) / 255.0f,
+                     (argb & 0xff) / 255.0f, (argb >> 24) / 255.0f);
+    }
+
+    struct Functions
+    {
+#define GPU_MEMBER(type, name) type name = nullptr;
+        GPU_FUNCTIONS(GPU_MEMBER)
+#undef GPU_MEMBER
+    };
+
+    Functions gl;
+    int gridWidth, gridHeight;
+    int wordsPerRow;                    // 64-bit words, two uints each on the device
+    LifeRule rule;
+    BoundaryPolicy boundary;
+    mutable std::vector<uint64_t> host; // copy of the grid on the host
+    bool hostNewer;                     // host copy not uploaded yet
+    mutable bool deviceNewer;           // device stepped past the host copy
+    uint64_t generations;
+    GLuint stepProgram, drawProgram;
+    GLuint vertexArray;                 // empty, core profiles draw with one bound
+    GLuint buffers[2];                  // the two generations
+    int current;                        // buffer holding the current generation
+};
+
+#endif
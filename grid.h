@@ -0,0 +1,333 @@
+
+// Author: 	Stephan Meesters
+//
+// Contiguous grid storage for the Game of Life processes
+//
+// A grid is stored as one aligned, row-major block per generation. Every row
+// starts on an alignment boundary and is surrounded by padding cells, and
+// the block holds padding rows above and below the grid, so kernels can read
+// one cell past any edge without leaving the allocation. Before a generation
+// is computed the padding is refreshed as a halo of ghost cells according to
+// the boundary policy, and the kernels never have to check bounds.
+//
+// Large grids are mapped straight from the kernel instead of allocated.
+// Their pages read as zero and stay untouched until a thread writes them,
+// which places every page on the NUMA node of the thread that first does,
+// so a process can fill its grid in the bands it steps it in. They can be
+// backed by transparent huge pages as well, set by gridHugePages() for the
+// grids allocated after it.
+//
+
+#ifndef CONWAY_GRID_H
+#define CONWAY_GRID_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define CONWAY_GRID_MMAP
+#endif
+
+#define GRID_ALIGNMENT 64   // bytes, alignment of every grid row
+#define GRID_PADDING 1      // padding rows/columns on each side of the grid
+#define GRID_MAP_THRESHOLD (std::size_t(1) << 21)   // bytes from which a grid is mapped
+#define GRID_HUGE_PAGE (std::size_t(1) << 21)       // bytes of a transparent huge page
+
+/* ask for transparent huge pages for the mapped grids allocated from now on */
+inline bool& gridHugePages()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+/* what lies beyond the edges of a grid */
+enum BoundaryPolicy
+{
+    BOUNDARY_TORUS,     // wrap around to the opposite edge
+    BOUNDARY_DEAD,      // dead cells
+    BOUNDARY_MIRROR     // reflection of the edge, cell -1 is a copy of cell 0
+};
+
+/* cell inside [0, n) that is copied to halo cell i, -1 for a dead cell */
+inline int haloSource(int i, int n, BoundaryPolicy policy)
+{
+    switch(policy)
+    {
+        case BOUNDARY_TORUS:
+            return ((i % n) + n) % n;
+        case BOUNDARY_MIRROR:
+            return i < 0 ? std::min(-i-1, n-1) : std::max(2*n-1-i, 0);
+        case BOUNDARY_DEAD:
+            break;
+    }
+    return -1;
+}
+
+/* read-only view of a row-major grid */
+template <class T>
+class GridView
+{
+public:
+
+    GridView():data(nullptr), gridWidth(0), gridHeight(0), rowStride(0){}
+    GridView(const T* data, int width, int height, std::ptrdiff_t stride):
+        data(data), gridWidth(width), gridHeight(height), rowStride(stride){}
+
+    /* read a cell, no bounds checking */
+    const T& operator()(int x, int y) const
+    {
+        return data[y*rowStride + x];
+    }
+
+    /* pointer to the first cell of a row */
+    const T* row(int y) const
+    {
+        return data + y*rowStride;
+    }
+
+    int width() const { return gridWidth; }
+    int height() const { return gridHeight; }
+    std::ptrdiff_t stride() const { return rowStride; }
+
+private:
+
+    const T* data;
+    int gridWidth, gridHeight;
+    std::ptrdiff_t rowStride;   // distance between rows in cells
+};
+
+/* read-only view of a bit-packed grid, 64 cells per word, cell x in bit x%64 */
+class BitGridView
+{
+public:
+
+    BitGridView():data(nullptr), gridWidth(0), gridHeight(0), rowStride(0){}
+    BitGridView(const uint64_t* data, int width, int height, std::ptrdiff_t stride):
+        data(data), gridWidth(width), gridHeight(height), rowStride(stride){}
+
+    /* read a cell as 0 or 1, no bounds checking */
+    char operator()(int x, int y) const
+    {
+        return (data[y*rowStride + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    /* pointer to the first word of a row */
+    const uint64_t* row(int y) const
+    {
+        return data + y*rowStride;
+    }
+
+    int width() const { return gridWidth; }
+    int height() const { return gridHeight; }
+    std::ptrdiff_t stride() const { return rowStride; }
+
+private:
+
+    const uint64_t* data;
+    int gridWidth, gridHeight;
+    std::ptrdiff_t rowStride;   // distance between rows in words
+};
+
+/* single block of aligned, padded grid storage */
+template <class T>
+class GridBuffer
+{
+public:
+
+    static_assert(std::is_trivially_copyable<T>::value, "grid cells must be trivially copyable");
+    static_assert(GRID_ALIGNMENT % sizeof(T) == 0, "cell size must divide the grid alignment");
+
+    /* cells per alignment unit; also the left padding of every row */
+    static const int cellsPerAlignment = GRID_ALIGNMENT / sizeof(T);
+
+    GridBuffer():block(nullptr), mapped(0), origin(nullptr), gridWidth(0), gridHeight(0), rowStride(0){}
+
+    /* constructor, all cells including padding are set to zero */
+    GridBuffer(int width, int height):GridBuffer()
+    {
+        allocate(width, height);
+    }
+
+    ~GridBuffer()
+    {
+#ifdef CONWAY_GRID_MMAP
+        if(mapped != 0)
+        {
+            munmap(block, mapped);
+            return;
+        }
+#endif
+        std::free(block);
+    }
+
+    GridBuffer(GridBuffer&& other):GridBuffer()
+    {
+        swap(other);
+    }
+    GridBuffer& operator=(GridBuffer&& other)
+    {
+        swap(other);
+        return *this;
+    }
+    GridBuffer(GridBuffer const&) = delete;
+    GridBuffer& operator=(GridBuffer const&) = delete;
+
+    /* exchange storage with another buffer, no cells are copied */
+    void swap(GridBuffer& other)
+    {
+        std::swap(block, other.block);
+        std::swap(mapped, other.mapped);
+        std::swap(origin, other.origin);
+        std::swap(gridWidth, other.gridWidth);
+        std::swap(gridHeight, other.gridHeight);
+        std::swap(rowStride, other.rowStride);
+    }
+
+    /* set every cell, including the padding */
+    void fill(T val)
+    {
+        fillRows(-GRID_PADDING, gridHeight + GRID_PADDING, val);
+    }
+
+    /* set every cell of rows [begin, end) including their padding,
+       -GRID_PADDING <= begin <= end <= height+GRID_PADDING */
+    void fillRows(int begin, int end, T val)
+    {
+        std::fill(row(begin) - cellsPerAlignment, row(end) - cellsPerAlignment, val);
+    }
+
+    /* fill the padding around the grid as halo cells, following the boundary policy */
+    void refreshHalo(BoundaryPolicy policy)
+    {
+        // halo columns of every row
+        for(int y = 0; y<gridHeight; y++)
+        {
+            T* r = row(y);
+            for(int k = 1; k<=GRID_PADDING; k++)
+            {
+                int left = haloSource(-k, gridWidth, policy);
+                int right = haloSource(gridWidth-1+k, gridWidth, policy);
+                r[-k] = left < 0 ? T(0) : r[left];
+                r[gridWidth-1+k] = right < 0 ? T(0) : r[right];
+            }
+        }
+
+        // halo rows, copied including their halo columns to fill the corners
+        for(int k = 1; k<=GRID_PADDING; k++)
+        {
+            copyHaloRow(-k, haloSource(-k, gridHeight, policy));
+            copyHaloRow(gridHeight-1+k, haloSource(gridHeight-1+k, gridHeight, policy));
+        }
+    }
+
+    /* pointer to the first cell of a row, -GRID_PADDING <= y < height+GRID_PADDING */
+    T* row(int y)
+    {
+        return origin + y*rowStride;
+    }
+    const T* row(int y) const
+    {
+        return origin + y*rowStride;
+    }
+
+    /* access a cell, no bounds checking */
+    T& operator()(int x, int y)
+    {
+        return origin[y*rowStride + x];
+    }
+    const T& operator()(int x, int y) const
+    {
+        return origin[y*rowStride + x];
+    }
+
+    /* read-only view of the grid cells */
+    GridView<T> view() const
+    {
+        return GridView<T>(origin, gridWidth, gridHeight, rowStride);
+    }
+
+    int width() const { return gridWidth; }
+    int height() const { return gridHeight; }
+    std::ptrdiff_t stride() const { return rowStride; }
+
+private:
+
+    /* copy row src to halo row y, including the halo columns; src < 0 clears it */
+    void copyHaloRow(int y, int src)
+    {
+        T* dst = row(y) - GRID_PADDING;
+        if(src < 0)
+        {
+            std::fill(dst, dst + gridWidth + 2*GRID_PADDING, T(0));
+        }
+        else
+        {
+            std::copy(row(src) - GRID_PADDING, row(src) + gridWidth + GRID_PADDING, dst);
+        }
+    }
+
+    /* allocate the block and point the origin at cell (0,0) */
+    void allocate(int width, int height)
+    {
+        gridWidth = width;
+        gridHeight = height;
+
+        // every row is [left padding | width cells | right padding], rounded
+        // up to the alignment so that cell (0,y) is aligned for every y
+        std::ptrdiff_t cells = cellsPerAlignment + width + GRID_PADDING;
+        rowStride = (cells + cellsPerAlignment - 1) / cellsPerAlignment * cellsPerAlignment;
+
+        std::size_t bytes = (height + 2*GRID_PADDING) * rowStride * sizeof(T);
+#ifdef CONWAY_GRID_MMAP
+        if(bytes >= GRID_MAP_THRESHOLD)
+        {
+            // mapped pages are zero already, and left untouched
+            std::size_t alignment = gridHugePages() ? GRID_HUGE_PAGE : GRID_ALIGNMENT;
+            mapped = bytes + alignment;
+            block = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(block == MAP_FAILED)
+            {
+                block = nullptr;
+                mapped = 0;
+                throw std::bad_alloc();
+            }
+#ifdef MADV_HUGEPAGE
+            if(gridHugePages())
+            {
+                madvise(block, mapped, MADV_HUGEPAGE);
+            }
+#endif
+            setOrigin(alignment);
+            return;
+        }
+#endif
+        block = std::malloc(bytes + GRID_ALIGNMENT);
+        if(block == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        setOrigin(GRID_ALIGNMENT);
+        fill(0);
+    }
+
+    /* point the origin at cell (0,0), the block rounded up to an alignment */
+    void setOrigin(std::size_t alignment)
+    {
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block);
+        base = (base + alignment - 1) / alignment * alignment;
+        origin = reinterpret_cast<T*>(base) + GRID_PADDING*rowStride + cellsPerAlignment;
+    }
+
+    void* block;                // allocation as returned by malloc or mmap
+    std::size_t mapped;         // bytes of a mapped block, 0 when it was malloced
+    T* origin;                  // cell (0,0)
+    int gridWidth, gridHeight;
+    std::ptrdiff_t rowStride;   // distance between rows in cells
+};
+
+#endif
@@ -0,0 +1,691 @@
+
+// Author: 	Stephan Meesters
+//
+// HashLife Game of Life process
+//
+// The universe is a quadtree whose nodes are hash-consed: every distinct
+// square of cells exists once, shared by all places it occurs. A node of
+// level k is 2^k cells wide and memoises its result, the centre half of the
+// square advanced 2^(k-2) generations (or 2^stepLog, when that is smaller).
+// Periodic and sparse patterns repeat the same nodes over and over, so a
+// single step can jump an astronomical number of generations.
+//
+// The rule is only applied to the 4x4 squares at the bottom of the tree,
+// whose results are memoised, so it is looked up in a DynamicRule table;
+// changing it forgets every result. Rules with B0 are refused.
+//
+// Unlike the dense processes the universe is unbounded. The width x height
+// window at the origin is what is initialized and shown. Cell coordinates
+// are 64-bit, so the root grows to at most HASHLIFE_MAX_LEVEL: cells set
+// beyond it are ignored, a step is at most 2^(HASHLIFE_MAX_LEVEL-3)
+// generations and longer ones are taken in several, and cells that travel
+// past the edge of the largest root are lost.
+//
+
+#ifndef CONWAY_HASHLIFE_H
+#define CONWAY_HASHLIFE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <random>
+
+#include "grid.h"
+#include "rule.h"
+#include "random.h"
+
+#define HASHLIFE_MAX_NODES_DEFAULT (1 << 22)   // node count that triggers garbage collection
+#define HASHLIFE_BLOCK_NODES 65536              // nodes allocated at once
+#define HASHLIFE_MAX_LEVEL 62                   // deepest root, its corners at +-2^61 fit an int64_t
+#define HASHLIFE_MAX_STEP_LOG (HASHLIFE_MAX_LEVEL - 3)  // longest single step, as a power of two
+
+/* Conway's Game of Life process on a hash-consed quadtree */
+class HashLife
+{
+public:
+
+    /* quadtree node, level 0 nodes are single cells */
+    struct Node
+    {
+        Node* nw;
+        Node* ne;
+        Node* sw;
+        Node* se;
+        Node* result;       // memoised future of the centre, nullptr if not known
+        Node* next;         // hash chain or free list
+        uint64_t population;
+        int level;
+        bool marked;        // reachable, during garbage collection
+    };
+
+    /* constructor */
+    HashLife(int width, int height):gridWidth(width), gridHeight(height), display(width, height),
+        buckets(1 << 16, nullptr), nodes(0), maxNodes(HASHLIFE_MAX_NODES_DEFAULT),
+        freeList(nullptr), root(nullptr), stepLog(0), resultLog(0), generations(0)
+    {
+        for(int i = 0; i<2; i++)
+        {
+            leaves[i] = Node();
+            leaves[i].population = i;
+        }
+        clear();
+    }
+    ~HashLife(){};
+
+    HashLife(HashLife const&) = delete;
+    HashLife& operator=(HashLife const&) = delete;
+
+    /* remove all cells, go back to generation 0 */
+    void clear()
+    {
+        root = emptyNode(rootLevelFor(gridWidth, gridHeight));
+        generations = 0;
+    }
+
+    /* set a cell anywhere on the plane within 2^(HASHLIFE_MAX_LEVEL-1) of the
+       origin, false for one beyond, which is ignored */
+    bool setCell(int64_t x, int64_t y, bool alive)
+    {
+        const int64_t limit = int64_t(1) << (HASHLIFE_MAX_LEVEL-1);
+        if(x < -limit || x >= limit || y < -limit || y >= limit)
+        {
+            return false;
+        }
+
+        // grow until the root, which covers [-half, half) both ways, holds the cell
+        while(true)
+        {
+            int64_t half = int64_t(1) << (root->level-1);
+            if(x >= -half && x < half && y >= -half && y < half)
+            {
+                root = withCell(root, x + half, y + half, alive);
+                break;
+            }
+            root = expand(root);
+        }
+        collectIfNeeded();
+        return true;
+    }
+
+    /* building blocks of a universe read as a quadtree, such as a macrocell file */
+    Node* makeCell(bool alive) { return &leaves[alive ? 1 : 0]; }
+    Node* makeNode(Node* nw, Node* ne, Node* sw, Node* se) { return join(nw, ne, sw, se); }
+    Node* makeEmpty(int level) { return emptyNode(level); }
+
+    /* make a node the universe, centred on the origin, at a generation; a
+       node deeper than HASHLIFE_MAX_LEVEL is cut down to its centre while
+       that holds all of its cells, false if it then still is too deep */
+    bool setRoot(Node* node, uint64_t generation = 0)
+    {
+        while(node->level > HASHLIFE_MAX_LEVEL)
+        {
+            Node* inner = centre(node);
+            if(inner->population != node->population)
+            {
+                return false;
+            }
+            node = inner;
+        }
+        root = node;
+        while(root->level < rootLevelFor(gridWidth, gridHeight))
+        {
+            root = expand(root);
+        }
+        generations = generation;
+        collectIfNeeded();
+        return true;
+    }
+
+    /* the whole universe, centred on the origin */
+    const Node* rootNode() const { return root; }
+
+    /* initialize the window with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        display.fill(0);
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                display(i,j) = gen() == 0;
+            }
+        }
+        int level = rootLevelFor(gridWidth, gridHeight);
+        int64_t half = int64_t(1) << (level-1);
+        root = build(level, -half, -half);
+        generations = 0;
+        collectIfNeeded();
+    }
+
+    /* fill the window at the origin with random cells of a density in
+       RANDOM_DENSITY_BITS fractional bits, the board of the seed (see random.h) */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        for(int j = 0; j<gridHeight; j++)
+        {
+            randomRow(key, j, gridWidth, density, display.row(j));
+        }
+        int level = rootLevelFor(gridWidth, gridHeight);
+        int64_t half = int64_t(1) << (level-1);
+        root = build(level, -half, -half);
+        generations = 0;
+        collectIfNeeded();
+    }
+
+    /* step by another rule, false for rules with B0 or more than two states */
+    bool setRule(const LifeRule& newRule)
+    {
+        if((newRule.birth & 1) || newRule.states > 2)
+        {
+            return false;
+        }
+        if(newRule != rule.lifeRule())
+        {
+            rule = DynamicRule(newRule);
+            forgetResults();
+        }
+        return true;
+    }
+
+    /* the rule the universe is stepped by */
+    LifeRule lifeRule() const { return rule.lifeRule(); }
+
+    /* generations advanced by update(), as a power of two */
+    void setStepLog(int log2Generations)
+    {
+        stepLog = std::max(0, std::min(log2Generations, HASHLIFE_MAX_STEP_LOG));
+    }
+
+    /* main update loop, advances 2^stepLog generations */
+    void update()
+    {
+        step(stepLog);
+    }
+
+    /* advance 2^log2Generations generations, at once up to 2^HASHLIFE_MAX_STEP_LOG */
+    void step(int log2Generations)
+    {
+        if(log2Generations > HASHLIFE_MAX_STEP_LOG)
+        {
+            for(uint64_t i = 0; i < (uint64_t(1) << (log2Generations - HASHLIFE_MAX_STEP_LOG)); i++)
+            {
+                step(HASHLIFE_MAX_STEP_LOG);
+            }
+            return;
+        }
+        setResultLog(log2Generations);
+
+        // grow the universe until the pattern cannot leave the returned
+        // centre, or the root is as large as it gets
+        while(root->level < log2Generations + 3 || (!isPadded(root) && root->level < HASHLIFE_MAX_LEVEL))
+        {
+            root = expand(root);
+        }
+        root = successor(root);
+        generations += uint64_t(1) << log2Generations;
+        collectIfNeeded();
+    }
+
+    /* advance any number of generations, one power of two at a time */
+    void advance(uint64_t count)
+    {
+        for(int k = 0; k<64; k++)
+        {
+            if(count & (uint64_t(1) << k))
+            {
+                step(k);
+            }
+        }
+    }
+
+    /* return a view of the window at the origin */
+    GridView<char> fullGrid()
+    {
+        display.fill(0);
+        int64_t half = int64_t(1) << (root->level-1);
+        paint(root, -half, -half);
+        return display.view();
+    }
+
+    /* set the node count at which unreachable nodes are collected */
+    void setMaxNodes(std::size_t count)
+    {
+        maxNodes = count;
+    }
+
+    /* free all nodes that are not part of the current universe */
+    void collectGarbage()
+    {
+        mark(root);
+        for(auto node: emptyNodes)
+        {
+            mark(node);
+        }
+
+        // free the unmarked nodes, forget results that were freed
+        for(auto& bucket: buckets)
+        {
+            Node** link = &bucket;
+            while(*link != nullptr)
+            {
+                Node* node = *link;
+                if(!node->marked)
+                {
+                    *link = node->next;
+                    release(node);
+                }
+                else
+                {
+                    link = &node->next;
+                }
+            }
+        }
+        for(auto& bucket: buckets)
+        {
+            for(Node* node = bucket; node != nullptr; node = node->next)
+            {
+                if(node->result != nullptr && !node->result->marked)
+                {
+                    node->result = nullptr;
+                }
+            }
+        }
+        for(auto& bucket: buckets)
+        {
+            for(Node* node = bucket; node != nullptr; node = node->next)
+            {
+                node->marked = false;
+            }
+        }
+    }
+
+    uint64_t generation() const { return generations; }
+    uint64_t population() const { return root->population; }
+    std::size_t nodeCount() const { return nodes; }
+
+private:
+
+    /* smallest root level so that the window fits in the south-east quadrant */
+    static int rootLevelFor(int width, int height)
+    {
+        int level = 3;
+        while((int64_t(1) << (level-1)) < std::max(width, height))
+        {
+            level++;
+        }
+        return level;
+    }
+
+    /* get a node from the free list, allocate a block when it is empty */
+    Node* allocate()
+    {
+        if(freeList == nullptr)
+        {
+            blocks.push_back(std::unique_ptr<Node[]>(new Node[HASHLIFE_BLOCK_NODES]));
+            Node* block = blocks.back().get();
+            for(int i = 0; i<HASHLIFE_BLOCK_NODES; i++)
+            {
+                block[i].next = freeList;
+                freeList = &block[i];
+            }
+        }
+        Node* node = freeList;
+        freeList = node->next;
+        nodes++;
+        return node;
+    }
+
+    /* return a node to the free list */
+    void release(Node* node)
+    {
+        node->next = freeList;
+        freeList = node;
+        nodes--;
+    }
+
+    /* hash of the four children of a node */
+    static std::size_t hashChildren(const Node* nw, const Node* ne, const Node* sw, const Node* se)
+    {
+        uint64_t h = reinterpret_cast<uintptr_t>(nw);
+        h = h * 0x9E3779B97F4A7C15ULL + reinterpret_cast<uintptr_t>(ne);
+        h = h * 0x9E3779B97F4A7C15ULL + reinterpret_cast<uintptr_t>(sw);
+        h = h * 0x9E3779B97F4A7C15ULL + reinterpret_cast<uintptr_t>(se);
+        return h ^ (h >> 29);
+    }
+
+    /* the canonical node with these four children */
+    Node* join(Node* nw, Node* ne, Node* sw, Node* se)
+    {
+        std::size_t index = hashChildren(nw, ne, sw, se) & (buckets.size() - 1);
+        for(Node* node = buckets[index]; node != nullptr; node = node->next)
+        {
+            if(node->nw == nw && node->ne == ne && node->sw == sw && node->se == se)
+            {
+                return node;
+            }
+        }
+
+        Node* node = allocate();
+        node->nw = nw;
+        node->ne = ne;
+        node->sw = sw;
+        node->se = se;
+        node->result = nullptr;
+        node->population = nw->population + ne->population + sw->population + se->population;
+        node->level = nw->level + 1;
+        node->marked = false;
+        node->next = buckets[index];
+        buckets[index] = node;
+
+        if(nodes > buckets.size())
+        {
+            rehash(buckets.size() * 2);
+        }
+        return node;
+    }
+
+    /* move all nodes to a table of a new size */
+    void rehash(std::size_t size)
+    {
+        std::vector<Node*> table(size, nullptr);
+        for(auto bucket: buckets)
+        {
+            while(bucket != nullptr)
+            {
+                Node* next = bucket->next;
+                std::size_t index = hashChildren(bucket->nw, bucket->ne, bucket->sw, bucket->se) & (size - 1);
+                bucket->next = table[index];
+                table[index] = bucket;
+                bucket = next;
+            }
+        }
+        buckets.swap(table);
+    }
+
+    /* the empty node of a level */
+    Node* emptyNode(int level)
+    {
+        while((int)emptyNodes.size() <= level)
+        {
+            if(emptyNodes.empty())
+            {
+                emptyNodes.push_back(&leaves[0]);
+            }
+            else
+            {
+                Node* e = emptyNodes.back();
+                emptyNodes.push_back(join(e, e, e, e));
+            }
+        }
+        return emptyNodes[level];
+    }
+
+    /* same universe, one level larger, the old root in its centre */
+    Node* expand(Node* node)
+    {
+        Node* e = emptyNode(node->level - 1);
+        return join(join(e, e, e, node->nw), join(e, e, node->ne, e),
+                    join(e, node->sw, e, e), join(node->se, e, e, e));
+    }
+
+    /* are all cells in the centre square of a quarter of the node's width, at
+       most 2^(level-3) generations later they are still inside its result */
+    static bool isPadded(const Node* node)
+    {
+        return node->nw->se->se->population + node->ne->sw->sw->population +
+               node->sw->ne->ne->population + node->se->nw->nw->population == node->population;
+    }
+
+    /* centre half of a node */
+    Node* centre(Node* n)
+    {
+        return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+    }
+
+    /* square of the same level straddling two nodes next to each other */
+    Node* centreHorizontal(Node* w, Node* e)
+    {
+        return join(w->ne, e->nw, w->se, e->sw);
+    }
+
+    /* square of the same level straddling two nodes above each other */
+    Node* centreVertical(Node* n, Node* s)
+    {
+        return join(n->sw, n->se, s->nw, s->ne);
+    }
+
+    /* results are memoised for one step size, forget them when it changes */
+    void setResultLog(int log2Generations)
+    {
+        if(log2Generations == resultLog)
+        {
+            return;
+        }
+        resultLog = log2Generations;
+        forgetResults();
+    }
+
+    /* drop every memoised result */
+    void forgetResults()
+    {
+        for(auto bucket: buckets)
+        {
+            for(Node* node = bucket; node != nullptr; node = node->next)
+            {
+                node->result = nullptr;
+            }
+        }
+    }
+
+    /* next state of the centre 2x2 of a level 2 node */
+    Node* baseResult(Node* n)
+    {
+        // gather the 4x4 cells, row by row
+        int cells[4][4];
+        Node* quads[2][2] = {{n->nw, n->ne}, {n->sw, n->se}};
+        for(int qy = 0; qy<2; qy++)
+        {
+            for(int qx = 0; qx<2; qx++)
+            {
+                Node* q = quads[qy][qx];
+                cells[2*qy][2*qx] = q->nw->population;
+                cells[2*qy][2*qx+1] = q->ne->population;
+                cells[2*qy+1][2*qx] = q->sw->population;
+                cells[2*qy+1][2*qx+1] = q->se->population;
+            }
+        }
+
+        Node* next[2][2];
+        for(int y = 1; y<3; y++)
+        {
+            for(int x = 1; x<3; x++)
+            {
+                int count = 0;
+                for(int dy = -1; dy<=1; dy++)
+                {
+                    for(int dx = -1; dx<=1; dx++)
+                    {
+                        count += (dx != 0 || dy != 0) ? cells[y+dy][x+dx] : 0;
+                    }
+                }
+                next[y-1][x-1] = &leaves[(int)rule.next(cells[y][x], count)];
+            }
+        }
+        return join(next[0][0], next[0][1], next[1][0], next[1][1]);
+    }
+
+    /* centre half of a node advanced 2^min(level-2, resultLog) generations */
+    Node* successor(Node* n)
+    {
+        if(n->result != nullptr)
+        {
+            return n->result;
+        }
+        Node* result;
+        if(n->population == 0)
+        {
+            result = n->nw;
+        }
+        else if(n->level == 2)
+        {
+            result = baseResult(n);
+        }
+        else
+        {
+            // nine overlapping sub-squares of half the size
+            Node* n00 = n->nw;
+            Node* n01 = centreHorizontal(n->nw, n->ne);
+            Node* n02 = n->ne;
+            Node* n10 = centreVertical(n->nw, n->sw);
+            Node* n11 = centre(n);
+            Node* n12 = centreVertical(n->ne, n->se);
+            Node* n20 = n->sw;
+            Node* n21 = centreHorizontal(n->sw, n->se);
+            Node* n22 = n->se;
+
+            // first half of the generations, skipped when stepping slower
+            // than this level allows
+            bool full = resultLog >= n->level - 2;
+            Node* r00 = full ? successor(n00) : centre(n00);
+            Node* r01 = full ? successor(n01) : centre(n01);
+            Node* r02 = full ? successor(n02) : centre(n02);
+            Node* r10 = full ? successor(n10) : centre(n10);
+            Node* r11 = full ? successor(n11) : centre(n11);
+            Node* r12 = full ? successor(n12) : centre(n12);
+            Node* r20 = full ? successor(n20) : centre(n20);
+            Node* r21 = full ? successor(n21) : centre(n21);
+            Node* r22 = full ? successor(n22) : centre(n22);
+
+            // second half
+            result = join(successor(join(r00, r01, r10, r11)), successor(join(r01, r02, r11, r12)),
+                          successor(join(r10, r11, r20, r21)), successor(join(r11, r12, r21, r22)));
+        }
+        n->result = result;
+        return result;
+    }
+
+    /* copy of a node with cell (x, y) from its north-west corner set */
+    Node* withCell(Node* node, int64_t x, int64_t y, bool alive)
+    {
+        if(node->level == 0)
+        {
+            return makeCell(alive);
+        }
+        int64_t half = int64_t(1) << (node->level-1);
+        Node* nw = node->nw;
+        Node* ne = node->ne;
+        Node* sw = node->sw;
+        Node* se = node->se;
+        if(y < half)
+        {
+            if(x < half)
+            {
+                nw = withCell(nw, x, y, alive);
+            }
+            else
+            {
+                ne = withCell(ne, x - half, y, alive);
+            }
+        }
+        else if(x < half)
+        {
+            sw = withCell(sw, x, y - half, alive);
+        }
+        else
+        {
+            se = withCell(se, x - half, y - half, alive);
+        }
+        return join(nw, ne, sw, se);
+    }
+
+    /* node of a level with its north-west corner at (x0, y0), from the display buffer */
+    Node* build(int level, int64_t x0, int64_t y0)
+    {
+        int64_t size = int64_t(1) << level;
+        if(x0 >= gridWidth || y0 >= gridHeight || x0 + size <= 0 || y0 + size <= 0)
+        {
+            return emptyNode(level);
+        }
+        if(level == 0)
+        {
+            return &leaves[display(x0, y0) ? 1 : 0];
+        }
+        int64_t half = size / 2;
+        return join(build(level-1, x0, y0), build(level-1, x0+half, y0),
+                    build(level-1, x0, y0+half), build(level-1, x0+half, y0+half));
+    }
+
+    /* write the live cells of a node inside the window to the display buffer */
+    void paint(const Node* node, int64_t x0, int64_t y0)
+    {
+        int64_t size = int64_t(1) << node->level;
+        if(node->population == 0 || x0 >= gridWidth || y0 >= gridHeight || x0 + size <= 0 || y0 + size <= 0)
+        {
+            return;
+        }
+        if(node->level == 0)
+        {
+            display(x0, y0) = 1;
+            return;
+        }
+        int64_t half = size / 2;
+        paint(node->nw, x0, y0);
+        paint(node->ne, x0+half, y0);
+        paint(node->sw, x0, y0+half);
+        paint(node->se, x0+half, y0+half);
+    }
+
+    /* mark a node and everything below it as reachable */
+    static void mark(Node* node)
+    {
+        if(node == nullptr || node->marked || node->level == 0)
+        {
+            return;
+        }
+        node->marked = true;
+        mark(node->nw);
+        mark(node->ne);
+        mark(node->sw);
+        mark(node->se);
+    }
+
+    /* garbage collection policy: collect when the node count passes the limit,
+       raise the limit when more than half of the nodes are still in use */
+    void collectIfNeeded()
+    {
+        if(nodes < maxNodes)
+        {
+            return;
+        }
+        collectGarbage();
+        if(nodes > maxNodes / 2)
+        {
+            maxNodes *= 2;
+        }
+    }
+
+    int gridWidth, gridHeight;
+    GridBuffer<char> display;       // window at the origin
+
+    std::vector<Node*> buckets;     // hash table, size is a power of two
+    std::vector<std::unique_ptr<Node[]>> blocks;
+    std::size_t nodes;              // nodes in the hash table
+    std::size_t maxNodes;
+    Node* freeList;
+
+    Node leaves[2];                 // dead and live cell, not in the hash table
+    std::vector<Node*> emptyNodes;  // empty node per level
+    Node* root;
+
+    int stepLog;                    // generations per update(), as a power of two
+    int resultLog;                  // step size the memoised results are for
+    uint64_t generations;
+    DynamicRule rule;
+};
+
+#endif
@@ -0,0 +1,459 @@
+
+// Author: 	Stephan Meesters
+//
+// Row kernels for byte-per-cell Game of Life grids
+//
+// A row kernel computes the next state of cells [begin, end) of one row from
+// the rows above, at and below it. It reads one cell left of begin and one
+// cell right of end-1, the caller makes sure those reads are valid. Cells
+// hold 0 or 1. The SIMD kernels sum the eight neighbours with vector adds and
+// apply the rule with compares and masks, the best one the processor supports
+// is picked at runtime.
+//
+// Kernels are instantiated per rule. For a compile-time rule the compares
+// against counts the rule does not use drop out entirely. A DynamicRule is
+// set up once per row, as masks of the counts it uses or, with AVX2, as its
+// table for a byte shuffle.
+//
+// When given a changed array, a kernel also sets changed[x / LIFE_BLOCK_SIZE]
+// for every block of cells in which a cell differs from its last state, with
+// begin a multiple of the block size. The flags are only ever set, never
+// cleared, so one array can collect the changes of several rows.
+//
+
+#ifndef CONWAY_KERNELS_H
+#define CONWAY_KERNELS_H
+
+#include <cstring>
+#include <vector>
+
+#include "rule.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define CONWAY_SIMD_X86
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define CONWAY_SIMD_NEON
+#endif
+
+#if defined(__GNUC__)
+#define CONWAY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CONWAY_TARGET(isa)
+#endif
+
+#define LIFE_BLOCK_SIZE 32  // cells per changed flag
+
+/* a row kernel for a rule and the instruction set it uses */
+template <class R>
+struct LifeRowKernel
+{
+    typedef void (*Function)(const R& rule, const char* a, const char* b, const char* c, char* out, int begin, int end, char* changed);
+
+    const char* name;
+    Function run;
+};
+
+/* one cell, a/b/c point at the cell in the rows above/at/below */
+template <class R>
+inline char lifeCell(const R& rule, const char* a, const char* b, const char* c)
+{
+    int n = a[-1] + a[0] + a[1] + b[-1] + b[1] + c[-1] + c[0] + c[1];
+    return rule.next(b[0], n);
+}
+
+/* plain C++ kernel, also used for the tails of the SIMD kernels */
+template <class R>
+void lifeRowScalar(const R& rule, const char* a, const char* b, const char* c, char* out, int begin, int end, char* changed)
+{
+    for(int x = begin; x<end; x++)
+    {
+        out[x] = lifeCell(rule, a+x, b+x, c+x);
+        if(changed != nullptr)
+        {
+            changed[x / LIFE_BLOCK_SIZE] |= out[x] != b[x];
+        }
+    }
+}
+
+/* kernel for cells of any type, a cell is alive when it equals 1; the
+   rule gets the state of the cell, so this also runs Generations rules */
+template <class T, class R>
+void lifeRowGeneric(const R& rule, const T* a, const T* b, const T* c, T* out, int begin, int end, char* changed)
+{
+    for(int x = begin; x<end; x++)
+    {
+        int n = (a[x-1] == 1) + (a[x] == 1) + (a[x+1] == 1) + (b[x-1] == 1) +
+                (b[x+1] == 1) + (c[x-1] == 1) + (c[x] == 1) + (c[x+1] == 1);
+        out[x] = (T)rule.next(b[x], n);
+        if(changed != nullptr)
+        {
+            changed[x / LIFE_BLOCK_SIZE] |= out[x] != b[x];
+        }
+    }
+}
+
+#ifdef CONWAY_SIMD_X86
+
+/* cells whose count is K or above and makes them live by compile-time rule R,
+   unrolled so that only the counts the rule uses are compared against */
+template <class R, int K>
+struct RuleMatchSSE2
+{
+    CONWAY_TARGET("sse2")
+    static __m128i match(__m128i n, __m128i alive)
+    {
+        __m128i rest = RuleMatchSSE2<R, K+1>::match(n, alive);
+        const bool born = (R::birth >> K) & 1, kept = (R::survival >> K) & 1;
+        if(!born && !kept)
+        {
+            return rest;
+        }
+        __m128i count = _mm_cmpeq_epi8(n, _mm_set1_epi8(K));
+        return _mm_or_si128(rest, born && kept ? count : born ? _mm_andnot_si128(alive, count) : _mm_and_si128(alive, count));
+    }
+};
+
+template <class R>
+struct RuleMatchSSE2<R, RULE_COUNTS>
+{
+    CONWAY_TARGET("sse2")
+    static __m128i match(__m128i, __m128i)
+    {
+        return _mm_setzero_si128();
+    }
+};
+
+/* rule R as the SSE2 kernel applies it, set up once per row */
+template <class R>
+struct RuleSSE2
+{
+    explicit RuleSSE2(const R&){}
+
+    /* next states, 0 or 1, of 16 cells with neighbour counts n; alive is all ones where a cell lives */
+    CONWAY_TARGET("sse2")
+    __m128i next(__m128i n, __m128i alive) const
+    {
+        return _mm_and_si128(RuleMatchSSE2<R, 0>::match(n, alive), _mm_set1_epi8(1));
+    }
+};
+
+/* a rule known only at runtime: the counts it uses, with their birth and survival masks */
+template <>
+struct RuleSSE2<DynamicRule>
+{
+    CONWAY_TARGET("sse2")
+    explicit RuleSSE2(const DynamicRule& rule):used(0)
+    {
+        for(int k = 0; k<RULE_COUNTS; k++)
+        {
+            if(rule.table[0][k] || rule.table[1][k])
+            {
+                counts[used] = _mm_set1_epi8((char)k);
+                born[used] = _mm_set1_epi8(rule.table[0][k] ? -1 : 0);
+                kept[used] = _mm_set1_epi8(rule.table[1][k] ? -1 : 0);
+                used++;
+            }
+        }
+    }
+
+    CONWAY_TARGET("sse2")
+    __m128i next(__m128i n, __m128i alive) const
+    {
+        __m128i live = _mm_setzero_si128();
+        for(int i = 0; i<used; i++)
+        {
+            __m128i lives = _mm_or_si128(_mm_and_si128(alive, kept[i]), _mm_andnot_si128(alive, born[i]));
+            live = _mm_or_si128(live, _mm_and_si128(_mm_cmpeq_epi8(n, counts[i]), lives));
+        }
+        return _mm_and_si128(live, _mm_set1_epi8(1));
+    }
+
+    int used;
+    __m128i counts[RULE_COUNTS], born[RULE_COUNTS], kept[RULE_COUNTS];
+};
+
+/* 16 cells per step with SSE2 */
+template <class R>
+CONWAY_TARGET("sse2")
+void lifeRowSSE2(const R& rule, const char* a, const char* b, const char* c, char* out, int begin, int end, char* changed)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const RuleSSE2<R> apply(rule);
+    int x = begin;
+    for(; x+16 <= end; x += 16)
+    {
+        __m128i n = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(a+x-1)), _mm_loadu_si128((const __m128i*)(a+x)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(a+x+1)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(b+x-1)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(b+x+1)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(c+x-1)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(c+x)));
+        n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i*)(c+x+1)));
+        __m128i last = _mm_loadu_si128((const __m128i*)(b+x));
+        __m128i next = apply.next(n, _mm_cmpeq_epi8(last, one));
+        _mm_storeu_si128((__m128i*)(out+x), next);
+        if(changed != nullptr)
+        {
+            changed[x / LIFE_BLOCK_SIZE] |= _mm_movemask_epi8(_mm_cmpeq_epi8(next, last)) != 0xFFFF;
+        }
+    }
+    lifeRowScalar(rule, a, b, c, out, x, end, changed);
+}
+
+/* cells whose count is K or above and makes them live by compile-time rule R */
+template <class R, int K>
+struct RuleMatchAVX2
+{
+    CONWAY_TARGET("avx2")
+    static __m256i match(__m256i n, __m256i alive)
+    {
+        __m256i rest = RuleMatchAVX2<R, K+1>::match(n, alive);
+        const bool born = (R::birth >> K) & 1, kept = (R::survival >> K) & 1;
+        if(!born && !kept)
+        {
+            return rest;
+        }
+        __m256i count = _mm256_cmpeq_epi8(n, _mm256_set1_epi8(K));
+        return _mm256_or_si256(rest, born && kept ? count : born ? _mm256_andnot_si256(alive, count) : _mm256_and_si256(alive, count));
+    }
+};
+
+template <class R>
+struct RuleMatchAVX2<R, RULE_COUNTS>
+{
+    CONWAY_TARGET("avx2")
+    static __m256i match(__m256i, __m256i)
+    {
+        return _mm256_setzero_si256();
+    }
+};
+
+/* rule R as the AVX2 kernel applies it, set up once per row */
+template <class R>
+struct RuleAVX2
+{
+    explicit RuleAVX2(const R&){}
+
+    /* next states, 0 or 1, of 32 cells with neighbour counts n; alive is all ones where a cell lives */
+    CONWAY_TARGET("avx2")
+    __m256i next(__m256i n, __m256i alive) const
+    {
+        return _mm256_and_si256(RuleMatchAVX2<R, 0>::match(n, alive), _mm256_set1_epi8(1));
+    }
+};
+
+/* a rule known only at runtime: both rows of its table, looked up with a byte shuffle */
+template <>
+struct RuleAVX2<DynamicRule>
+{
+    CONWAY_TARGET("avx2")
+    explicit RuleAVX2(const DynamicRule& rule)
+    {
+        char rows[2][16] = {{0}};
+        std::memcpy(rows[0], rule.table[0], RULE_COUNTS);
+        std::memcpy(rows[1], rule.table[1], RULE_COUNTS);
+        born = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)rows[0]));
+        kept = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)rows[1]));
+    }
+
+    CONWAY_TARGET("avx2")
+    __m256i next(__m256i n, __m256i alive) const
+    {
+        return _mm256_blendv_epi8(_mm256_shuffle_epi8(born, n), _mm256_shuffle_epi8(kept, n), alive);
+    }
+
+    __m256i born, kept;
+};
+
+/* 32 cells per step with AVX2 */
+template <class R>
+CONWAY_TARGET("avx2")
+void lifeRowAVX2(const R& rule, const char* a, const char* b, const char* c, char* out, int begin, int end, char* changed)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const RuleAVX2<R> apply(rule);
+    int x = begin;
+    for(; x+32 <= end; x += 32)
+    {
+        __m256i n = _mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(a+x-1)), _mm256_loadu_si256((const __m256i*)(a+x)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(a+x+1)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(b+x-1)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(b+x+1)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(c+x-1)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(c+x)));
+        n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i*)(c+x+1)));
+        __m256i last = _mm256_loadu_si256((const __m256i*)(b+x));
+        __m256i next = apply.next(n, _mm256_cmpeq_epi8(last, one));
+        _mm256_storeu_si256((__m256i*)(out+x), next);
+        if(changed != nullptr)
+        {
+            __m256i diff = _mm256_xor_si256(next, last);
+            changed[x / LIFE_BLOCK_SIZE] |= !_mm256_testz_si256(diff, diff);
+        }
+    }
+    lifeRowSSE2(rule, a, b, c, out, x, end, changed);
+}
+
+#endif
+
+#ifdef CONWAY_SIMD_NEON
+
+/* cells whose count is K or above and makes them live by compile-time rule R */
+template <class R, int K>
+struct RuleMatchNEON
+{
+    static uint8x16_t match(uint8x16_t n, uint8x16_t alive)
+    {
+        uint8x16_t rest = RuleMatchNEON<R, K+1>::match(n, alive);
+        const bool born = (R::birth >> K) & 1, kept = (R::survival >> K) & 1;
+        if(!born && !kept)
+        {
+            return rest;
+        }
+        uint8x16_t count = vceqq_u8(n, vdupq_n_u8(K));
+        return vorrq_u8(rest, born && kept ? count : born ? vbicq_u8(count, alive) : vandq_u8(alive, count));
+    }
+};
+
+template <class R>
+struct RuleMatchNEON<R, RULE_COUNTS>
+{
+    static uint8x16_t match(uint8x16_t, uint8x16_t)
+    {
+        return vdupq_n_u8(0);
+    }
+};
+
+/* rule R as the NEON kernel applies it, set up once per row */
+template <class R>
+struct RuleNEON
+{
+    explicit RuleNEON(const R&){}
+
+    /* next states, 0 or 1, of 16 cells with neighbour counts n; alive is all ones where a cell lives */
+    uint8x16_t next(uint8x16_t n, uint8x16_t alive) const
+    {
+        return vandq_u8(RuleMatchNEON<R, 0>::match(n, alive), vdupq_n_u8(1));
+    }
+};
+
+/* a rule known only at runtime: the counts it uses, with their birth and survival masks */
+template <>
+struct RuleNEON<DynamicRule>
+{
+    explicit RuleNEON(const DynamicRule& rule):used(0)
+    {
+        for(int k = 0; k<RULE_COUNTS; k++)
+        {
+            if(rule.table[0][k] || rule.table[1][k])
+            {
+                counts[used] = vdupq_n_u8((uint8_t)k);
+                born[used] = vdupq_n_u8(rule.table[0][k] ? 0xFF : 0);
+                kept[used] = vdupq_n_u8(rule.table[1][k] ? 0xFF : 0);
+                used++;
+            }
+        }
+    }
+
+    uint8x16_t next(uint8x16_t n, uint8x16_t alive) const
+    {
+        uint8x16_t live = vdupq_n_u8(0);
+        for(int i = 0; i<used; i++)
+        {
+            live = vorrq_u8(live, vandq_u8(vceqq_u8(n, counts[i]), vbslq_u8(alive, kept[i], born[i])));
+        }
+        return vandq_u8(live, vdupq_n_u8(1));
+    }
+
+    int used;
+    uint8x16_t counts[RULE_COUNTS], born[RULE_COUNTS], kept[RULE_COUNTS];
+};
+
+/* 16 cells per step with NEON */
+template <class R>
+void lifeRowNEON(const R& rule, const char* a, const char* b, const char* c, char* out, int begin, int end, char* changed)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    const RuleNEON<R> apply(rule);
+    const uint8_t* ua = (const uint8_t*)a;
+    const uint8_t* ub = (const uint8_t*)b;
+    const uint8_t* uc = (const uint8_t*)c;
+    int x = begin;
+    for(; x+16 <= end; x += 16)
+    {
+        uint8x16_t n = vaddq_u8(vld1q_u8(ua+x-1), vld1q_u8(ua+x));
+        n = vaddq_u8(n, vld1q_u8(ua+x+1));
+        n = vaddq_u8(n, vld1q_u8(ub+x-1));
+        n = vaddq_u8(n, vld1q_u8(ub+x+1));
+        n = vaddq_u8(n, vld1q_u8(uc+x-1));
+        n = vaddq_u8(n, vld1q_u8(uc+x));
+        n = vaddq_u8(n, vld1q_u8(uc+x+1));
+        uint8x16_t last = vld1q_u8(ub+x);
+        uint8x16_t next = apply.next(n, vceqq_u8(last, one));
+        vst1q_u8((uint8_t*)(out+x), next);
+        if(changed != nullptr)
+        {
+            uint64x2_t diff = vreinterpretq_u64_u8(veorq_u8(next, last));
+            changed[x / LIFE_BLOCK_SIZE] |= (vgetq_lane_u64(diff, 0) | vgetq_lane_u64(diff, 1)) != 0;
+        }
+    }
+    lifeRowScalar(rule, a, b, c, out, x, end, changed);
+}
+
+#endif
+
+/* row kernels for a rule supported by this processor, best first */
+template <class R>
+std::vector<LifeRowKernel<R> > availableLifeRowKernels()
+{
+    std::vector<LifeRowKernel<R> > kernels;
+#ifdef CONWAY_SIMD_X86
+#if defined(__GNUC__)
+    if(__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back(LifeRowKernel<R>{"avx2", lifeRowAVX2<R>});
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        kernels.push_back(LifeRowKernel<R>{"sse2", lifeRowSSE2<R>});
+    }
+#elif defined(_M_X64)
+    kernels.push_back(LifeRowKernel<R>{"sse2", lifeRowSSE2<R>});
+#endif
+#endif
+#ifdef CONWAY_SIMD_NEON
+    kernels.push_back(LifeRowKernel<R>{"neon", lifeRowNEON<R>});
+#endif
+    kernels.push_back(LifeRowKernel<R>{"scalar", lifeRowScalar<R>});
+    return kernels;
+}
+
+/* Generations rules have no SIMD kernels, byte cells take the generic kernel */
+template <>
+inline std::vector<LifeRowKernel<GenerationsRule> > availableLifeRowKernels<GenerationsRule>()
+{
+    return std::vector<LifeRowKernel<GenerationsRule> >(1, LifeRowKernel<GenerationsRule>{"scalar", lifeRowGeneric<char, GenerationsRule>});
+}
+
+/* best row kernel for a rule, or the one with the given name; nullptr if it is not supported */
+template <class R>
+const LifeRowKernel<R>* findLifeRowKernel(const char* name = nullptr)
+{
+    static const std::vector<LifeRowKernel<R> > kernels = availableLifeRowKernels<R>();
+    if(name == nullptr)
+    {
+        return &kernels.front();
+    }
+    for(auto const& kernel: kernels)
+    {
+        if(strcmp(kernel.name, name) == 0)
+        {
+            return &kernel;
+        }
+    }
+    return nullptr;
+}
+
+#endif
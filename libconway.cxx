@@ -0,0 +1,1001 @@
+// Author: 	Stephan Meesters
+//
+// C API of the Game of Life engines (see libconway.h)
+//
+// A handle owns an Engine, the C++ process behind an interface of virtual
+// functions, instantiated once per process type as ProcessEngine<Process>.
+// The byte, bit and change-list grids are instantiated for the compile-time
+// rule that matches the rule given, through dispatchRule(), so a new rule
+// makes a new engine that takes over the board. Failures are kept as the
+// message of the handle, as the process functions report them.
+//
+
+#define CONWAY_BUILDING_LIBRARY
+#include "libconway.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+
+#include "conway.h"
+#include "bitlife.h"
+#include "changelist.h"
+#include "sparse.h"
+#include "hashlife.h"
+#include "ltl.h"
+#include "patterns.h"
+#include "snapshot.h"
+#include "cycle.h"
+#include "random.h"
+#include "threadpool.h"
+#include "affinity.h"
+#include "allocations.h"
+
+/* what the C API asks of a process, whatever its type */
+class Engine
+{
+public:
+
+    virtual ~Engine(){}
+
+    virtual bool setBoundary(BoundaryPolicy policy) = 0;
+    virtual bool setRule(const LifeRule& rule) = 0;             // in place, false when the rule is a template parameter
+    virtual bool setKernel(const char* kernel) = 0;
+    virtual bool setTiles(bool enabled) = 0;
+    virtual void fillRandom(uint64_t seed, uint32_t density) = 0;
+    virtual void clear() = 0;
+    virtual void setCell(int64_t x, int64_t y, bool alive) = 0;
+    virtual bool loadPattern(const char* path, std::string& error) = 0;
+    virtual bool restoreSnapshot(const char* path, std::string& error) = 0;
+    virtual bool restoreSnapshot(const Snapshot& snapshot, std::string& error) = 0;
+    virtual void captureSnapshot(Snapshot& snapshot) = 0;
+    virtual bool releasesGrid() const = 0;                      // checkpoints are packed by releasePrevious()
+    virtual std::function<void(Snapshot&)> releasePrevious() = 0;
+    virtual void step(uint64_t n, const std::atomic<bool>* cancel) = 0;
+    virtual uint64_t generation() const = 0;
+    virtual uint64_t hash() = 0;
+    virtual conway_view view() = 0;
+    virtual bool changes(const std::vector<int>*& tiles, int& columns) = 0;
+};
+
+/* set the boundary of a bounded grid */
+template <class Process>
+bool setProcessBoundary(Process& process, BoundaryPolicy policy)
+{
+    process.setBoundaryPolicy(policy);
+    return true;
+}
+
+inline bool setProcessBoundary(SparseLife&, BoundaryPolicy)
+{
+    return false;
+}
+
+inline bool setProcessBoundary(HashLife&, BoundaryPolicy)
+{
+    return false;
+}
+
+/* step a process by another rule in place, for the processes that take
+   their rule at runtime */
+template <class Process>
+bool setProcessRule(Process&, const LifeRule&)
+{
+    return false;
+}
+
+inline bool setProcessRule(SparseLife& life, const LifeRule& rule)
+{
+    return life.setRule(rule);
+}
+
+inline bool setProcessRule(HashLife& life, const LifeRule& rule)
+{
+    return life.setRule(rule);
+}
+
+/* the row kernel and the tiles of a byte grid, false for the other processes */
+template <class Process>
+bool setProcessKernel(Process&, const char*)
+{
+    return false;
+}
+
+template <class T, class R>
+bool setProcessKernel(Conway<T, R>& conway, const char* kernel)
+{
+    return conway.setRowKernel(kernel);
+}
+
+template <class Process>
+bool setProcessTiles(Process&, bool)
+{
+    return false;
+}
+
+template <class T, class R>
+bool setProcessTiles(Conway<T, R>& conway, bool enabled)
+{
+    conway.setTileTracking(enabled);
+    return true;
+}
+
+/* the processes stepping between two grids let go of the one of the
+   generation before the current one, for the checkpoint writer to pack
+   while they step on; the others are packed by the stepping thread */
+template <class Process>
+bool releasesGrid(const Process&)
+{
+    return false;
+}
+
+template <class T, class R>
+bool releasesGrid(const Conway<T, R>&)
+{
+    return true;
+}
+
+template <class R>
+bool releasesGrid(const BitConway<R>&)
+{
+    return true;
+}
+
+inline bool releasesGrid(const LargerThanLife&)
+{
+    return true;
+}
+
+/* let go of that grid, and return what packs it on the writer */
+template <class Process>
+std::function<void(Snapshot&)> releaseGrid(Process&)
+{
+    return nullptr;
+}
+
+template <class Process>
+std::function<void(Snapshot&)> releaseSteppedGrid(Process& process)
+{
+    process.releasePreviousGrid();
+    return [&process](Snapshot& snapshot){ captureReleased(process, snapshot); };
+}
+
+template <class T, class R>
+std::function<void(Snapshot&)> releaseGrid(Conway<T, R>& conway)
+{
+    return releaseSteppedGrid(conway);
+}
+
+template <class R>
+std::function<void(Snapshot&)> releaseGrid(BitConway<R>& conway)
+{
+    return releaseSteppedGrid(conway);
+}
+
+inline std::function<void(Snapshot&)> releaseGrid(LargerThanLife& life)
+{
+    return releaseSteppedGrid(life);
+}
+
+/* the tiles of a byte grid that changed in the last update, false for the other processes */
+template <class Process>
+bool processChanges(Process&, const std::vector<int>*&, int&)
+{
+    return false;
+}
+
+template <class T, class R>
+bool processChanges(Conway<T, R>& conway, const std::vector<int>*& tiles, int& columns)
+{
+    tiles = &conway.dirtyTiles();
+    columns = conway.tileColumns();
+    return true;
+}
+
+/* advance a process n generations, in as few updates as it takes, or fewer
+   once cancel is set */
+template <class Process>
+void stepProcess(Process& process, uint64_t n, const std::atomic<bool>* cancel)
+{
+    for(; n > 0 && !cancel->load(std::memory_order_relaxed); n -= std::min<uint64_t>(n, INT32_MAX))
+    {
+        advance(process, (int)std::min<uint64_t>(n, INT32_MAX), cancel);
+    }
+}
+
+inline void stepProcess(HashLife& life, uint64_t n, const std::atomic<bool>*)
+{
+    life.advance(n);
+}
+
+/* the view of a grid of bytes or bits */
+template <class T>
+conway_view cellView(const GridView<T>& grid)
+{
+    static_assert(sizeof(T) == 1, "the C API views a byte per cell");
+    conway_view view = {grid.row(0), grid.stride() * (std::ptrdiff_t)sizeof(T), grid.width(), grid.height(),
+                        CONWAY_CELLS_BYTES};
+    return view;
+}
+
+inline conway_view cellView(const BitGridView& grid)
+{
+    conway_view view = {grid.row(0), grid.stride() * (std::ptrdiff_t)sizeof(uint64_t), grid.width(), grid.height(),
+                        CONWAY_CELLS_BITS};
+    return view;
+}
+
+/* an Engine stepping a process of type Process */
+template <class Process>
+class ProcessEngine: public Engine
+{
+public:
+
+    /* constructor, the process is built from the arguments */
+    template <class... Args>
+    ProcessEngine(int width, int height, Args&&... args):process(std::forward<Args>(args)...),
+        gridWidth(width), gridHeight(height), boundary(BOUNDARY_TORUS), viewed(false){}
+
+    Process& get() { return process; }
+
+    bool setBoundary(BoundaryPolicy policy)
+    {
+        if(!setProcessBoundary(process, policy))
+        {
+            return false;
+        }
+        boundary = policy;
+        return true;
+    }
+
+    bool setRule(const LifeRule& rule) { return setProcessRule(process, rule); }
+    bool setKernel(const char* kernel) { return setProcessKernel(process, kernel); }
+    bool setTiles(bool enabled) { return setProcessTiles(process, enabled); }
+
+    void fillRandom(uint64_t seed, uint32_t density) { viewed = false; process.randomFill(seed, density); }
+    void clear() { viewed = false; process.clear(); }
+    void setCell(int64_t x, int64_t y, bool alive) { viewed = false; process.setCell(x, y, alive); }
+
+    bool loadPattern(const char* path, std::string& error)
+    {
+        viewed = false;
+        return ::loadPattern(path, process, gridWidth, gridHeight, error);
+    }
+
+    bool restoreSnapshot(const char* path, std::string& error)
+    {
+        viewed = false;
+        return ::restoreSnapshot(path, process, gridWidth, gridHeight, error);
+    }
+
+    bool restoreSnapshot(const Snapshot& snapshot, std::string& error)
+    {
+        viewed = false;
+        return ::restoreSnapshot(snapshot, process, gridWidth, gridHeight, error);
+    }
+
+    void captureSnapshot(Snapshot& snapshot)
+    {
+        ::captureSnapshot(process, snapshot);
+        snapshot.boundary = boundary;
+        snapshot.width = gridWidth;
+        snapshot.height = gridHeight;
+    }
+
+    bool releasesGrid() const { return ::releasesGrid(process); }
+
+    /* let go of the grid of the generation before the current one; the
+       snapshot of it takes the settings of now */
+    std::function<void(Snapshot&)> releasePrevious()
+    {
+        std::function<void(Snapshot&)> pack = releaseGrid(process);
+        uint64_t generation = process.generation() - 1;
+        BoundaryPolicy policy = boundary;
+        return [pack, generation, policy](Snapshot& snapshot)
+        {
+            pack(snapshot);
+            snapshot.generation = generation;
+            snapshot.boundary = policy;
+        };
+    }
+
+    void step(uint64_t n, const std::atomic<bool>* cancel) { viewed = false; stepProcess(process, n, cancel); }
+    uint64_t generation() const { return process.generation(); }
+    uint64_t hash() { return processHash(process); }
+
+    /* the unbounded processes paint their window for a view, once per generation */
+    conway_view view()
+    {
+        if(!viewed)
+        {
+            current = cellView(process.fullGrid());
+            viewed = true;
+        }
+        return current;
+    }
+
+    bool changes(const std::vector<int>*& tiles, int& columns) { return processChanges(process, tiles, columns); }
+
+private:
+
+    Process process;
+    int gridWidth, gridHeight;
+    BoundaryPolicy boundary;
+    conway_view current;
+    bool viewed;                // current is the view of the cells as they are
+};
+
+/* creates the engine of a grid for the rule it is handed */
+struct EngineFactory
+{
+    const std::string& engine;
+    int width, height;
+    ThreadPool& pool;
+    Engine* result;
+    std::string error;
+
+    template <class R>
+    void operator()(const R& rule)
+    {
+        if(engine == "bit")
+        {
+            ProcessEngine<BitConway<R> >* bits = new ProcessEngine<BitConway<R> >(width, height, width, height, rule);
+            bits->get().setThreadPool(&pool);
+            result = bits;
+        }
+        else if(engine == "changes")
+        {
+            result = new ProcessEngine<ChangeListLife<R> >(width, height, width, height, rule);
+        }
+        else
+        {
+            createBytes(rule);
+        }
+    }
+
+    /* a bit, or a flip in the change list, holds no more than two states */
+    void operator()(const GenerationsRule& rule)
+    {
+        if(engine != "byte")
+        {
+            error = "the " + engine + " engine does not support Generations rules";
+            return;
+        }
+        createBytes(rule);
+    }
+
+    template <class R>
+    void createBytes(const R& rule)
+    {
+        ProcessEngine<Conway<char, R> >* bytes = new ProcessEngine<Conway<char, R> >(width, height, width, height, rule);
+        bytes->get().setThreadPool(&pool);
+        result = bytes;
+    }
+};
+
+/* a process behind the C API, and the state it needs */
+struct conway_life
+{
+    explicit conway_life(int threads):pool(threads), engine(nullptr), width(0), height(0),
+        boundary(BOUNDARY_TORUS), tiles(true), cancel(false), checkpointer(nullptr), deferred(false), deferredGeneration(0){}
+
+    ~conway_life()
+    {
+        delete checkpointer;    // finishes the checkpoint being written
+        delete engine;
+    }
+
+    ThreadPool pool;
+    Engine* engine;
+    std::string name;               // of the engine
+    int width, height;
+    BoundaryPolicy boundary;        // settings an engine created for another rule is given again
+    std::string kernel;
+    bool tiles;
+    std::atomic<bool> cancel;       // set by conway_interrupt()
+    Checkpointer* checkpointer;     // nullptr for no checkpoints
+    bool deferred;                  // a checkpoint of deferredGeneration waits for the grid to be let go of
+    uint64_t deferredGeneration;
+    Snapshot snapshot;              // kept, the next snapshot reuses its words
+    std::string error;
+    std::vector<uint64_t> row;      // a packed row, for counting cells
+};
+
+/* create an engine for a handle, nullptr with the reason if it cannot be */
+static Engine* createEngine(conway_life& life, const std::string& engine, const char* rule, std::string& error)
+{
+    int width = life.width, height = life.height;
+    if(engine == "ltl")
+    {
+        LtlRule ltlRule = boscoRule();
+        if(rule != nullptr && !parseLtlRule(rule, ltlRule))
+        {
+            error = std::string("not a Larger than Life rule: ") + rule;
+            return nullptr;
+        }
+        ProcessEngine<LargerThanLife>* ltl = new ProcessEngine<LargerThanLife>(width, height, width, height, ltlRule);
+        ltl->get().setThreadPool(&life.pool);
+        return ltl;
+    }
+    LifeRule lifeRule = ConwayRule::lifeRule();
+    if(rule != nullptr && !parseRule(rule, lifeRule))
+    {
+        error = std::string("not a rule: ") + rule;
+        return nullptr;
+    }
+    if(engine == "sparse")
+    {
+        ProcessEngine<SparseLife>* sparse = new ProcessEngine<SparseLife>(width, height, width, height);
+        sparse->get().setThreadPool(&life.pool);
+        if(!sparse->get().setRule(lifeRule))
+        {
+            delete sparse;
+            error = "the sparse engine does not support B0 or Generations rules";
+            return nullptr;
+        }
+        return sparse;
+    }
+    if(engine == "hashlife")
+    {
+        ProcessEngine<HashLife>* hashlife = new ProcessEngine<HashLife>(width, height, width, height);
+        if(!hashlife->get().setRule(lifeRule))
+        {
+            delete hashlife;
+            error = "the hashlife engine does not support B0 or Generations rules";
+            return nullptr;
+        }
+        return hashlife;
+    }
+    if(engine != "byte" && engine != "bit" && engine != "changes")
+    {
+        error = "unknown engine: " + engine;
+        return nullptr;
+    }
+    EngineFactory factory = {engine, width, height, life.pool, nullptr, ""};
+    dispatchRule(lifeRule, factory);
+    error = factory.error;
+    return factory.result;
+}
+
+/* give an engine created for another rule the settings of the handle, false
+   with the reason if it does not take them */
+static bool configureEngine(conway_life& life, Engine& engine, std::string& error)
+{
+    if(life.boundary != BOUNDARY_TORUS && !engine.setBoundary(life.boundary))
+    {
+        error = "the plane of an unbounded engine has no edges";
+        return false;
+    }
+    if(!life.kernel.empty() && !engine.setKernel(life.kernel.c_str()))
+    {
+        error = "kernel not supported: " + life.kernel;
+        return false;
+    }
+    if(!life.tiles && !engine.setTiles(false))
+    {
+        error = "only the byte engine tracks tiles";
+        return false;
+    }
+    return true;
+}
+
+/* hand the current generation to the checkpoint writer when a checkpoint is
+   due; a process that releases its grids keeps it for the next step */
+static void checkpoint(conway_life& life)
+{
+    if(life.checkpointer == nullptr || life.deferred || !life.checkpointer->due(life.engine->generation()))
+    {
+        return;
+    }
+    if(life.engine->releasesGrid())
+    {
+        life.deferred = true;
+        life.deferredGeneration = life.engine->generation();
+        return;
+    }
+    AllowAllocations allow;     // the rule is stored as text
+    life.engine->captureSnapshot(life.checkpointer->spare());
+    life.checkpointer->submit();
+}
+
+/* hand the writer a deferred checkpoint: the grid let go of, once the process
+   is one generation past it, or otherwise the current generation packed here */
+static void takeDeferred(conway_life& life)
+{
+    if(!life.deferred)
+    {
+        return;
+    }
+    life.deferred = false;
+    AllowAllocations allow;     // the rule is stored as text
+    if(life.engine->generation() == life.deferredGeneration + 1)
+    {
+        life.checkpointer->submit(life.deferredGeneration, life.engine->releasePrevious());
+        return;
+    }
+    life.engine->captureSnapshot(life.checkpointer->spare());
+    life.checkpointer->submit();
+}
+
+/* fail a call on a handle with a reason; every entry point catches what the
+   process functions throw, such as std::bad_alloc, and fails with it too */
+static int fail(conway_life* life, const std::string& error)
+{
+    life->error = error;
+    return CONWAY_ERROR;
+}
+
+int conway_api_version(void)
+{
+    return CONWAY_API_VERSION;
+}
+
+conway_life* conway_create(const char* engine, int width, int height, const char* rule, int threads,
+                           char* error, size_t error_size)
+{
+    std::string reason;
+    conway_life* life = nullptr;
+    if(width <= 0 || height <= 0 || (uint64_t)width * height >= (uint64_t(1) << 32))
+    {
+        reason = "a grid is 1 to 2^32-1 cells";
+    }
+    else
+    {
+        if(threads <= 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        try
+        {
+            life = new conway_life(threads);
+            life->name = engine != nullptr ? engine : "byte";
+            life->width = width;
+            life->height = height;
+            life->engine = createEngine(*life, life->name, rule, reason);
+            if(life->engine == nullptr)
+            {
+                delete life;
+                life = nullptr;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            delete life;
+            life = nullptr;
+            reason = e.what();
+        }
+    }
+    if(life == nullptr && error != nullptr && error_size > 0)
+    {
+        snprintf(error, error_size, "%s", reason.c_str());
+    }
+    return life;
+}
+
+void conway_use_huge_pages(int on)
+{
+    gridHugePages() = on != 0;
+}
+
+void conway_destroy(conway_life* life)
+{
+    if(life == nullptr)
+    {
+        return;
+    }
+    try
+    {
+        takeDeferred(*life);
+    }
+    catch(const std::exception&)
+    {
+        // the handle goes nonetheless, without its last checkpoint
+    }
+    delete life;
+}
+
+const char* conway_error(const conway_life* life)
+{
+    return life->error.c_str();
+}
+
+int conway_set_boundary(conway_life* life, conway_boundary boundary)
+{
+    try
+    {
+        takeDeferred(*life);
+        if(boundary < CONWAY_BOUNDARY_TORUS || boundary > CONWAY_BOUNDARY_MIRROR)
+        {
+            return fail(life, "unknown boundary");
+        }
+        if(!life->engine->setBoundary((BoundaryPolicy)boundary))
+        {
+            return fail(life, "the plane of an unbounded engine has no edges");
+        }
+        life->boundary = (BoundaryPolicy)boundary;
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_set_rule(conway_life* life, const char* rule)
+{
+    try
+    {
+        takeDeferred(*life);
+
+        // NULL goes back to the default rule, as for conway_create()
+        LifeRule lifeRule = ConwayRule::lifeRule();
+        if(life->name != "ltl" && (rule == nullptr || parseRule(rule, lifeRule)) && life->engine->setRule(lifeRule))
+        {
+            return CONWAY_OK;
+        }
+
+        // the rule is a template parameter of the process, an engine of the
+        // new rule takes over the board
+        std::string error;
+        Engine* engine = createEngine(*life, life->name, rule, error);
+        if(engine == nullptr)
+        {
+            return fail(life, error);
+        }
+        life->engine->captureSnapshot(life->snapshot);
+        if(!configureEngine(*life, *engine, error) || !engine->restoreSnapshot(life->snapshot, error))
+        {
+            delete engine;
+            return fail(life, error);
+        }
+        if(life->checkpointer != nullptr)
+        {
+            life->checkpointer->finish();   // it may be packing the grid the old engine let go of
+        }
+        delete life->engine;
+        life->engine = engine;
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_pin_threads(conway_life* life, conway_pinning pinning)
+{
+    try
+    {
+        static const AffinityPolicy policies[] = {AFFINITY_NONE, AFFINITY_CORES, AFFINITY_NODES};
+        if(pinning < CONWAY_PIN_NONE || pinning > CONWAY_PIN_NODES)
+        {
+            return fail(life, "unknown pinning");
+        }
+        std::string error;
+        if(!pinThreadPool(life->pool, policies[pinning], error))
+        {
+            return fail(life, error);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_set_kernel(conway_life* life, const char* kernel)
+{
+    try
+    {
+        if(life->name != "byte")
+        {
+            return fail(life, "only the byte engine has row kernels");
+        }
+        if(!life->engine->setKernel(kernel))
+        {
+            return fail(life, std::string("kernel not supported: ") + kernel);
+        }
+        life->kernel = kernel;
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_set_tiles(conway_life* life, int on)
+{
+    try
+    {
+        if(!life->engine->setTiles(on != 0))
+        {
+            return fail(life, "only the byte engine tracks tiles");
+        }
+        life->tiles = on != 0;
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_fill_random(conway_life* life, uint64_t seed, double density)
+{
+    try
+    {
+        takeDeferred(*life);
+        if(!(density >= 0 && density <= 1))
+        {
+            return fail(life, "a density is between 0 and 1");
+        }
+        life->engine->fillRandom(seed, randomDensity(density));
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_clear(conway_life* life)
+{
+    try
+    {
+        takeDeferred(*life);
+        life->engine->clear();
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_set_cell(conway_life* life, int64_t x, int64_t y, int alive)
+{
+    try
+    {
+        takeDeferred(*life);
+        if(x >= 0 && y >= 0 && x < life->width && y < life->height)
+        {
+            life->engine->setCell(x, y, alive != 0);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_load_pattern(conway_life* life, const char* path)
+{
+    try
+    {
+        takeDeferred(*life);
+        std::string error;
+        if(!life->engine->loadPattern(path, error))
+        {
+            return fail(life, std::string("cannot load ") + path + ": " + error);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_restore_snapshot(conway_life* life, const char* path)
+{
+    try
+    {
+        takeDeferred(*life);
+        std::string error;
+        if(!life->engine->restoreSnapshot(path, error))
+        {
+            return fail(life, std::string("cannot restore ") + path + ": " + error);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_save_snapshot(conway_life* life, const char* path, int compress)
+{
+    try
+    {
+        std::string error;
+        life->engine->captureSnapshot(life->snapshot);
+        if(!writeSnapshot(life->snapshot, path, compress != 0, error))
+        {
+            return fail(life, std::string("cannot write ") + path + ": " + error);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_step(conway_life* life, uint64_t n)
+{
+    try
+    {
+        if(life->deferred && n > 0)
+        {
+            // one generation on, the process lets go of the grid of the checkpoint
+            life->engine->step(1, &life->cancel);
+            takeDeferred(*life);
+            n--;
+        }
+        life->engine->step(n, &life->cancel);
+        checkpoint(*life);
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+void conway_interrupt(conway_life* life, int interrupt)
+{
+    life->cancel.store(interrupt != 0, std::memory_order_relaxed);
+}
+
+int conway_set_checkpoints(conway_life* life, const char* path, uint64_t every, int compress)
+{
+    try
+    {
+        takeDeferred(*life);
+        delete life->checkpointer;
+        life->checkpointer = nullptr;
+        if(path != nullptr)
+        {
+            life->checkpointer = new Checkpointer(path, every, compress != 0);
+        }
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+uint64_t conway_generation(const conway_life* life)
+{
+    return life->engine->generation();
+}
+
+int conway_width(const conway_life* life)
+{
+    return life->width;
+}
+
+int conway_height(const conway_life* life)
+{
+    return life->height;
+}
+
+uint64_t conway_population(conway_life* life)
+{
+    try
+    {
+        conway_view view = life->engine->view();
+        uint64_t population = 0;
+        if(view.format == CONWAY_CELLS_BITS)
+        {
+            BitGridView grid(static_cast<const uint64_t*>(view.cells), view.width, view.height, view.stride / sizeof(uint64_t));
+            life->row.resize((view.width + 63) / 64);
+            for(int y = 0; y<view.height; y++)
+            {
+                packRow(grid, y, life->row.data());
+                for(uint64_t word: life->row)
+                {
+                    population += __builtin_popcountll(word);
+                }
+            }
+            return population;
+        }
+        for(int y = 0; y<view.height; y++)
+        {
+            const char* row = static_cast<const char*>(view.cells) + y * view.stride;
+            for(int x = 0; x<view.width; x++)
+            {
+                population += row[x] == 1;
+            }
+        }
+        return population;
+    }
+    catch(const std::exception& e)
+    {
+        fail(life, e.what());
+        return 0;
+    }
+}
+
+uint64_t conway_hash(conway_life* life)
+{
+    try
+    {
+        return life->engine->hash();
+    }
+    catch(const std::exception& e)
+    {
+        fail(life, e.what());
+        return 0;
+    }
+}
+
+int conway_get_cell(conway_life* life, int x, int y)
+{
+    try
+    {
+        if(x < 0 || y < 0 || x >= life->width || y >= life->height)
+        {
+            return 0;
+        }
+        conway_view view = life->engine->view();
+        const char* row = static_cast<const char*>(view.cells) + y * view.stride;
+        if(view.format == CONWAY_CELLS_BITS)
+        {
+            uint64_t word;
+            std::memcpy(&word, row + (x >> 6) * sizeof(uint64_t), sizeof(word));
+            return (int)((word >> (x & 63)) & 1);
+        }
+        return row[x];
+    }
+    catch(const std::exception& e)
+    {
+        fail(life, e.what());
+        return 0;
+    }
+}
+
+int conway_get_view(conway_life* life, conway_view* view)
+{
+    try
+    {
+        *view = life->engine->view();
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
+
+int conway_get_changes(conway_life* life, const int** tiles, size_t* count, int* columns, int* tile_size)
+{
+    try
+    {
+        const std::vector<int>* changed;
+        if(!life->engine->changes(changed, *columns))
+        {
+            return fail(life, "only the byte engine tracks tiles");
+        }
+        *tiles = changed->data();
+        *count = changed->size();
+        *tile_size = TILE_SIZE;
+        return CONWAY_OK;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(life, e.what());
+    }
+}
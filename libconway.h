@@ -0,0 +1,196 @@
+
+/* Author: 	Stephan Meesters
+ *
+ * C API of the Game of Life engines, for embedding them in other programs
+ *
+ * The library holds one process per conway_life handle: create it for an
+ * engine, a grid size and a rule, seed it at random, from a pattern file or
+ * from a snapshot, advance it any number of generations and query it. No
+ * window is involved and the library does not depend on SDL.
+ *
+ * The current generation is read in place through a conway_view, a pointer to
+ * the first cell with the distance between rows, either a byte per cell or a
+ * bit per cell packed into 64-bit words. The view is owned by the handle and
+ * stays valid until the next call that changes the cells; nothing is copied
+ * for the dense engines. The unbounded engines, sparse and hashlife, paint
+ * the width x height window at the origin into a buffer of the handle first.
+ *
+ * Functions that can fail return CONWAY_OK or CONWAY_ERROR, and conway_error()
+ * tells why; running out of memory is such a failure, and no exception leaves
+ * the library. A handle is used from one thread at a time, except for
+ * conway_interrupt(), which stops a long step from another.
+ */
+
+#ifndef CONWAY_LIBCONWAY_H
+#define CONWAY_LIBCONWAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(CONWAY_SHARED)
+#  ifdef CONWAY_BUILDING_LIBRARY
+#    define CONWAY_API __declspec(dllexport)
+#  else
+#    define CONWAY_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__) && defined(CONWAY_SHARED)
+#  define CONWAY_API __attribute__((visibility("default")))
+#else
+#  define CONWAY_API
+#endif
+
+#define CONWAY_API_VERSION 2    /* raised when a function or structure changes */
+
+#define CONWAY_OK 0
+#define CONWAY_ERROR -1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a Game of Life process */
+typedef struct conway_life conway_life;
+
+/* what lies beyond the edges of a bounded grid */
+typedef enum conway_boundary
+{
+    CONWAY_BOUNDARY_TORUS = 0,  /* wrap around to the opposite edge */
+    CONWAY_BOUNDARY_DEAD = 1,   /* dead cells */
+    CONWAY_BOUNDARY_MIRROR = 2  /* reflection of the edge */
+} conway_boundary;
+
+/* where the threads of the pool run */
+typedef enum conway_pinning
+{
+    CONWAY_PIN_NONE = 0,        /* wherever the scheduler puts them */
+    CONWAY_PIN_CORES = 1,       /* a processor per band of the grid */
+    CONWAY_PIN_NODES = 2        /* the processors of a NUMA node per band */
+} conway_pinning;
+
+/* how the cells of a view are stored */
+typedef enum conway_cell_format
+{
+    CONWAY_CELLS_BYTES = 0,     /* a byte per cell holding its state, 0 is dead */
+    CONWAY_CELLS_BITS = 1       /* cell x of a row in bit x%64 of 64-bit word x/64 */
+} conway_cell_format;
+
+/* read-only view of the current generation */
+typedef struct conway_view
+{
+    const void* cells;          /* first cell of row 0 */
+    ptrdiff_t stride;           /* bytes from the start of a row to the next */
+    int width, height;          /* cells */
+    conway_cell_format format;
+} conway_view;
+
+/* CONWAY_API_VERSION of the library, to compare with the header */
+CONWAY_API int conway_api_version(void);
+
+/* create a process of width x height cells for an engine, byte, bit,
+   changes, sparse, hashlife or ltl, stepped by a rule in B/S notation, or in
+   Larger than Life notation for ltl; NULL for the default of the engine.
+   threads is the size of the pool of the engines that step in parallel, 0
+   for one per core. Returns NULL when the process cannot be created, with
+   the reason in error when it is not NULL */
+CONWAY_API conway_life* conway_create(const char* engine, int width, int height, const char* rule, int threads,
+                                      char* error, size_t error_size);
+
+/* back the grids of the processes created from now on with transparent
+   huge pages when on is not 0, where the system has them */
+CONWAY_API void conway_use_huge_pages(int on);
+
+/* destroy a process, NULL is ignored; a checkpoint being written is finished */
+CONWAY_API void conway_destroy(conway_life* life);
+
+/* why the last function that failed on a process failed */
+CONWAY_API const char* conway_error(const conway_life* life);
+
+/* set what lies beyond the edges, fails for the unbounded engines */
+CONWAY_API int conway_set_boundary(conway_life* life, conway_boundary boundary);
+
+/* step by another rule from the current generation on, in the notation of
+   conway_create(), NULL for the default of the engine; the byte, bit,
+   changes and ltl engines are created anew for it and take over the cells */
+CONWAY_API int conway_set_rule(conway_life* life, const char* rule);
+
+/* pin the threads of the pool by a policy. The calling thread runs the first
+   band of every step and is pinned with them, so call it from the thread
+   that steps the process, before the cells are first set so that the rows
+   of every band are placed on its node */
+CONWAY_API int conway_pin_threads(conway_life* life, conway_pinning pinning);
+
+/* byte engine: step rows by a kernel, avx2, sse2, neon or scalar, instead
+   of the best the processor has */
+CONWAY_API int conway_set_kernel(conway_life* life, const char* kernel);
+
+/* byte engine: only recompute the tiles near cells that changed, when on is
+   not 0, which is the default */
+CONWAY_API int conway_set_tiles(conway_life* life, int on);
+
+/* replace the cells by the random board of a seed, each cell alive with a
+   probability; the same seed gives the same board on every engine */
+CONWAY_API int conway_fill_random(conway_life* life, uint64_t seed, double density);
+
+/* remove all cells */
+CONWAY_API int conway_clear(conway_life* life);
+
+/* set a cell of the window, cells outside it are ignored */
+CONWAY_API int conway_set_cell(conway_life* life, int64_t x, int64_t y, int alive);
+
+/* replace the cells by a pattern file, .rle, .cells, .lif or .mc for
+   hashlife, centred in the window */
+CONWAY_API int conway_load_pattern(conway_life* life, const char* path);
+
+/* restore a snapshot written by conway_save_snapshot() or the viewer */
+CONWAY_API int conway_restore_snapshot(conway_life* life, const char* path);
+
+/* write a snapshot of the current generation, run-length encoded when compress is not 0 */
+CONWAY_API int conway_save_snapshot(conway_life* life, const char* path, int compress);
+
+/* advance n generations, fewer when interrupted */
+CONWAY_API int conway_step(conway_life* life, uint64_t n);
+
+/* while interrupt is not 0, make the conway_step() in progress on another
+   thread and the ones after it return early; they stop between generations,
+   the byte engine between tiles, and hashlife only once it is done. The
+   thread that steps clears it again before the steps that are to run */
+CONWAY_API void conway_interrupt(conway_life* life, int interrupt);
+
+/* write a snapshot to path whenever a conway_step() reaches every more
+   generations since the last, on a thread of its own; one that comes due
+   while the last is still being written is taken at the first step after
+   it. The byte, bit and ltl engines hand the writer the grid of a due
+   generation at the next call that steps or changes the board, once they
+   are past it, so that no cells are copied by the thread that steps.
+   NULL for no more checkpoints */
+CONWAY_API int conway_set_checkpoints(conway_life* life, const char* path, uint64_t every, int compress);
+
+/* generations computed since the cells were set */
+CONWAY_API uint64_t conway_generation(const conway_life* life);
+
+/* width and height of the window */
+CONWAY_API int conway_width(const conway_life* life);
+CONWAY_API int conway_height(const conway_life* life);
+
+/* live cells in the window */
+CONWAY_API uint64_t conway_population(conway_life* life);
+
+/* hash of the cells of the window, equal for equal boards on every engine */
+CONWAY_API uint64_t conway_hash(conway_life* life);
+
+/* state of a cell of the window, 0 for dead and for cells outside it */
+CONWAY_API int conway_get_cell(conway_life* life, int x, int y);
+
+/* view of the current generation, valid until the cells change */
+CONWAY_API int conway_get_view(conway_life* life, conway_view* view);
+
+/* byte engine: the tiles of tile_size x tile_size cells that changed in the
+   last step, count of them as index y*columns + x, sorted; valid until the
+   cells change. Fails for the other engines */
+CONWAY_API int conway_get_changes(conway_life* life, const int** tiles, size_t* count, int* columns, int* tile_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
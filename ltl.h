@@ -0,0 +1,403 @@
+
+// Author: 	Stephan Meesters
+//
+// Larger than Life process
+//
+// Larger than Life counts the live cells in the (2R+1)x(2R+1) box around a
+// cell instead of its eight neighbours. Rules are written as in Golly,
+// R5,C0,M1,S34..58,B34..45,NM: range R, C states (0 for two, more decay like
+// a Generations rule), M1 when the cell counts itself, the survival and birth
+// ranges, and the Moore neighbourhood.
+//
+// Counting every box would cost O(R^2) per cell. Instead every band of rows
+// keeps the vertical sums of its columns over the 2R+1 rows around the
+// current row, moved down a row by adding the row entering the box and
+// subtracting the one leaving it, and a box is a window of 2R+1 column sums
+// slid along the row. Every cell costs a few adds whatever the range.
+//
+
+#ifndef CONWAY_LTL_H
+#define CONWAY_LTL_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "rule.h"
+#include "random.h"
+
+#define LTL_MAX_RANGE 500   // as in Golly
+
+/* a Larger than Life rule */
+struct LtlRule
+{
+    int range;
+    int states;             // 2, or more for cells that decay
+    bool middle;            // the cell counts itself
+    int survivalMin, survivalMax;
+    int birthMin, birthMax;
+
+    /* next state of a cell with count live cells in its box */
+    int next(int state, int count) const
+    {
+        if(state == 0)
+        {
+            return count >= birthMin && count <= birthMax;
+        }
+        if(state == 1 && count >= survivalMin && count <= survivalMax)
+        {
+            return 1;
+        }
+        return (state + 1) % states;
+    }
+};
+
+inline bool operator==(const LtlRule& a, const LtlRule& b)
+{
+    return a.range == b.range && a.states == b.states && a.middle == b.middle &&
+           a.survivalMin == b.survivalMin && a.survivalMax == b.survivalMax &&
+           a.birthMin == b.birthMin && a.birthMax == b.birthMax;
+}
+
+/* Bosco's rule, the best known Larger than Life rule */
+inline LtlRule boscoRule()
+{
+    return LtlRule{5, 2, true, 34, 58, 34, 45};
+}
+
+/* read a number, false if there is none or it is above max */
+inline bool parseLtlNumber(const char*& text, int max, int& value)
+{
+    if(*text < '0' || *text > '9')
+    {
+        return false;
+    }
+    value = 0;
+    for(; *text >= '0' && *text <= '9'; text++)
+    {
+        value = 10*value + (*text - '0');
+        if(value > max)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* read a range min..max */
+inline bool parseLtlRange(const char*& text, int& min, int& max)
+{
+    int limit = (2*LTL_MAX_RANGE+1) * (2*LTL_MAX_RANGE+1);
+    if(!parseLtlNumber(text, limit, min) || text[0] != '.' || text[1] != '.')
+    {
+        return false;
+    }
+    text += 2;
+    return parseLtlNumber(text, limit, max);
+}
+
+/* skip the text of a part of the rule, false if it is not next */
+inline bool parseLtlPart(const char*& text, const char* part)
+{
+    std::size_t length = std::strlen(part);
+    if(std::strncmp(text, part, length) != 0)
+    {
+        return false;
+    }
+    text += length;
+    return true;
+}
+
+/* read a rule in Golly notation; only the Moore neighbourhood NM */
+inline bool parseLtlRule(const char* text, LtlRule& rule)
+{
+    int states, middle;
+    if(!parseLtlPart(text, "R") || !parseLtlNumber(text, LTL_MAX_RANGE, rule.range) || rule.range < 1 ||
+       !parseLtlPart(text, ",C") || !parseLtlNumber(text, RULE_MAX_STATES, states) ||
+       !parseLtlPart(text, ",M") || !parseLtlNumber(text, 1, middle) ||
+       !parseLtlPart(text, ",S") || !parseLtlRange(text, rule.survivalMin, rule.survivalMax) ||
+       !parseLtlPart(text, ",B") || !parseLtlRange(text, rule.birthMin, rule.birthMax))
+    {
+        return false;
+    }
+    if(*text == ',' && !parseLtlPart(text, ",NM"))
+    {
+        return false;
+    }
+    rule.states = std::max(states, 2);  // C0 and C1 both mean two states
+    rule.middle = middle == 1;
+    return *text == 0;
+}
+
+/* a rule in Golly notation */
+inline std::string ltlRuleString(const LtlRule& rule)
+{
+    return "R" + std::to_string(rule.range) + ",C" + std::to_string(rule.states > 2 ? rule.states : 0) +
+           ",M" + std::to_string(rule.middle ? 1 : 0) +
+           ",S" + std::to_string(rule.survivalMin) + ".." + std::to_string(rule.survivalMax) +
+           ",B" + std::to_string(rule.birthMin) + ".." + std::to_string(rule.birthMax) + ",NM";
+}
+
+/* Larger than Life process, one byte per cell holding its state */
+class LargerThanLife
+{
+public:
+
+    /* constructor */
+    LargerThanLife(int width, int height, const LtlRule& rule = boscoRule()):newGrid(width, height), oldGrid(width, height),
+        gridWidth(width), gridHeight(height), rule(rule), boundary(BOUNDARY_TORUS), pool(nullptr), generations(0)
+    {
+        mapSources();
+    }
+
+    /* initialize grid with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                newGrid(i,j) = gen() == 0;
+            }
+        }
+        generations = 0;
+    }
+
+    /* fill the grid with random cells of a density in RANDOM_DENSITY_BITS
+       fractional bits, the board of the seed (see random.h), in bands of
+       rows on the thread pool */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        auto fill = [this, key, density](int band, int numBands)
+        {
+            int begin, end;
+            ThreadPool::bandRange(band, numBands, gridHeight, begin, end);
+            for(int j = begin; j<end; j++)
+            {
+                randomRow(key, j, gridWidth, density, newGrid.row(j));
+            }
+        };
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run(fill);
+        }
+        else
+        {
+            fill(0, 1);
+        }
+        generations = 0;
+    }
+
+    /* remove all cells */
+    void clear()
+    {
+        newGrid.fill(0);
+        generations = 0;
+    }
+
+    /* set a cell, cells outside the grid are ignored */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        if(x >= 0 && y >= 0 && x < gridWidth && y < gridHeight)
+        {
+            newGrid((int)x, (int)y) = alive;
+        }
+    }
+
+    /* set row y from bit-packed planes of words, bit p of the state of cell x
+       in bit x%64 of word x/64 of plane p */
+    void setRow(int y, const uint64_t* words, int planes = 1)
+    {
+        int wordsPerRow = (gridWidth + 63) / 64;
+        char* row = newGrid.row(y);
+        for(int x = 0; x<gridWidth; x++)
+        {
+            int state = 0;
+            for(int p = 0; p<planes; p++)
+            {
+                state |= int((words[p*wordsPerRow + (x >> 6)] >> (x & 63)) & 1) << p;
+            }
+            row[x] = (char)(state < rule.states ? state : 0);
+        }
+    }
+
+    /* the rule the grid is stepped by */
+    const LtlRule& ltlRule() const { return rule; }
+
+    /* generations computed since the grid was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+    /* step in parallel bands on a pool of threads, nullptr for single-threaded */
+    void setThreadPool(ThreadPool* threadPool)
+    {
+        pool = threadPool;
+    }
+
+    /* set what lies beyond the edges of the grid */
+    void setBoundaryPolicy(BoundaryPolicy policy)
+    {
+        boundary = policy;
+        mapSources();
+    }
+
+    /* return a view of the grid */
+    GridView<char> fullGrid() const
+    {
+        return newGrid.view();
+    }
+
+    /* let go of the grid of the previous generation, which the next update
+       only writes over, for a spare one; its cells stay in releasedGrid()
+       until the next call */
+    void releasePreviousGrid()
+    {
+        if(released.width() != gridWidth)
+        {
+            released = GridBuffer<char>(gridWidth, gridHeight);
+        }
+        oldGrid.swap(released);
+    }
+
+    /* the grid let go of by releasePreviousGrid() */
+    GridView<char> releasedGrid() const
+    {
+        return released.view();
+    }
+
+    /* main update loop */
+    void update()
+    {
+        oldGrid.swap(newGrid);
+        int bands = pool != nullptr ? pool->size() : 1;
+        columnSums.resize((std::size_t)bands * gridWidth);
+        if(bands > 1)
+        {
+            pool->run([this](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, gridHeight, begin, end);
+                updateRows(begin, end, &columnSums[(std::size_t)band * gridWidth]);
+            });
+        }
+        else
+        {
+            updateRows(0, gridHeight, columnSums.data());
+        }
+        generations++;
+    }
+
+private:
+
+    /* where the rows and columns within the range beyond the edges come from */
+    void mapSources()
+    {
+        int r = rule.range;
+        rowSource.resize(gridHeight + 2*r + 2);
+        for(int i = 0; i<(int)rowSource.size(); i++)
+        {
+            rowSource[i] = haloSource(i - r - 1, gridHeight, boundary);
+        }
+        columnSource.resize(gridWidth + 2*r + 2);
+        for(int i = 0; i<(int)columnSource.size(); i++)
+        {
+            columnSource[i] = haloSource(i - r - 1, gridWidth, boundary);
+        }
+    }
+
+    /* source of row y, -range-1 <= y <= height+range; -1 for dead rows */
+    int sourceRow(int y) const
+    {
+        return y >= 0 && y < gridHeight ? y : rowSource[y + rule.range + 1];
+    }
+
+    /* add sign times the live cells of row y to the column sums */
+    void addRow(int y, int sign, int* sums) const
+    {
+        int source = sourceRow(y);
+        if(source < 0)
+        {
+            return;
+        }
+        const char* row = oldGrid.row(source);
+        for(int x = 0; x<gridWidth; x++)
+        {
+            sums[x] += sign * (row[x] == 1);
+        }
+    }
+
+    /* compute rows [begin, end) with sums as the column sums of the band */
+    void updateRows(int begin, int end, int* sums)
+    {
+        int r = rule.range;
+        std::fill(sums, sums + gridWidth, 0);
+        if(begin >= end)
+        {
+            return;
+        }
+        for(int y = begin - r; y<=begin + r; y++)
+        {
+            addRow(y, 1, sums);
+        }
+        for(int y = begin; y<end; y++)
+        {
+            updateRow(y, sums);
+            addRow(y + r + 1, 1, sums);
+            addRow(y - r, -1, sums);
+        }
+    }
+
+    /* column sum of column x, -range-1 <= x <= width+range */
+    int columnSum(const int* sums, int x) const
+    {
+        if(x >= 0 && x < gridWidth)
+        {
+            return sums[x];
+        }
+        int source = columnSource[x + rule.range + 1];
+        return source < 0 ? 0 : sums[source];
+    }
+
+    /* next state of row y, sums hold the column sums over its rows */
+    void updateRow(int y, const int* sums)
+    {
+        int r = rule.range;
+        const char* in = oldGrid.row(y);
+        char* out = newGrid.row(y);
+        int box = 0;
+        for(int x = -r; x<=r; x++)
+        {
+            box += columnSum(sums, x);
+        }
+        for(int x = 0; x<gridWidth; x++)
+        {
+            int count = box - (!rule.middle && in[x] == 1);
+            out[x] = (char)rule.next(in[x], count);
+            box += columnSum(sums, x + r + 1) - columnSum(sums, x - r);
+        }
+    }
+
+    GridBuffer<char> newGrid;
+    GridBuffer<char> oldGrid;
+    GridBuffer<char> released;          // of a past generation, empty until releasePreviousGrid()
+
+    int gridWidth, gridHeight;
+    LtlRule rule;
+    BoundaryPolicy boundary;
+    ThreadPool* pool;
+    std::vector<int> rowSource;         // haloSource() of row i-range-1
+    std::vector<int> columnSource;      // haloSource() of column i-range-1
+    std::vector<int> columnSums;        // live cells in the column over the box, per band
+    uint64_t generations;
+};
+
+#endif
@@ -0,0 +1,117 @@
+
+// Author: 	Stephan Meesters
+//
+// Read-only view of a whole file
+//
+// On POSIX systems the file is memory-mapped, so even files of gigabytes are
+// parsed straight from the page cache without being copied; elsewhere it is
+// read into memory once.
+//
+
+#ifndef CONWAY_MAPPEDFILE_H
+#define CONWAY_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define CONWAY_MMAP
+#endif
+
+/* the bytes of a file, mapped for as long as the object lives */
+class MappedFile
+{
+public:
+
+    MappedFile():data(nullptr), size(0){}
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    /* map a file, false if it cannot be read */
+    bool open(const char* path)
+    {
+        close();
+#ifdef CONWAY_MMAP
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (std::size_t)info.st_size;
+        if(size > 0)
+        {
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping == MAP_FAILED)
+            {
+                ::close(fd);
+                size = 0;
+                return false;
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+        }
+        ::close(fd);
+        return true;
+#else
+        FILE* file = fopen(path, "rb");
+        if(file == nullptr)
+        {
+            return false;
+        }
+        char chunk[1 << 16];
+        std::size_t n;
+        while((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            buffer.insert(buffer.end(), chunk, chunk + n);
+        }
+        fclose(file);
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+#endif
+    }
+
+    /* unmap the file */
+    void close()
+    {
+#ifdef CONWAY_MMAP
+        if(data != nullptr)
+        {
+            munmap(const_cast<char*>(data), size);
+        }
+#else
+        buffer.clear();
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+
+private:
+
+    const char* data;
+    std::size_t size;
+#ifndef CONWAY_MMAP
+    std::vector<char> buffer;
+#endif
+};
+
+#endif
@@ -0,0 +1,390 @@
+
+// Author: 	Stephan Meesters
+//
+// Low-overhead run metrics
+//
+// Metrics times the phases of the main loop (polling events, updating,
+// drawing and presenting) and counts cells. A ScopedTimer reads
+// steady_clock around a phase and records the time into the histogram of
+// that phase: log-linear buckets, eight per power of two nanoseconds, so a
+// quantile read back is within 1/8 of the time measured. Every phase is
+// recorded by one thread only, the one that runs it, so a count is bumped
+// with a relaxed load and store instead of a locked add; the thread that
+// reports reads the counts without stopping the others.
+//
+// At every report the quantiles are taken over the counts since the last
+// report, so p50 and p99 follow the run instead of its whole history. A
+// report is appended to a log as one JSON object per line, and written in
+// the Prometheus text format to a file that is replaced every time, as the
+// node_exporter textfile collector expects.
+//
+// Population, births and deaths are sampled once per report: the thread
+// that steps the process packs a generation before its next update and
+// compares the two afterwards.
+//
+
+#ifndef CONWAY_METRICS_H
+#define CONWAY_METRICS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "snapshot.h"
+
+#define METRICS_SUB_BUCKETS 8                       // buckets per power of two
+#define METRICS_BUCKETS (64 * METRICS_SUB_BUCKETS)
+#define METRICS_INTERVAL_DEFAULT 1000               // milliseconds between reports
+#define METRICS_PATH_MAX 4096                       // longest path of the Prometheus file
+
+/* timed phases of the main loop */
+enum MetricPhase
+{
+    PHASE_EVENTS,
+    PHASE_UPDATE,
+    PHASE_DRAW,
+    PHASE_PRESENT,
+    PHASE_COUNT
+};
+
+inline const char* phaseName(int phase)
+{
+    static const char* names[PHASE_COUNT] = {"events", "update", "draw", "present"};
+    return names[phase];
+}
+
+/* histogram of times in nanoseconds, written by one thread and read by any */
+class LatencyHistogram
+{
+public:
+
+    LatencyHistogram()
+    {
+        for(std::atomic<uint64_t>& count: counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /* count a time, only ever from the same thread */
+    void record(uint64_t nanoseconds)
+    {
+        std::atomic<uint64_t>& count = counts[bucket(nanoseconds)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /* copy the counts of every bucket */
+    void read(uint64_t* out) const
+    {
+        for(int i = 0; i<METRICS_BUCKETS; i++)
+        {
+            out[i] = counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    /* bucket of a time: exact below METRICS_SUB_BUCKETS, then the power of
+       two and the next three bits */
+    static int bucket(uint64_t nanoseconds)
+    {
+        if(nanoseconds < METRICS_SUB_BUCKETS)
+        {
+            return (int)nanoseconds;
+        }
+        int top = 63 - __builtin_clzll(nanoseconds);
+        return (top - 2) * METRICS_SUB_BUCKETS + (int)((nanoseconds >> (top - 3)) & (METRICS_SUB_BUCKETS - 1));
+    }
+
+    /* time in the middle of a bucket */
+    static double value(int bucket)
+    {
+        if(bucket < METRICS_SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        int top = bucket / METRICS_SUB_BUCKETS + 2;
+        double width = std::ldexp(1.0, top - 3);
+        return (METRICS_SUB_BUCKETS + bucket % METRICS_SUB_BUCKETS) * width + width / 2;
+    }
+
+    /* time below which a fraction q of the counts lie, 0 without counts */
+    static double quantile(const uint64_t* counts, double q)
+    {
+        uint64_t total = 0;
+        for(int i = 0; i<METRICS_BUCKETS; i++)
+        {
+            total += counts[i];
+        }
+        if(total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)std::ceil(q * total), seen = 0;
+        for(int i = 0; i<METRICS_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if(seen >= std::max<uint64_t>(rank, 1))
+            {
+                return value(i);
+            }
+        }
+        return value(METRICS_BUCKETS - 1);
+    }
+
+private:
+
+    std::atomic<uint64_t> counts[METRICS_BUCKETS];
+};
+
+/* what one report found, times in seconds */
+struct MetricsReport
+{
+    double time;                    // since the run started
+    uint64_t generation;
+    uint64_t population, births, deaths;    // over the last sampled update
+    double cellsPerSecond;          // over the interval
+    double generationsPerSecond;
+    uint64_t count[PHASE_COUNT];    // phases timed over the interval
+    uint64_t total[PHASE_COUNT];    // phases timed since the start
+    double p50[PHASE_COUNT], p99[PHASE_COUNT];
+};
+
+/* timers and counters of a run */
+class Metrics
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    /* constructor, for a grid of cells cells and a report every interval milliseconds */
+    Metrics(double cells, int interval = METRICS_INTERVAL_DEFAULT):cells(cells), interval(interval),
+        start(Clock::now()), lastReport(start), lastGeneration(0), generation(0), population(0),
+        births(0), deaths(0), sampleWanted(true)
+    {
+        std::fill(lastCounts[0], lastCounts[0] + PHASE_COUNT * METRICS_BUCKETS, 0);
+    }
+
+    /* record the time of a phase, always from the thread that runs it */
+    void record(MetricPhase phase, uint64_t nanoseconds)
+    {
+        histograms[phase].record(nanoseconds);
+    }
+
+    /* the stepping thread: the generation it reached */
+    void setGeneration(uint64_t value)
+    {
+        generation.store(value, std::memory_order_relaxed);
+    }
+
+    /* the stepping thread: true once per report, sample the cells around the next update */
+    bool sampleDue()
+    {
+        return sampleWanted.load(std::memory_order_relaxed) && sampleWanted.exchange(false);
+    }
+
+    /* the stepping thread: the cells it sampled */
+    void setCells(uint64_t live, uint64_t born, uint64_t died)
+    {
+        population.store(live, std::memory_order_relaxed);
+        births.store(born, std::memory_order_relaxed);
+        deaths.store(died, std::memory_order_relaxed);
+    }
+
+    /* the reporting thread: is the next report due */
+    bool reportDue() const
+    {
+        return Clock::now() - lastReport >= std::chrono::milliseconds(interval);
+    }
+
+    /* the reporting thread: quantiles and rates since the last report */
+    MetricsReport report()
+    {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastReport).count();
+        MetricsReport report;
+        report.time = std::chrono::duration<double>(now - start).count();
+        report.generation = generation.load(std::memory_order_relaxed);
+        report.population = population.load(std::memory_order_relaxed);
+        report.births = births.load(std::memory_order_relaxed);
+        report.deaths = deaths.load(std::memory_order_relaxed);
+        report.generationsPerSecond = elapsed > 0 && report.generation >= lastGeneration ? (report.generation - lastGeneration) / elapsed : 0;
+        report.cellsPerSecond = report.generationsPerSecond * cells;
+        for(int phase = 0; phase<PHASE_COUNT; phase++)
+        {
+            uint64_t counts[METRICS_BUCKETS];
+            histograms[phase].read(counts);
+            report.count[phase] = report.total[phase] = 0;
+            for(int i = 0; i<METRICS_BUCKETS; i++)
+            {
+                uint64_t total = counts[i];
+                counts[i] -= lastCounts[phase][i];
+                lastCounts[phase][i] = total;
+                report.count[phase] += counts[i];
+                report.total[phase] += total;
+            }
+            report.p50[phase] = LatencyHistogram::quantile(counts, 0.5) * 1e-9;
+            report.p99[phase] = LatencyHistogram::quantile(counts, 0.99) * 1e-9;
+        }
+        lastReport = now;
+        lastGeneration = report.generation;
+        sampleWanted.store(true);
+        return report;
+    }
+
+private:
+
+    double cells;
+    int interval;
+    Clock::time_point start, lastReport;
+    uint64_t lastGeneration;
+    uint64_t lastCounts[PHASE_COUNT][METRICS_BUCKETS];   // at the last report
+    LatencyHistogram histograms[PHASE_COUNT];
+
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> population, births, deaths;
+    std::atomic<bool> sampleWanted;
+};
+
+/* time the scope into a phase */
+class ScopedTimer
+{
+public:
+
+    ScopedTimer(Metrics& metrics, MetricPhase phase):metrics(metrics), phase(phase), start(Metrics::Clock::now()){}
+
+    ~ScopedTimer()
+    {
+        metrics.record(phase, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Metrics::Clock::now() - start).count());
+    }
+
+    ScopedTimer(ScopedTimer const&) = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+private:
+
+    Metrics& metrics;
+    MetricPhase phase;
+    Metrics::Clock::time_point start;
+};
+
+/* population, births and deaths of one update, from the grid packed before it */
+class CellSampler
+{
+public:
+
+    /* size the buffers for a grid, before the first capture */
+    template <class View>
+    void prepare(const View& grid)
+    {
+        wordsPerRow = (grid.width() + 63) / 64;
+        before.resize((std::size_t)wordsPerRow * grid.height());
+        row.resize(wordsPerRow);
+    }
+
+    /* pack the generation before the update */
+    template <class View>
+    void capture(const View& grid)
+    {
+        prepare(grid);
+        for(int y = 0; y<grid.height(); y++)
+        {
+            packRow(grid, y, &before[(std::size_t)y * wordsPerRow]);
+        }
+    }
+
+    /* compare the generation after it */
+    template <class View>
+    void compare(const View& grid, uint64_t& population, uint64_t& births, uint64_t& deaths)
+    {
+        population = births = deaths = 0;
+        for(int y = 0; y<grid.height(); y++)
+        {
+            packRow(grid, y, row.data());
+            const uint64_t* old = &before[(std::size_t)y * wordsPerRow];
+            for(int i = 0; i<wordsPerRow; i++)
+            {
+                population += __builtin_popcountll(row[i]);
+                births += __builtin_popcountll(row[i] & ~old[i]);
+                deaths += __builtin_popcountll(old[i] & ~row[i]);
+            }
+        }
+    }
+
+private:
+
+    int wordsPerRow;
+    std::vector<uint64_t> before;
+    std::vector<uint64_t> row;
+};
+
+/* append a report to a log as a line of JSON */
+inline void writeJsonLine(const MetricsReport& report, FILE* file)
+{
+    fprintf(file, "{\"time\":%.3f,\"generation\":%llu,\"population\":%llu,\"births\":%llu,\"deaths\":%llu,"
+                  "\"generations_per_second\":%.3f,\"cells_per_second\":%.6e",
+            report.time, (unsigned long long)report.generation, (unsigned long long)report.population,
+            (unsigned long long)report.births, (unsigned long long)report.deaths,
+            report.generationsPerSecond, report.cellsPerSecond);
+    for(int phase = 0; phase<PHASE_COUNT; phase++)
+    {
+        fprintf(file, ",\"%s\":{\"count\":%llu,\"p50\":%.9f,\"p99\":%.9f}", phaseName(phase),
+                (unsigned long long)report.count[phase], report.p50[phase], report.p99[phase]);
+    }
+    fprintf(file, "}\n");
+    fflush(file);
+}
+
+/* replace a file with a report in the Prometheus text format, false with the
+   reason if it could not be written */
+inline bool writePrometheus(const MetricsReport& report, const char* path, std::string& error)
+{
+    char temporary[METRICS_PATH_MAX];
+    if(snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary))
+    {
+        error = std::string("path too long: ") + path;
+        return false;
+    }
+    FILE* file = fopen(temporary, "w");
+    if(file == nullptr)
+    {
+        error = std::string("cannot create ") + temporary;
+        return false;
+    }
+    fprintf(file, "# TYPE conway_generation counter\nconway_generation %llu\n", (unsigned long long)report.generation);
+    fprintf(file, "# TYPE conway_population gauge\nconway_population %llu\n", (unsigned long long)report.population);
+    fprintf(file, "# TYPE conway_births gauge\nconway_births %llu\n", (unsigned long long)report.births);
+    fprintf(file, "# TYPE conway_deaths gauge\nconway_deaths %llu\n", (unsigned long long)report.deaths);
+    fprintf(file, "# TYPE conway_cells_per_second gauge\nconway_cells_per_second %.6e\n", report.cellsPerSecond);
+    const char* types[3] = {"# TYPE conway_phase_p50_seconds gauge", "# TYPE conway_phase_p99_seconds gauge", "# TYPE conway_phase_total counter"};
+    for(int metric = 0; metric<3; metric++)
+    {
+        fprintf(file, "%s\n", types[metric]);
+        for(int phase = 0; phase<PHASE_COUNT; phase++)
+        {
+            if(metric < 2)
+            {
+                fprintf(file, "conway_phase_p%s_seconds{phase=\"%s\"} %.9f\n", metric == 0 ? "50" : "99", phaseName(phase),
+                        metric == 0 ? report.p50[phase] : report.p99[phase]);
+            }
+            else
+            {
+                fprintf(file, "conway_phase_total{phase=\"%s\"} %llu\n", phaseName(phase), (unsigned long long)report.total[phase]);
+            }
+        }
+    }
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+    if(!written || std::rename(temporary, path) != 0)
+    {
+        std::remove(temporary);
+        error = std::string("cannot write ") + path;
+        return false;
+    }
+    return true;
+}
+
+#endif
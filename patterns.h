@@ -0,0 +1,658 @@
+
+// Author: 	Stephan Meesters
+//
+// Loaders for Game of Life pattern files
+//
+// Supported are RLE, plaintext (.cells), Life 1.06 and, for HashLife, Golly
+// macrocell files. A file is memory-mapped and parsed in place: the parsers
+// walk the bytes once and hand every live cell to a sink that sets it in the
+// process, so no line or token is ever copied into a string. Macrocell files
+// describe a quadtree and are built node by node with the HashLife hash-cons
+// table, which loads patterns of far more cells than fit in any grid.
+//
+// Patterns other than macrocells are centred in the window at the origin;
+// cells that fall outside a bounded grid are left out, and so are never
+// visited: a run of live cells in an RLE file is clipped to the grid before
+// its cells are set. The unbounded planes still only reach so far from the
+// origin, and a pattern that does not fit in them fails to load. Files are
+// not trusted: numbers beyond 64 bits and patterns wider than 2^63 cells
+// are rejected, and the centring offset is never taken in a signed type
+// it could overflow.
+//
+
+#ifndef CONWAY_PATTERNS_H
+#define CONWAY_PATTERNS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "mappedfile.h"
+#include "sparse.h"
+#include "hashlife.h"
+
+#define PATTERN_MAX_RUN INT32_MAX   // longest run of cells in an RLE file
+
+/* pattern file formats */
+enum PatternFormat
+{
+    PATTERN_RLE,
+    PATTERN_PLAINTEXT,
+    PATTERN_LIFE106,
+    PATTERN_MACROCELL
+};
+
+/* does the text at p start with a prefix */
+inline bool startsWith(const char* p, const char* end, const char* prefix)
+{
+    std::size_t n = strlen(prefix);
+    return (std::size_t)(end - p) >= n && memcmp(p, prefix, n) == 0;
+}
+
+/* does a path end with an extension, ignoring case */
+inline bool hasExtension(const char* path, const char* extension)
+{
+    std::size_t n = strlen(path), m = strlen(extension);
+    if(n < m)
+    {
+        return false;
+    }
+    for(std::size_t i = 0; i<m; i++)
+    {
+        char c = path[n-m+i];
+        if((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != extension[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* format of a file from its header, or else its extension; RLE by default */
+inline PatternFormat detectPatternFormat(const char* path, const char* begin, const char* end)
+{
+    if(startsWith(begin, end, "[M2]"))
+    {
+        return PATTERN_MACROCELL;
+    }
+    if(startsWith(begin, end, "#Life 1.06"))
+    {
+        return PATTERN_LIFE106;
+    }
+    if(hasExtension(path, ".mc"))
+    {
+        return PATTERN_MACROCELL;
+    }
+    if(hasExtension(path, ".cells") || startsWith(begin, end, "!"))
+    {
+        return PATTERN_PLAINTEXT;
+    }
+    if(hasExtension(path, ".lif") || hasExtension(path, ".life"))
+    {
+        return PATTERN_LIFE106;
+    }
+    return PATTERN_RLE;
+}
+
+/* move past the end of the current line */
+inline void skipLine(const char*& p, const char* end)
+{
+    while(p < end && *p != '\n')
+    {
+        p++;
+    }
+    if(p < end)
+    {
+        p++;
+    }
+}
+
+/* skip spaces and tabs */
+inline void skipBlanks(const char*& p, const char* end)
+{
+    while(p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+}
+
+/* read a decimal integer with an optional sign, false if there is none, and
+   with a message if it does not fit in an int64_t */
+inline bool parseInteger(const char*& p, const char* end, int64_t& value, std::string& error)
+{
+    skipBlanks(p, end);
+    bool negative = p < end && *p == '-';
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    if(p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    uint64_t limit = negative ? uint64_t(1) << 63 : uint64_t(std::numeric_limits<int64_t>::max());
+    uint64_t v = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        unsigned digit = *p - '0';
+        if(v > (limit - digit) / 10)
+        {
+            error = "number too large";
+            return false;
+        }
+        v = v*10 + digit;
+    }
+    value = negative && v > 0 ? -int64_t(v - 1) - 1 : int64_t(v);
+    return true;
+}
+
+/* is the rest of the line blank */
+inline bool atLineEnd(const char* p, const char* end)
+{
+    skipBlanks(p, end);
+    return p == end || *p == '\n' || *p == '\r';
+}
+
+/* live cells of an RLE file, relative to its top-left corner; a run of live
+   cells is handed to the sink at once */
+template <class Sink>
+bool parseRLE(const char* p, const char* end, Sink& sink, std::string& error)
+{
+    // comment lines and the header line
+    while(p < end && (*p == '#' || *p == 'x' || *p == '\n' || *p == '\r'))
+    {
+        skipLine(p, end);
+    }
+
+    int64_t x = 0, y = 0, count = 0;
+    for(; p < end; p++)
+    {
+        char c = *p;
+        if(c >= '0' && c <= '9')
+        {
+            count = count*10 + (c - '0');
+            if(count > PATTERN_MAX_RUN)
+            {
+                error = "run count above " + std::to_string(PATTERN_MAX_RUN) + " in RLE data";
+                return false;
+            }
+            continue;
+        }
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || (c >= 'p' && c <= 'y'))
+        {
+            // white space, or the prefix of a multi-state cell
+            continue;
+        }
+
+        int64_t run = count > 0 ? count : 1;
+        count = 0;
+        if((c == '$' ? y : x) > std::numeric_limits<int64_t>::max() - run)
+        {
+            error = "pattern wider than 2^63 cells";
+            return false;
+        }
+        if(c == 'b' || c == '.')
+        {
+            x += run;
+        }
+        else if(c == 'o' || (c >= 'A' && c <= 'X'))
+        {
+            sink.run(x, y, run);
+            x += run;
+        }
+        else if(c == '$')
+        {
+            y += run;
+            x = 0;
+        }
+        else if(c == '!')
+        {
+            return true;
+        }
+        else if(c == '#')
+        {
+            skipLine(p, end);
+            p--;
+        }
+        else
+        {
+            error = std::string("unexpected character '") + c + "' in RLE data";
+            return false;
+        }
+    }
+    return true;
+}
+
+/* size from the header line of an RLE file, false if it has none, and with
+   a message if its size is out of range */
+inline bool parseRLEHeader(const char* p, const char* end, int64_t& width, int64_t& height, std::string& error)
+{
+    while(p < end && *p == '#')
+    {
+        skipLine(p, end);
+    }
+    if(p == end || *p != 'x')
+    {
+        return false;
+    }
+    p++;
+    skipBlanks(p, end);
+    if(p == end || *p++ != '=' || !parseInteger(p, end, width, error))
+    {
+        return false;
+    }
+    skipBlanks(p, end);
+    if(p == end || *p++ != ',')
+    {
+        return false;
+    }
+    skipBlanks(p, end);
+    if(p == end || *p++ != 'y')
+    {
+        return false;
+    }
+    skipBlanks(p, end);
+    if(p == end || *p++ != '=' || !parseInteger(p, end, height, error))
+    {
+        return false;
+    }
+    if(width < 0 || height < 0)
+    {
+        error = "negative size in the RLE header";
+        return false;
+    }
+    return true;
+}
+
+/* live cells of a plaintext file, relative to its top-left corner */
+template <class Sink>
+bool parsePlaintext(const char* p, const char* end, Sink& sink, std::string& error)
+{
+    int64_t y = 0;
+    while(p < end)
+    {
+        if(*p == '!')
+        {
+            skipLine(p, end);
+            continue;
+        }
+        for(int64_t x = 0; p < end && *p != '\n'; p++)
+        {
+            if(*p == 'O' || *p == '*')
+            {
+                sink(x++, y);
+            }
+            else if(*p == '.')
+            {
+                x++;
+            }
+            else if(*p != '\r' && *p != ' ' && *p != '\t')
+            {
+                error = std::string("unexpected character '") + *p + "' in plaintext data";
+                return false;
+            }
+        }
+        skipLine(p, end);
+        y++;
+    }
+    return true;
+}
+
+/* live cells of a Life 1.06 file, in its own coordinates */
+template <class Sink>
+bool parseLife106(const char* p, const char* end, Sink& sink, std::string& error)
+{
+    while(p < end)
+    {
+        if(*p == '#' || atLineEnd(p, end))
+        {
+            skipLine(p, end);
+            continue;
+        }
+        int64_t x, y;
+        if(!parseInteger(p, end, x, error) || !parseInteger(p, end, y, error) || !atLineEnd(p, end))
+        {
+            if(error.empty())
+            {
+                error = "expected two coordinates per line in Life 1.06 data";
+            }
+            return false;
+        }
+        sink(x, y);
+        skipLine(p, end);
+    }
+    return true;
+}
+
+/* live cells of a file that is not a macrocell */
+template <class Sink>
+bool parseCells(PatternFormat format, const char* begin, const char* end, Sink& sink, std::string& error)
+{
+    switch(format)
+    {
+        case PATTERN_RLE:
+            return parseRLE(begin, end, sink, error);
+        case PATTERN_PLAINTEXT:
+            return parsePlaintext(begin, end, sink, error);
+        case PATTERN_LIFE106:
+            return parseLife106(begin, end, sink, error);
+        case PATTERN_MACROCELL:
+            break;
+    }
+    error = "not a cell list format";
+    return false;
+}
+
+/* sink that records the bounding box of the cells */
+struct PatternBounds
+{
+    PatternBounds():minX(std::numeric_limits<int64_t>::max()), minY(std::numeric_limits<int64_t>::max()),
+        maxX(std::numeric_limits<int64_t>::min()), maxY(std::numeric_limits<int64_t>::min()){}
+
+    void operator()(int64_t x, int64_t y)
+    {
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+
+    /* n cells from (x, y) on, of which only the ends count */
+    void run(int64_t x, int64_t y, int64_t n)
+    {
+        (*this)(x, y);
+        (*this)(x + n - 1, y);
+    }
+
+    bool empty() const { return minX > maxX; }
+
+    int64_t minX, minY, maxX, maxY;
+};
+
+/* cells a process can hold, the corners inclusive */
+struct PatternWindow
+{
+    int64_t minX, minY, maxX, maxY;
+    bool bounded;       // a grid, whose pattern is cut off at the edges; else a plane the pattern must fit in
+};
+
+/* a bounded process holds its width x height grid */
+template <class Process>
+PatternWindow patternWindow(const Process&, int width, int height)
+{
+    return PatternWindow{0, 0, (int64_t)width - 1, (int64_t)height - 1, true};
+}
+
+/* the sparse plane reaches as far as 64-bit coordinates */
+inline PatternWindow patternWindow(const SparseLife&, int, int)
+{
+    return PatternWindow{std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min(),
+                         std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max(), false};
+}
+
+/* HashLife holds the plane within 2^(HASHLIFE_MAX_LEVEL-1) of the origin */
+inline PatternWindow patternWindow(const HashLife&, int, int)
+{
+    const int64_t limit = int64_t(1) << (HASHLIFE_MAX_LEVEL-1);
+    return PatternWindow{-limit, -limit, limit - 1, limit - 1, false};
+}
+
+/* sink that sets the cells in a process, moved so that the corner (originX,
+   originY) of the pattern lands on (baseX, baseY); the offset between them
+   may not fit in 64 bits, so a cell is moved by its distance from the corner */
+template <class Process>
+struct ProcessSink
+{
+    ProcessSink(Process& process, int64_t originX, int64_t originY, int64_t baseX, int64_t baseY,
+                const PatternWindow& window):
+        process(process), originX(originX), originY(originY), baseX(baseX), baseY(baseY), window(window),
+        beyond(false){}
+
+    void operator()(int64_t x, int64_t y)
+    {
+        if(!move(x, originX, baseX, x) || !move(y, originY, baseY, y) ||
+           x < window.minX || x > window.maxX || y < window.minY || y > window.maxY)
+        {
+            beyond = beyond || !window.bounded;
+            return;
+        }
+        process.setCell(x, y, true);
+    }
+
+    /* n cells from (x, y) on, only those in the window are set */
+    void run(int64_t x, int64_t y, int64_t n)
+    {
+        if(!move(x, originX, baseX, x) || !move(y, originY, baseY, y) ||
+           x > window.maxX || y < window.minY || y > window.maxY)
+        {
+            beyond = beyond || !window.bounded;
+            return;
+        }
+
+        // clip the run to the window, in distances that do not overflow
+        bool clipped = false;
+        if(x < window.minX)
+        {
+            uint64_t skipped = uint64_t(window.minX) - uint64_t(x);
+            clipped = true;
+            if(skipped >= uint64_t(n))
+            {
+                beyond = beyond || !window.bounded;
+                return;
+            }
+            x = window.minX;
+            n -= (int64_t)skipped;
+        }
+        if(uint64_t(n - 1) > uint64_t(window.maxX) - uint64_t(x))
+        {
+            n = (int64_t)(uint64_t(window.maxX) - uint64_t(x)) + 1;
+            clipped = true;
+        }
+        beyond = beyond || (clipped && !window.bounded);
+        for(int64_t i = 0; i<n; i++)
+        {
+            process.setCell(x + i, y, true);
+        }
+    }
+
+    /* coordinate v of the pattern moved from origin to base, false if it
+       falls outside the 64-bit range */
+    static bool move(int64_t v, int64_t origin, int64_t base, int64_t& moved)
+    {
+        uint64_t distance = uint64_t(v) - uint64_t(origin);
+        if(v < origin || distance > uint64_t(std::numeric_limits<int64_t>::max() - std::max<int64_t>(base, 0)))
+        {
+            return false;
+        }
+        moved = base + (int64_t)distance;
+        return true;
+    }
+
+    Process& process;
+    int64_t originX, originY;       // top-left corner of the pattern
+    int64_t baseX, baseY;           // where it is placed
+    PatternWindow window;
+    bool beyond;        // a cell fell outside the plane of an unbounded process
+};
+
+/* where the first of span+1 cells goes to centre them in size cells at 0,
+   for span <= INT64_MAX */
+inline int64_t centredBase(uint64_t span, int64_t size)
+{
+    uint64_t cells = span + 1;
+    return uint64_t(size) >= cells ? (int64_t)((uint64_t(size) - cells) / 2) : -(int64_t)((cells - uint64_t(size)) / 2);
+}
+
+/* HashLife node of a macrocell leaf, 8x8 cells with cell (x, y) in bit y*8 + x */
+inline HashLife::Node* macrocellLeaf(HashLife& life, uint64_t bits, int level, int x0, int y0)
+{
+    if(level == 0)
+    {
+        return life.makeCell((bits >> (y0*8 + x0)) & 1);
+    }
+    int half = 1 << (level-1);
+    return life.makeNode(macrocellLeaf(life, bits, level-1, x0, y0), macrocellLeaf(life, bits, level-1, x0+half, y0),
+                         macrocellLeaf(life, bits, level-1, x0, y0+half), macrocellLeaf(life, bits, level-1, x0+half, y0+half));
+}
+
+/* build the universe of a macrocell file, only for HashLife */
+inline bool loadMacrocell(HashLife& life, const char* p, const char* end, std::string& error)
+{
+    if(!startsWith(p, end, "[M2]"))
+    {
+        error = "missing [M2] header";
+        return false;
+    }
+    skipLine(p, end);
+
+    // node i is defined on the i-th line that is not a comment, 0 is empty
+    std::vector<HashLife::Node*> nodes(1, nullptr);
+    while(p < end)
+    {
+        if(*p == '#' || atLineEnd(p, end))
+        {
+            skipLine(p, end);
+            continue;
+        }
+        if(*p == '.' || *p == '*' || *p == '$')
+        {
+            // 8x8 leaf, rows end with $
+            uint64_t bits = 0;
+            int x = 0, y = 0;
+            for(; p < end && *p != '\n' && *p != '\r'; p++)
+            {
+                if(*p == '$')
+                {
+                    x = 0;
+                    y++;
+                }
+                else if(x < 8 && y < 8)
+                {
+                    bits |= uint64_t(*p == '*') << (y*8 + x);
+                    x++;
+                }
+            }
+            nodes.push_back(macrocellLeaf(life, bits, 3, 0, 0));
+        }
+        else
+        {
+            int64_t level, index[4];
+            if(!parseInteger(p, end, level, error) || level < 4 || level > 62)
+            {
+                if(error.empty())
+                {
+                    error = "bad node level, only two-state macrocells with 8x8 leaves are supported";
+                }
+                return false;
+            }
+            HashLife::Node* children[4];
+            for(int i = 0; i<4; i++)
+            {
+                if(!parseInteger(p, end, index[i], error) || index[i] < 0 || index[i] >= (int64_t)nodes.size())
+                {
+                    if(error.empty())
+                    {
+                        error = "node refers to a node not defined before it";
+                    }
+                    return false;
+                }
+                children[i] = index[i] == 0 ? life.makeEmpty((int)level-1) : nodes[index[i]];
+                if(children[i]->level != level-1)
+                {
+                    error = "child node of the wrong level";
+                    return false;
+                }
+            }
+            nodes.push_back(life.makeNode(children[0], children[1], children[2], children[3]));
+        }
+        skipLine(p, end);
+    }
+    if(nodes.size() < 2)
+    {
+        error = "no nodes";
+        return false;
+    }
+    if(!life.setRoot(nodes.back()))
+    {
+        error = "pattern wider than 2^62 cells";
+        return false;
+    }
+    return true;
+}
+
+/* macrocells need the HashLife process */
+template <class Process>
+bool loadMacrocell(Process&, const char*, const char*, std::string& error)
+{
+    error = "macrocell files need --engine hashlife";
+    return false;
+}
+
+/* replace the cells of a process by a pattern file, with the pattern
+   centred in the width x height window at the origin */
+template <class Process>
+bool loadPattern(const char* path, Process& process, int width, int height, std::string& error)
+{
+    MappedFile file;
+    if(!file.open(path))
+    {
+        error = "cannot read the file";
+        return false;
+    }
+    PatternFormat format = detectPatternFormat(path, file.begin(), file.end());
+    process.clear();
+    if(format == PATTERN_MACROCELL)
+    {
+        return loadMacrocell(process, file.begin(), file.end(), error);
+    }
+
+    // the size comes from the RLE header, or else from a first pass
+    PatternBounds bounds;
+    int64_t patternWidth, patternHeight;
+    if(format == PATTERN_RLE && parseRLEHeader(file.begin(), file.end(), patternWidth, patternHeight, error))
+    {
+        bounds.minX = bounds.minY = 0;
+        bounds.maxX = patternWidth - 1;
+        bounds.maxY = patternHeight - 1;
+    }
+    else if(!error.empty() || !parseCells(format, file.begin(), file.end(), bounds, error))
+    {
+        return false;
+    }
+    if(bounds.empty())
+    {
+        return true;
+    }
+
+    // a pattern wider than the plane cannot be placed, nor one whose centre
+    // is out of 64-bit range; the spans are unsigned, as they may not fit an int64_t
+    PatternWindow window = patternWindow(process, width, height);
+    uint64_t spanX = uint64_t(bounds.maxX) - uint64_t(bounds.minX), spanY = uint64_t(bounds.maxY) - uint64_t(bounds.minY);
+    if(spanX > uint64_t(std::numeric_limits<int64_t>::max()) || spanY > uint64_t(std::numeric_limits<int64_t>::max()))
+    {
+        error = "pattern wider than 2^63 cells";
+        return false;
+    }
+    if(!window.bounded && (spanX > uint64_t(window.maxX) - uint64_t(window.minX) ||
+                           spanY > uint64_t(window.maxY) - uint64_t(window.minY)))
+    {
+        error = "pattern wider than the plane of the engine, " + std::to_string(window.maxX) + " cells from the origin";
+        return false;
+    }
+    ProcessSink<Process> sink(process, bounds.minX, bounds.minY, centredBase(spanX, width), centredBase(spanY, height), window);
+    if(!parseCells(format, file.begin(), file.end(), sink, error))
+    {
+        return false;
+    }
+    if(sink.beyond)
+    {
+        error = "pattern reaches beyond the plane of the engine, " + std::to_string(window.maxX) + " cells from the origin";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,99 @@
+
+// Author: 	Stephan Meesters
+//
+// Conversion of grid rows to 32-bit pixels
+//
+// The renderer writes the grid straight into a texture at one pixel per
+// cell. A live cell becomes the alive colour and any other cell the dead
+// colour, in one pass over the row without branches: byte cells 16 at a time
+// with SSE2 or NEON compares and unpacks, bit-packed cells a bit at a time
+// from their words.
+//
+
+#ifndef CONWAY_PIXELS_H
+#define CONWAY_PIXELS_H
+
+#include <cstdint>
+
+#include "grid.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CONWAY_PIXELS_SSE2
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define CONWAY_PIXELS_NEON
+#endif
+
+/* cells [begin, end) of row y of any view to out[0, end-begin) */
+template <class View>
+void rowToPixels(const View& grid, int y, int begin, int end, uint32_t* out, uint32_t alive, uint32_t dead)
+{
+    uint32_t diff = alive ^ dead;
+    for(int x = begin; x<end; x++)
+    {
+        uint32_t mask = -(uint32_t)(grid(x,y) == 1);
+        out[x-begin] = dead ^ (mask & diff);
+    }
+}
+
+/* byte cells, 16 per step */
+inline void rowToPixels(const GridView<char>& grid, int y, int begin, int end, uint32_t* out, uint32_t alive, uint32_t dead)
+{
+    const char* cells = grid.row(y);
+    int x = begin;
+#if defined(CONWAY_PIXELS_SSE2)
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i deadv = _mm_set1_epi32((int)dead);
+    const __m128i diffv = _mm_set1_epi32((int)(alive ^ dead));
+    for(; x+16 <= end; x += 16)
+    {
+        // widen the 0x00/0xff byte masks to 32 bits
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells+x)), one);
+        __m128i lo = _mm_unpacklo_epi8(c, c);
+        __m128i hi = _mm_unpackhi_epi8(c, c);
+        __m128i* p = (__m128i*)(out + x - begin);
+        _mm_storeu_si128(p,   _mm_xor_si128(deadv, _mm_and_si128(_mm_unpacklo_epi16(lo, lo), diffv)));
+        _mm_storeu_si128(p+1, _mm_xor_si128(deadv, _mm_and_si128(_mm_unpackhi_epi16(lo, lo), diffv)));
+        _mm_storeu_si128(p+2, _mm_xor_si128(deadv, _mm_and_si128(_mm_unpacklo_epi16(hi, hi), diffv)));
+        _mm_storeu_si128(p+3, _mm_xor_si128(deadv, _mm_and_si128(_mm_unpackhi_epi16(hi, hi), diffv)));
+    }
+#elif defined(CONWAY_PIXELS_NEON)
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint32x4_t deadv = vdupq_n_u32(dead);
+    const uint32x4_t diffv = vdupq_n_u32(alive ^ dead);
+    for(; x+16 <= end; x += 16)
+    {
+        // widen the 0x00/0xff byte masks to 32 bits
+        uint8x16_t c = vceqq_u8(vld1q_u8((const uint8_t*)(cells+x)), one);
+        uint8x16x2_t c16 = vzipq_u8(c, c);
+        uint16x8x2_t lo = vzipq_u16(vreinterpretq_u16_u8(c16.val[0]), vreinterpretq_u16_u8(c16.val[0]));
+        uint16x8x2_t hi = vzipq_u16(vreinterpretq_u16_u8(c16.val[1]), vreinterpretq_u16_u8(c16.val[1]));
+        uint32_t* p = out + x - begin;
+        vst1q_u32(p,    veorq_u32(deadv, vandq_u32(vreinterpretq_u32_u16(lo.val[0]), diffv)));
+        vst1q_u32(p+4,  veorq_u32(deadv, vandq_u32(vreinterpretq_u32_u16(lo.val[1]), diffv)));
+        vst1q_u32(p+8,  veorq_u32(deadv, vandq_u32(vreinterpretq_u32_u16(hi.val[0]), diffv)));
+        vst1q_u32(p+12, veorq_u32(deadv, vandq_u32(vreinterpretq_u32_u16(hi.val[1]), diffv)));
+    }
+#endif
+    uint32_t diff = alive ^ dead;
+    for(; x<end; x++)
+    {
+        uint32_t mask = -(uint32_t)(cells[x] == 1);
+        out[x-begin] = dead ^ (mask & diff);
+    }
+}
+
+/* bit-packed cells */
+inline void rowToPixels(const BitGridView& grid, int y, int begin, int end, uint32_t* out, uint32_t alive, uint32_t dead)
+{
+    const uint64_t* words = grid.row(y);
+    uint32_t diff = alive ^ dead;
+    for(int x = begin; x<end; x++)
+    {
+        uint32_t mask = -(uint32_t)((words[x >> 6] >> (x & 63)) & 1);
+        out[x-begin] = dead ^ (mask & diff);
+    }
+}
+
+#endif
@@ -0,0 +1,172 @@
+
+// Author: 	Stephan Meesters
+//
+// Density pyramid of a grid, for drawing boards larger than the window
+//
+// Level k of the pyramid holds a byte per block of 2^k x 2^k cells, the
+// fraction of live cells in it from 0 to 255, like the levels of a mipmap.
+// Levels start at PYRAMID_BASE_LEVEL, whose blocks are counted from the
+// cells, and every level above averages four blocks of the one below it, up
+// to a single block for the whole grid. The levels take a third of a byte per
+// block of the base level, a twelfth of a byte per cell.
+//
+// A zoomed-out view draws from the level whose blocks are just smaller than
+// a pixel, so it reads about as many blocks as there are pixels, whatever
+// the size of the grid. The pyramid is updated a rectangle of cells at a
+// time: only the blocks inside it and the blocks above them are recomputed,
+// so a process that lists the tiles that changed costs only those tiles.
+//
+
+#ifndef CONWAY_PYRAMID_H
+#define CONWAY_PYRAMID_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+
+#define PYRAMID_BASE_LEVEL 2    // log2 of the side of the smallest block
+
+/* live cells among cells [x, x+n) of row y, n at most 64 */
+template <class View>
+int countCells(const View& grid, int x, int n, int y)
+{
+    int count = 0;
+    for(int i = 0; i<n; i++)
+    {
+        count += grid(x+i, y) == 1;
+    }
+    return count;
+}
+
+/* bit-packed cells, the blocks never straddle a word */
+inline int countCells(const BitGridView& grid, int x, int n, int y)
+{
+    uint64_t bits = grid.row(y)[x >> 6] >> (x & 63);
+    return __builtin_popcountll(n < 64 ? bits & ((uint64_t(1) << n) - 1) : bits);
+}
+
+/* fractions of live cells of the blocks of a grid, by level */
+class DensityPyramid
+{
+public:
+
+    DensityPyramid():gridWidth(0), gridHeight(0){}
+
+    /* size the levels for a grid, every block is dead until updated */
+    void resize(int width, int height)
+    {
+        if(width == gridWidth && height == gridHeight)
+        {
+            return;
+        }
+        gridWidth = width;
+        gridHeight = height;
+        levels.clear();
+        for(int k = PYRAMID_BASE_LEVEL; ; k++)
+        {
+            Level level;
+            level.width = (int)(((long long)width + (1ll << k) - 1) >> k);
+            level.height = (int)(((long long)height + (1ll << k) - 1) >> k);
+            level.blocks.assign((std::size_t)level.width * level.height, 0);
+            levels.push_back(level);
+            if(level.width <= 1 && level.height <= 1)
+            {
+                break;
+            }
+        }
+    }
+
+    /* highest level, one block for the whole grid */
+    int topLevel() const
+    {
+        return PYRAMID_BASE_LEVEL + (int)levels.size() - 1;
+    }
+
+    /* blocks of a level in either direction */
+    int levelWidth(int k) const { return levels[k - PYRAMID_BASE_LEVEL].width; }
+    int levelHeight(int k) const { return levels[k - PYRAMID_BASE_LEVEL].height; }
+
+    /* fraction of live cells of block (x, y) of level k, 0 to 255 */
+    uint8_t density(int k, int x, int y) const
+    {
+        const Level& level = levels[k - PYRAMID_BASE_LEVEL];
+        return level.blocks[(std::size_t)y * level.width + x];
+    }
+
+    /* recount the blocks over cells [x0, x1) x [y0, y1) and the blocks above
+       them up to level top */
+    template <class View>
+    void update(const View& grid, int x0, int y0, int x1, int y1, int top)
+    {
+        const int side = 1 << PYRAMID_BASE_LEVEL;
+        int bx0 = x0 >> PYRAMID_BASE_LEVEL, by0 = y0 >> PYRAMID_BASE_LEVEL;
+        int bx1 = (x1 + side - 1) >> PYRAMID_BASE_LEVEL, by1 = (y1 + side - 1) >> PYRAMID_BASE_LEVEL;
+        Level& base = levels[0];
+        for(int by = by0; by<by1; by++)
+        {
+            uint8_t* out = &base.blocks[(std::size_t)by * base.width];
+            int rows = std::min(side, gridHeight - by*side);
+            for(int bx = bx0; bx<bx1; bx++)
+            {
+                int x = bx*side, n = std::min(side, gridWidth - x);
+                int count = 0;
+                for(int j = 0; j<rows; j++)
+                {
+                    count += countCells(grid, x, n, by*side + j);
+                }
+                out[bx] = (uint8_t)(count * 255 / (side*side));
+            }
+        }
+        for(int k = 1; k<=top - PYRAMID_BASE_LEVEL && k<(int)levels.size(); k++)
+        {
+            bx0 >>= 1;
+            by0 >>= 1;
+            bx1 = (bx1 + 1) >> 1;
+            by1 = (by1 + 1) >> 1;
+            average(levels[k-1], levels[k], bx0, by0, bx1, by1);
+        }
+    }
+
+    /* recount every block */
+    template <class View>
+    void update(const View& grid)
+    {
+        update(grid, 0, 0, gridWidth, gridHeight, topLevel());
+    }
+
+private:
+
+    struct Level
+    {
+        int width, height;
+        std::vector<uint8_t> blocks;
+    };
+
+    /* blocks [x0, x1) x [y0, y1) of a level from the four below each of them,
+       blocks beyond the level below count as dead */
+    static void average(const Level& below, Level& level, int x0, int y0, int x1, int y1)
+    {
+        for(int y = y0; y<y1; y++)
+        {
+            for(int x = x0; x<x1; x++)
+            {
+                int sum = 0;
+                for(int j = 2*y; j<std::min(2*y + 2, below.height); j++)
+                {
+                    for(int i = 2*x; i<std::min(2*x + 2, below.width); i++)
+                    {
+                        sum += below.blocks[(std::size_t)j * below.width + i];
+                    }
+                }
+                level.blocks[(std::size_t)y * level.width + x] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+
+    int gridWidth, gridHeight;
+    std::vector<Level> levels;  // from PYRAMID_BASE_LEVEL up
+};
+
+#endif
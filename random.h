@@ -0,0 +1,127 @@
+
+// Author: 	Stephan Meesters
+//
+// Seeded random boards
+//
+// Random boards are drawn from a counter-based generator. Word n of the
+// board of a seed, the 64 cells from column 64*(n % wordsPerRow) of row
+// n / wordsPerRow, is a function of the seed and n alone (splitmix64 of the
+// key plus n times its gamma). Bands of rows are filled in parallel and in
+// any order, and a seed gives the same board whatever the number of
+// threads, and whatever the engine.
+//
+// A density is a binary fraction of RANDOM_DENSITY_BITS bits. The cells of
+// a word are drawn bit by bit of the fraction, from its lowest set bit up: a
+// fresh random word is ORed in for a one and ANDed in for a zero, which
+// leaves every cell alive with exactly the probability of the fraction.
+// Density 1/2 takes one random word for 64 cells, any other at most
+// RANDOM_DENSITY_BITS.
+//
+
+#ifndef CONWAY_RANDOM_H
+#define CONWAY_RANDOM_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#define RANDOM_DENSITY_BITS 16      // fractional bits of a density
+#define RANDOM_GAMMA 0x9e3779b97f4a7c15ull
+
+/* splitmix64 finalizer, a bijective mix of the 64 bits */
+inline uint64_t mixHash(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* key the random words of a seed are drawn with */
+inline uint64_t randomKey(uint64_t seed)
+{
+    return mixHash(seed + RANDOM_GAMMA);
+}
+
+/* density of a probability, rounded to RANDOM_DENSITY_BITS bits */
+inline uint32_t randomDensity(double probability)
+{
+    double scaled = std::floor(probability * (1u << RANDOM_DENSITY_BITS) + 0.5);
+    return (uint32_t)std::min(std::max(scaled, 0.0), (double)(1u << RANDOM_DENSITY_BITS));
+}
+
+/* word n of a board, each cell alive with probability density / 2^RANDOM_DENSITY_BITS */
+inline uint64_t randomCells(uint64_t key, uint64_t n, uint32_t density)
+{
+    if(density >= (1u << RANDOM_DENSITY_BITS))
+    {
+        return ~uint64_t(0);
+    }
+    uint64_t cells = 0;
+    for(int j = density != 0 ? __builtin_ctz(density) : RANDOM_DENSITY_BITS; j<RANDOM_DENSITY_BITS; j++)
+    {
+        uint64_t r = mixHash(key + (n * RANDOM_DENSITY_BITS + j) * RANDOM_GAMMA);
+        cells = (density >> j) & 1 ? cells | r : cells & r;
+    }
+    return cells;
+}
+
+/* row y of a board as bit-packed words, cell x in bit x%64 of word x/64, bits past width clear */
+inline void randomRow(uint64_t key, int y, int width, uint32_t density, uint64_t* out)
+{
+    int wordsPerRow = (width + 63) / 64;
+    for(int i = 0; i<wordsPerRow; i++)
+    {
+        out[i] = randomCells(key, (uint64_t)y * wordsPerRow + i, density);
+    }
+    if(width % 64 != 0)
+    {
+        out[wordsPerRow-1] &= (uint64_t(1) << (width % 64)) - 1;
+    }
+}
+
+/* row y of a board as cells of any type, 0 or 1 */
+template <class T>
+void randomRow(uint64_t key, int y, int width, uint32_t density, T* out)
+{
+    int wordsPerRow = (width + 63) / 64;
+    for(int i = 0; i<wordsPerRow; i++)
+    {
+        uint64_t cells = randomCells(key, (uint64_t)y * wordsPerRow + i, density);
+        for(int x = i*64; x<std::min(i*64 + 64, width); x++)
+        {
+            out[x] = T((cells >> (x & 63)) & 1);
+        }
+    }
+}
+
+/* byte cells, eight bits spread to the bytes of a word at once */
+inline void randomRow(uint64_t key, int y, int width, uint32_t density, char* out)
+{
+    int wordsPerRow = (width + 63) / 64;
+    for(int i = 0; i<wordsPerRow; i++)
+    {
+        uint64_t cells = randomCells(key, (uint64_t)y * wordsPerRow + i, density);
+        for(int x = i*64; x<std::min(i*64 + 64, width); x += 8)
+        {
+            // bit k of the byte to bit 8k, then each byte to 0 or 1
+            uint64_t bytes = (((cells >> (x & 63)) & 0xff) * 0x0101010101010101ull) & 0x8040201008040201ull;
+            bytes = ((bytes + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+            if(x + 8 <= width)
+            {
+                std::memcpy(out + x, &bytes, 8);
+            }
+            else
+            {
+                for(int k = 0; x+k < width; k++)
+                {
+                    out[x+k] = char((cells >> ((x+k) & 63)) & 1);
+                }
+            }
+        }
+    }
+}
+
+#endif
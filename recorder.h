@@ -0,0 +1,310 @@
+
+// Author: 	Stephan Meesters
+//
+// Export of generations as video frames
+//
+// A Recorder takes generations of a process as frames and writes them on
+// worker threads of its own, either as raw pixels to the standard input of a
+// command, ffmpeg for instance, or as PNG files through SDL_image, one per
+// generation. A target starting with '|' is the command, any other names the
+// PNG files: frames/run.png is written as frames/run-000042.png for
+// generation 42.
+//
+// The stepping thread only packs the cells of a generation into a free slot,
+// a bit per cell as in a snapshot, straight from the grid of the process. The
+// workers widen the bits to pixels, scale by scale pixels per cell, and encode
+// them; raw frames are handed to the command in the order they were taken,
+// whichever worker finishes first. There is a fixed number of slots, so a
+// run that outpaces its encoders waits for a slot to free up instead of
+// queueing without bound; such stalls are counted.
+//
+// Raw pixels are 32-bit ARGB words in native byte order, BGRA in memory on
+// little-endian machines:
+//
+//     ffmpeg -f rawvideo -pixel_format bgra -video_size WxH -i - out.mp4
+//
+
+#ifndef CONWAY_RECORDER_H
+#define CONWAY_RECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "grid.h"
+#include "pixels.h"
+#include "snapshot.h"
+
+#define RECORD_THREADS_DEFAULT 2    // workers that encode frames
+#define RECORD_SLOTS_PER_THREAD 4   // frames taken but not yet encoded, per worker
+#define RECORD_PATH_MAX 4096        // longest name of a PNG file
+
+/* writes generations as frames on threads of its own */
+class Recorder
+{
+public:
+
+    /* constructor, for a grid of width x height cells drawn at scale pixels
+       per cell in the given colours */
+    Recorder(int width, int height, int scale, int threads, uint32_t alive, uint32_t dead):
+        width(width), height(height), scale(std::max(scale, 1)), threads(std::max(threads, 1)),
+        wordsPerRow((width + 63) / 64), alive(alive), dead(dead), pipe(nullptr), pending(0),
+        taken(0), nextWrite(0), stopping(false), failed(false), stallCount(0)
+    {
+    }
+
+    /* finish the frames taken */
+    ~Recorder()
+    {
+        close();
+    }
+
+    Recorder(Recorder const&) = delete;
+    Recorder& operator=(Recorder const&) = delete;
+
+    /* start writing to a target, false with the reason if it cannot be opened */
+    bool open(const char* target, std::string& error)
+    {
+        if(target[0] == '|')
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            signal(SIGPIPE, SIG_IGN);   // a command that quits fails the write instead
+            pipe = popen(target + 1, "w");
+#endif
+            if(pipe == nullptr)
+            {
+                error = std::string("cannot run ") + (target + 1);
+                return false;
+            }
+        }
+        else
+        {
+            const char* extension = std::strrchr(target, '.');
+            if(extension == nullptr || std::strcmp(extension, ".png") != 0)
+            {
+                error = "frames are written to a command, |command, or to files name.png";
+                return false;
+            }
+            prefix.assign(target, extension);
+        }
+
+        // every slot and pixel buffer is sized now, taking a frame never allocates
+        std::size_t pixels = (std::size_t)width * scale * height * scale;
+        slots.resize(threads * RECORD_SLOTS_PER_THREAD);
+        for(Slot& slot: slots)
+        {
+            slot.cells.resize((std::size_t)wordsPerRow * height);
+            freeSlots.push_back(&slot - slots.data());
+        }
+        queue.assign(slots.size(), 0);
+        buffers.resize(threads, std::vector<uint32_t>(pixels));
+        for(int i = 0; i<threads; i++)
+        {
+            workers.push_back(std::thread(&Recorder::run, this, i));
+        }
+        return true;
+    }
+
+    /* width and height of a frame in pixels */
+    int frameWidth() const { return width * scale; }
+    int frameHeight() const { return height * scale; }
+
+    /* take a generation as the next frame, waits only while every slot is taken */
+    template <class View>
+    void record(const View& grid, uint64_t generation)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(freeSlots.empty())
+            {
+                stallCount++;
+                slotFreed.wait(lock, [this]{ return !freeSlots.empty(); });
+            }
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        Slot& slot = slots[index];
+        for(int y = 0; y<height; y++)
+        {
+            packRow(grid, y, &slot.cells[(std::size_t)y * wordsPerRow]);
+        }
+        slot.generation = generation;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.sequence = taken++;
+            queue[(slot.sequence) % queue.size()] = index;
+            pending++;
+        }
+        work.notify_one();
+    }
+
+    /* times a frame had to wait for a slot */
+    uint64_t stalls() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stallCount;
+    }
+
+    /* encode the frames taken, stop the workers and close the command */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work.notify_all();
+        for(std::thread& worker: workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+        if(pipe != nullptr)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            if(pclose(pipe) != 0 && !failed)
+            {
+                fprintf(stderr, "recording failed: the command did not finish cleanly\n");
+            }
+#endif
+            pipe = nullptr;
+        }
+    }
+
+private:
+
+    /* a frame taken, a bit per cell */
+    struct Slot
+    {
+        std::vector<uint64_t> cells;
+        uint64_t generation;
+        uint64_t sequence;      // order in which the frames were taken
+    };
+
+    /* worker thread, encodes the oldest frame waiting */
+    void run(int worker)
+    {
+        std::vector<uint32_t>& pixels = buffers[worker];
+        while(true)
+        {
+            int index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this]{ return pending > 0 || stopping; });
+                if(pending == 0)
+                {
+                    return;
+                }
+                index = queue[(taken - pending) % queue.size()];
+                pending--;
+            }
+            Slot& slot = slots[index];
+            convert(slot, pixels.data());
+            uint64_t sequence = slot.sequence, generation = slot.generation;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeSlots.push_back(index);     // the pixels hold the frame from here
+            }
+            slotFreed.notify_one();
+            if(pipe != nullptr)
+            {
+                writeRaw(pixels.data(), sequence);
+            }
+            else
+            {
+                writePng(pixels.data(), generation);
+            }
+        }
+    }
+
+    /* widen the bits of a frame to pixels, every cell to a square */
+    void convert(const Slot& slot, uint32_t* pixels) const
+    {
+        BitGridView cells(slot.cells.data(), width, height, wordsPerRow);
+        std::size_t rowPixels = (std::size_t)width * scale;
+        for(int y = 0; y<height; y++)
+        {
+            uint32_t* out = pixels + y * scale * rowPixels;
+            rowToPixels(cells, y, 0, width, out, alive, dead);
+            // from the right, no pixel is overwritten before it is widened
+            for(int x = scale > 1 ? width-1 : -1; x>=0; x--)
+            {
+                std::fill(out + x*scale, out + (x+1)*scale, out[x]);
+            }
+            for(int i = 1; i<scale; i++)
+            {
+                std::copy(out, out + rowPixels, out + i*rowPixels);
+            }
+        }
+    }
+
+    /* write a frame to the command once the frames before it are */
+    void writeRaw(const uint32_t* pixels, uint64_t sequence)
+    {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        written.wait(lock, [this, sequence]{ return nextWrite == sequence; });
+        std::size_t count = (std::size_t)frameWidth() * frameHeight();
+        if(!failed && fwrite(pixels, sizeof(uint32_t), count, pipe) != count)
+        {
+            fprintf(stderr, "recording failed: cannot write to the command\n");
+            failed = true;
+        }
+        nextWrite++;
+        written.notify_all();
+    }
+
+    /* save a frame as the PNG file of its generation */
+    void writePng(uint32_t* pixels, uint64_t generation)
+    {
+        char path[RECORD_PATH_MAX];
+        snprintf(path, sizeof(path), "%s-%06llu.png", prefix.c_str(), (unsigned long long)generation);
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, frameWidth(), frameHeight(), 32,
+                                                                  frameWidth() * sizeof(uint32_t), SDL_PIXELFORMAT_ARGB8888);
+        if(surface == nullptr || IMG_SavePNG(surface, path) != 0)
+        {
+            if(!failed.exchange(true))
+            {
+                fprintf(stderr, "recording failed: cannot write %s\n", path);
+            }
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    int width, height, scale, threads;
+    int wordsPerRow;
+    uint32_t alive, dead;
+    FILE* pipe;                         // command the raw frames go to, nullptr for PNG files
+    std::string prefix;                 // of the PNG files
+
+    std::vector<Slot> slots;
+    std::vector<std::vector<uint32_t> > buffers;    // pixels, per worker
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;           // guards the slots and the queue
+    std::condition_variable work, slotFreed;
+    std::vector<int> freeSlots;
+    std::vector<int> queue;             // ring of the slots taken, by sequence
+    std::size_t pending;                // slots taken and not yet picked up by a worker
+    uint64_t taken;                     // frames taken since the start
+
+    std::mutex writeMutex;              // orders the raw frames
+    std::condition_variable written;
+    uint64_t nextWrite;                 // sequence of the next raw frame
+
+    bool stopping;
+    std::atomic<bool> failed;
+    uint64_t stallCount;
+};
+
+#endif
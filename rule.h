@@ -0,0 +1,279 @@
+
+// Author: 	Stephan Meesters
+//
+// Outer-totalistic birth/survival rules
+//
+// A rule such as B3/S23 tells for which numbers of live neighbours a dead
+// cell is born and a live cell survives. LifeRule holds the two sets as bit
+// masks and is read from B/S notation (B36/S23) or the older S/B notation
+// (23/36).
+//
+// Generations rules add a number of states, B2/S/C3 or /2/3: a live cell
+// that does not survive decays through states 2, 3, ... before it is dead,
+// and only state 1 counts as a live neighbour. GenerationsRule steps them,
+// on byte grids only.
+//
+// The processes take the rule as a template parameter. Rule<Birth, Survival>
+// is a rule known at compile time: its lookups fold to shifts of constants and
+// the SIMD kernels only compare against the counts it uses. DynamicRule is
+// any rule given at runtime, backed by a 2x9 lookup table. dispatchRule()
+// picks the compile-time rule that matches a LifeRule, so the common rules
+// never pay for the table.
+//
+
+#ifndef CONWAY_RULE_H
+#define CONWAY_RULE_H
+
+#include <cstdint>
+#include <cctype>
+#include <string>
+
+#define RULE_COUNTS 9       // a cell has 0 to 8 live neighbours
+#define RULE_MAX_STATES 127 // states still fit a signed byte cell
+
+/* birth and survival counts of a rule, bit n set for n live neighbours */
+struct LifeRule
+{
+    uint16_t birth;
+    uint16_t survival;
+    uint16_t states;        // 2, or more for a Generations rule
+};
+
+inline bool operator==(const LifeRule& a, const LifeRule& b)
+{
+    return a.birth == b.birth && a.survival == b.survival && a.states == b.states;
+}
+
+inline bool operator!=(const LifeRule& a, const LifeRule& b)
+{
+    return !(a == b);
+}
+
+/* bit mask of the neighbour counts in a string of digits, at compile time */
+constexpr uint16_t ruleCounts(const char* digits)
+{
+    return *digits == 0 ? 0 : (uint16_t)((1u << (*digits - '0')) | ruleCounts(digits + 1));
+}
+
+/* read the digits of one half of a rule, false if one is not a count */
+inline bool parseRuleCounts(const char*& text, uint16_t& counts)
+{
+    counts = 0;
+    for(; *text >= '0' && *text <= '9'; text++)
+    {
+        if(*text == '9')
+        {
+            return false;
+        }
+        counts |= 1 << (*text - '0');
+    }
+    return true;
+}
+
+/* read the number of states of a Generations rule */
+inline bool parseRuleStates(const char*& text, uint16_t& states)
+{
+    int n = 0;
+    if(!std::isdigit((unsigned char)*text))
+    {
+        return false;
+    }
+    for(; std::isdigit((unsigned char)*text) && n <= RULE_MAX_STATES; text++)
+    {
+        n = 10*n + (*text - '0');
+    }
+    states = (uint16_t)n;
+    return n >= 2 && n <= RULE_MAX_STATES;
+}
+
+/* read a rule in B/S or B/S/C notation, the parts in any order, or in S/B or S/B/C notation */
+inline bool parseRule(const char* text, LifeRule& rule)
+{
+    rule.birth = rule.survival = 0;
+    rule.states = 2;
+    if(std::isdigit((unsigned char)*text) || *text == '/')
+    {
+        // S/B: survival counts, a slash, birth counts, optionally a slash and the states
+        if(!parseRuleCounts(text, rule.survival) || *text++ != '/' || !parseRuleCounts(text, rule.birth))
+        {
+            return false;
+        }
+        if(*text == '/' && !parseRuleStates(++text, rule.states))
+        {
+            return false;
+        }
+        return *text == 0;
+    }
+    bool seen[3] = {false, false, false};
+    while(true)
+    {
+        char part = (char)std::toupper((unsigned char)*text++);
+        int index = part == 'B' ? 0 : part == 'S' ? 1 : part == 'C' || part == 'G' ? 2 : -1;
+        if(index < 0 || seen[index])
+        {
+            return false;
+        }
+        seen[index] = true;
+        if(index == 2 ? !parseRuleStates(text, rule.states) : !parseRuleCounts(text, index == 0 ? rule.birth : rule.survival))
+        {
+            return false;
+        }
+        if(*text == 0)
+        {
+            return seen[0] && seen[1];
+        }
+        if(*text++ != '/')
+        {
+            return false;
+        }
+    }
+}
+
+/* a rule in B/S notation */
+inline std::string ruleString(const LifeRule& rule)
+{
+    std::string text = "B";
+    for(int n = 0; n<RULE_COUNTS; n++)
+    {
+        if((rule.birth >> n) & 1)
+        {
+            text += char('0' + n);
+        }
+    }
+    text += "/S";
+    for(int n = 0; n<RULE_COUNTS; n++)
+    {
+        if((rule.survival >> n) & 1)
+        {
+            text += char('0' + n);
+        }
+    }
+    if(rule.states > 2)
+    {
+        text += "/C" + std::to_string(rule.states);
+    }
+    return text;
+}
+
+/* rule known at compile time */
+template <uint16_t Birth, uint16_t Survival>
+struct Rule
+{
+    static const uint16_t birth = Birth;
+    static const uint16_t survival = Survival;
+    static const bool binary = true;    // cells are 0 or 1
+
+    Rule(){}
+    explicit Rule(const LifeRule&){}
+
+    static LifeRule lifeRule() { return LifeRule{Birth, Survival, 2}; }
+
+    /* next state of a cell, alive 0 or 1, with count live neighbours */
+    static char next(int alive, int count)
+    {
+        return ((Birth | (uint32_t(Survival) << RULE_COUNTS)) >> (count + RULE_COUNTS*alive)) & 1;
+    }
+};
+
+template <uint16_t Birth, uint16_t Survival> const uint16_t Rule<Birth, Survival>::birth;
+template <uint16_t Birth, uint16_t Survival> const uint16_t Rule<Birth, Survival>::survival;
+template <uint16_t Birth, uint16_t Survival> const bool Rule<Birth, Survival>::binary;
+
+typedef Rule<ruleCounts("3"), ruleCounts("23")> ConwayRule;
+typedef Rule<ruleCounts("36"), ruleCounts("23")> HighLifeRule;
+typedef Rule<ruleCounts("3678"), ruleCounts("34678")> DayAndNightRule;
+typedef Rule<ruleCounts("2"), ruleCounts("")> SeedsRule;
+
+/* rule given at runtime, next states from a 2x9 table */
+struct DynamicRule
+{
+    DynamicRule():DynamicRule(ConwayRule::lifeRule()){}
+    explicit DynamicRule(const LifeRule& rule):birth(rule.birth), survival(rule.survival)
+    {
+        for(int n = 0; n<RULE_COUNTS; n++)
+        {
+            table[0][n] = (birth >> n) & 1;
+            table[1][n] = (survival >> n) & 1;
+        }
+    }
+
+    static const bool binary = true;
+
+    LifeRule lifeRule() const { return LifeRule{birth, survival, 2}; }
+
+    /* next state of a cell, alive 0 or 1, with count live neighbours */
+    char next(int alive, int count) const
+    {
+        return table[alive][count];
+    }
+
+    uint16_t birth;
+    uint16_t survival;
+    char table[2][RULE_COUNTS];     // [alive][count]
+};
+
+/* Generations rule given at runtime, cells hold a state in [0, states) */
+struct GenerationsRule
+{
+    explicit GenerationsRule(const LifeRule& rule):birth(rule.birth), survival(rule.survival), states(rule.states)
+    {
+        for(int n = 0; n<RULE_COUNTS; n++)
+        {
+            table[0][n] = (birth >> n) & 1;
+            table[1][n] = (survival >> n) & 1 ? 1 : 2 % states;
+        }
+        for(int state = 0; state<RULE_MAX_STATES; state++)
+        {
+            decay[state] = state >= 2 ? (state + 1) % states : 0;
+        }
+    }
+
+    static const bool binary = false;
+
+    LifeRule lifeRule() const { return LifeRule{birth, survival, states}; }
+
+    /* next state of a cell in any state with count neighbours in state 1 */
+    int next(int state, int count) const
+    {
+        return state < 2 ? table[state][count] : decay[state];
+    }
+
+    uint16_t birth;
+    uint16_t survival;
+    uint16_t states;
+    char table[2][RULE_COUNTS];     // [state 0 or 1][count]
+    char decay[RULE_MAX_STATES];    // next state of a decaying cell
+};
+
+/* call visit(R(rule)) with the compile-time rule equal to rule, with
+   GenerationsRule for more than two states, or else with DynamicRule */
+template <class Visitor>
+void dispatchRule(const LifeRule& rule, Visitor& visit)
+{
+    if(rule.states > 2)
+    {
+        visit(GenerationsRule(rule));
+    }
+    else if(rule == ConwayRule::lifeRule())
+    {
+        visit(ConwayRule(rule));
+    }
+    else if(rule == HighLifeRule::lifeRule())
+    {
+        visit(HighLifeRule(rule));
+    }
+    else if(rule == DayAndNightRule::lifeRule())
+    {
+        visit(DayAndNightRule(rule));
+    }
+    else if(rule == SeedsRule::lifeRule())
+    {
+        visit(SeedsRule(rule));
+    }
+    else
+    {
+        visit(DynamicRule(rule));
+    }
+}
+
+#endif
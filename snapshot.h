@@ -0,0 +1,883 @@
+
+// Author: 	Stephan Meesters
+//
+// Binary snapshots of a Game of Life process, and checkpoints written in the background
+//
+// A snapshot file is a fixed 128-byte header (dimensions, generation, rule,
+// backend and boundary) followed by a payload of 64-bit words. Bounded grids
+// store their rows bit-packed, cell x of a row in bit x%64 of word x/64, the
+// sparse plane stores its chunks and HashLife its quadtree as a list of
+// nodes. Grids of multi-state rules store a bit plane per bit of the state
+// of a cell, one after the other for every row. The payload is optionally run-length encoded as runs of equal words.
+//
+// The header is a multiple of 8 bytes, so an uncompressed payload in a mapped
+// file is word-aligned and restored directly from the mapping into the grid
+// buffer, without reading it into memory first.
+//
+// A Checkpointer writes snapshots on a thread of its own. The grids that
+// step between two buffers hand it the grid of a generation once they are
+// one past it, swapped for a spare buffer, and the writer packs it, so the
+// stepping thread copies no cells at all; the other processes are packed
+// into a spare snapshot by the stepping thread between two updates, and
+// only encoding and file I/O run on the writer. A checkpoint that falls due
+// while the last one is still being written is deferred, not waited for:
+// the stepping goes on, and the first generation after the writer is idle
+// again is taken instead, and the count of generations to the next starts
+// from there.
+//
+
+#ifndef CONWAY_SNAPSHOT_H
+#define CONWAY_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+#include "grid.h"
+#include "conway.h"
+#include "bitlife.h"
+#include "sparse.h"
+#include "hashlife.h"
+#include "ltl.h"
+#include "changelist.h"
+#ifdef CONWAY_GPU
+#include "gpulife.h"
+#endif
+#include "mappedfile.h"
+#include "rule.h"
+#include "allocations.h"
+
+#define SNAPSHOT_VERSION 2                   // 1 stored the chunk coordinates of the sparse plane in 32 bits each
+#define SNAPSHOT_BYTE_ORDER 0x01020304u     // reads back differently on a host of the other endianness
+#define SNAPSHOT_REPEAT (uint64_t(1) << 63) // run-length control word: one word repeated, not literals
+#define SNAPSHOT_MIN_RUN 3                  // shorter runs of equal words are stored as literals
+
+/* process a snapshot was taken of, tells how the payload is laid out */
+enum SnapshotBackend
+{
+    SNAPSHOT_BYTE,          // bit-packed rows of a Conway<T> grid
+    SNAPSHOT_BIT,           // bit-packed rows of a BitConway grid
+    SNAPSHOT_SPARSE,        // chunk coordinates, a word each, and 64 rows per chunk
+    SNAPSHOT_HASHLIFE,      // four child indices per quadtree node, the root last
+    SNAPSHOT_LTL            // bit-packed rows of a LargerThanLife grid
+};
+
+enum SnapshotCompression
+{
+    SNAPSHOT_RAW,
+    SNAPSHOT_RLE
+};
+
+/* file header, the payload follows right after it */
+struct SnapshotHeader
+{
+    char magic[8];          // "CONWAYSN"
+    uint32_t version;
+    uint32_t byteOrder;     // SNAPSHOT_BYTE_ORDER
+    uint32_t backend;       // SnapshotBackend
+    uint32_t compression;   // SnapshotCompression
+    uint32_t boundary;      // BoundaryPolicy of a bounded grid
+    uint32_t planes;        // bit planes per row of a bounded grid, 0 for 1
+    int64_t width, height;  // grid, or the window of an unbounded process
+    uint64_t generation;
+    uint64_t wordsPerRow;   // of a bounded grid
+    uint64_t payloadWords;  // stored words following the header
+    char rule[56];          // rule as written by ruleString() or ltlRuleString(), nul-terminated
+};
+static_assert(sizeof(SnapshotHeader) == 128, "snapshot header must keep the payload word-aligned");
+
+/* a snapshot in memory, the payload not encoded */
+struct Snapshot
+{
+    Snapshot():backend(SNAPSHOT_BYTE), boundary(BOUNDARY_TORUS), rule(ruleString(ConwayRule::lifeRule())),
+        width(0), height(0), generation(0), wordsPerRow(0), planes(1){}
+
+    SnapshotBackend backend;
+    BoundaryPolicy boundary;
+    std::string rule;
+    int64_t width, height;
+    uint64_t generation;
+    uint64_t wordsPerRow;
+    int planes;
+    std::vector<uint64_t> words;
+};
+
+/* pack a row of byte cells, eight 0/1 bytes to a byte of the word at once */
+inline void packRow(const GridView<char>& grid, int y, uint64_t* out)
+{
+    const char* row = grid.row(y);
+    int width = grid.width(), x = 0;
+    for(; x + 64 <= width; x += 64)
+    {
+        uint64_t word = 0;
+        for(int k = 0; k<8; k++)
+        {
+            uint64_t bytes;
+            std::memcpy(&bytes, row + x + 8*k, sizeof(bytes));
+            word |= ((bytes * 0x0102040810204080ULL) >> 56) << (8*k);
+        }
+        out[x >> 6] = word;
+    }
+    if(x < width)
+    {
+        uint64_t word = 0;
+        for(int i = x; i<width; i++)
+        {
+            word |= uint64_t(row[i] != 0) << (i & 63);
+        }
+        out[x >> 6] = word;
+    }
+}
+
+/* pack a row of cells of any type */
+template <class T>
+void packRow(const GridView<T>& grid, int y, uint64_t* out)
+{
+    std::fill(out, out + (grid.width() + 63) / 64, uint64_t(0));
+    for(int x = 0; x<grid.width(); x++)
+    {
+        out[x >> 6] |= uint64_t(grid(x, y) != 0) << (x & 63);
+    }
+}
+
+/* a row of a bit grid is packed already */
+inline void packRow(const BitGridView& grid, int y, uint64_t* out)
+{
+    std::copy(grid.row(y), grid.row(y) + (grid.width() + 63) / 64, out);
+}
+
+/* pack a row of multi-state cells as planes of words, bit p of the states in plane p */
+template <class T>
+void packPlanes(const GridView<T>& grid, int y, int planes, uint64_t* out)
+{
+    std::size_t wordsPerRow = (grid.width() + 63) / 64;
+    std::fill(out, out + planes * wordsPerRow, uint64_t(0));
+    const T* row = grid.row(y);
+    for(int x = 0; x<grid.width(); x++)
+    {
+        for(int p = 0; p<planes; p++)
+        {
+            out[p * wordsPerRow + (x >> 6)] |= uint64_t((int(row[x]) >> p) & 1) << (x & 63);
+        }
+    }
+}
+
+inline void packPlanes(const BitGridView& grid, int y, int, uint64_t* out)
+{
+    packRow(grid, y, out);
+}
+
+/* bit planes needed for cells of a number of states */
+inline int snapshotPlanes(int states)
+{
+    int planes = 1;
+    while((1 << planes) < states)
+    {
+        planes++;
+    }
+    return planes;
+}
+
+/* the rule of a process, as stored in the header */
+template <class Process>
+std::string snapshotRule(const Process& process)
+{
+    return ruleString(process.lifeRule());
+}
+
+inline std::string snapshotRule(const LargerThanLife& life)
+{
+    return ltlRuleString(life.ltlRule());
+}
+
+/* pack the rows of a bounded grid into a snapshot, in bit planes for more than two states */
+template <class View>
+void captureRows(const View& grid, int states, Snapshot& snapshot)
+{
+    snapshot.width = grid.width();
+    snapshot.height = grid.height();
+    snapshot.planes = snapshotPlanes(states);
+    snapshot.wordsPerRow = (grid.width() + 63) / 64;
+    snapshot.words.resize(snapshot.wordsPerRow * snapshot.planes * grid.height());
+    for(int y = 0; y<grid.height(); y++)
+    {
+        uint64_t* out = &snapshot.words[y * snapshot.planes * snapshot.wordsPerRow];
+        if(snapshot.planes == 1)
+        {
+            packRow(grid, y, out);
+        }
+        else
+        {
+            packPlanes(grid, y, snapshot.planes, out);
+        }
+    }
+}
+
+/* take a snapshot of the current generation of a process; the boundary, and
+   the window of an unbounded process, are left to the caller */
+template <class T, class R>
+void captureSnapshot(const Conway<T, R>& conway, Snapshot& snapshot)
+{
+    captureRows(conway.fullGrid(), conway.lifeRule().states, snapshot);
+    snapshot.backend = SNAPSHOT_BYTE;
+    snapshot.rule = snapshotRule(conway);
+    snapshot.generation = conway.generation();
+}
+
+template <class R>
+void captureSnapshot(const BitConway<R>& conway, Snapshot& snapshot)
+{
+    captureRows(conway.fullGrid(), 2, snapshot);
+    snapshot.backend = SNAPSHOT_BIT;
+    snapshot.rule = snapshotRule(conway);
+    snapshot.generation = conway.generation();
+}
+
+/* the change list holds two states and shares the snapshots of the bit grid */
+template <class R>
+void captureSnapshot(const ChangeListLife<R>& life, Snapshot& snapshot)
+{
+    captureRows(life.fullGrid(), 2, snapshot);
+    snapshot.backend = SNAPSHOT_BIT;
+    snapshot.rule = snapshotRule(life);
+    snapshot.generation = life.generation();
+}
+
+inline void captureSnapshot(const LargerThanLife& life, Snapshot& snapshot)
+{
+    captureRows(life.fullGrid(), life.ltlRule().states, snapshot);
+    snapshot.backend = SNAPSHOT_LTL;
+    snapshot.rule = snapshotRule(life);
+    snapshot.generation = life.generation();
+}
+
+/* take a snapshot of the grid a process let go of with releasePreviousGrid(),
+   on the writer while the process steps on: it reads the released grid and
+   the rule, which the stepping leaves alone, and leaves the generation to
+   the caller too */
+template <class T, class R>
+void captureReleased(const Conway<T, R>& conway, Snapshot& snapshot)
+{
+    captureRows(conway.releasedGrid(), conway.lifeRule().states, snapshot);
+    snapshot.backend = SNAPSHOT_BYTE;
+    snapshot.rule = snapshotRule(conway);
+}
+
+template <class R>
+void captureReleased(const BitConway<R>& conway, Snapshot& snapshot)
+{
+    captureRows(conway.releasedGrid(), 2, snapshot);
+    snapshot.backend = SNAPSHOT_BIT;
+    snapshot.rule = snapshotRule(conway);
+}
+
+inline void captureReleased(const LargerThanLife& life, Snapshot& snapshot)
+{
+    captureRows(life.releasedGrid(), life.ltlRule().states, snapshot);
+    snapshot.backend = SNAPSHOT_LTL;
+    snapshot.rule = snapshotRule(life);
+}
+
+#ifdef CONWAY_GPU
+/* the GPU grid reads back as a bit grid and shares its snapshots */
+inline void captureSnapshot(const GpuLife& life, Snapshot& snapshot)
+{
+    captureRows(life.fullGrid(), 2, snapshot);
+    snapshot.backend = SNAPSHOT_BIT;
+    snapshot.rule = snapshotRule(life);
+    snapshot.generation = life.generation();
+}
+#endif
+
+inline void captureSnapshot(const SparseLife& life, Snapshot& snapshot)
+{
+    snapshot.backend = SNAPSHOT_SPARSE;
+    snapshot.rule = snapshotRule(life);
+    snapshot.generation = life.generation();
+    snapshot.planes = 1;
+    snapshot.wordsPerRow = 0;
+    snapshot.words.clear();
+    for(const SparseLife::Chunk* chunk: life.storedChunks())
+    {
+        uint64_t any = 0;
+        for(int y = 0; y<SPARSE_CHUNK_SIZE; y++)
+        {
+            any |= chunk->rows[y];
+        }
+        if(any != 0)
+        {
+            snapshot.words.push_back(uint64_t(chunk->cx));
+            snapshot.words.push_back(uint64_t(chunk->cy));
+            snapshot.words.insert(snapshot.words.end(), chunk->rows, chunk->rows + SPARSE_CHUNK_SIZE);
+        }
+    }
+}
+
+/* index of a quadtree node in the snapshot, its children listed before it;
+   the two cells are indices 0 and 1 */
+inline uint64_t captureNode(const HashLife::Node* node, std::unordered_map<const HashLife::Node*, uint64_t>& indices, std::vector<uint64_t>& words)
+{
+    if(node->level == 0)
+    {
+        return node->population;
+    }
+    auto found = indices.find(node);
+    if(found != indices.end())
+    {
+        return found->second;
+    }
+    uint64_t children[4] = {captureNode(node->nw, indices, words), captureNode(node->ne, indices, words),
+                            captureNode(node->sw, indices, words), captureNode(node->se, indices, words)};
+    words.insert(words.end(), children, children + 4);
+    uint64_t index = 2 + words.size()/4 - 1;
+    indices[node] = index;
+    return index;
+}
+
+inline void captureSnapshot(const HashLife& life, Snapshot& snapshot)
+{
+    snapshot.backend = SNAPSHOT_HASHLIFE;
+    snapshot.rule = snapshotRule(life);
+    snapshot.generation = life.generation();
+    snapshot.planes = 1;
+    snapshot.wordsPerRow = 0;
+    snapshot.words.clear();
+    std::unordered_map<const HashLife::Node*, uint64_t> indices;
+    captureNode(life.rootNode(), indices, snapshot.words);
+}
+
+/* run-length encode words: a control word with SNAPSHOT_REPEAT is followed
+   by one word stored that many times, otherwise by that many literal words */
+inline void encodeRuns(const std::vector<uint64_t>& words, std::vector<uint64_t>& out)
+{
+    out.clear();
+    std::size_t literals = 0, i = 0;
+    while(i < words.size())
+    {
+        std::size_t j = i + 1;
+        while(j < words.size() && words[j] == words[i])
+        {
+            j++;
+        }
+        if(j - i >= SNAPSHOT_MIN_RUN)
+        {
+            if(literals < i)
+            {
+                out.push_back(i - literals);
+                out.insert(out.end(), words.begin() + literals, words.begin() + i);
+            }
+            out.push_back(SNAPSHOT_REPEAT | (j - i));
+            out.push_back(words[i]);
+            literals = j;
+        }
+        i = j;
+    }
+    if(literals < words.size())
+    {
+        out.push_back(words.size() - literals);
+        out.insert(out.end(), words.begin() + literals, words.end());
+    }
+}
+
+/* header of a snapshot whose payload is stored in payloadWords words */
+inline SnapshotHeader snapshotHeader(const Snapshot& snapshot, SnapshotCompression compression, uint64_t payloadWords)
+{
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CONWAYSN", sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.backend = snapshot.backend;
+    header.compression = compression;
+    header.boundary = snapshot.boundary;
+    header.planes = snapshot.planes;
+    header.width = snapshot.width;
+    header.height = snapshot.height;
+    header.generation = snapshot.generation;
+    header.wordsPerRow = snapshot.wordsPerRow;
+    header.payloadWords = payloadWords;
+    std::strncpy(header.rule, snapshot.rule.c_str(), sizeof(header.rule) - 1);
+    return header;
+}
+
+/* write a snapshot to a file, run-length encoded if asked for and smaller; the
+   file is written under a temporary name first, so it is always complete */
+inline bool writeSnapshot(const Snapshot& snapshot, const char* path, bool compress, std::string& error)
+{
+    std::vector<uint64_t> encoded;
+    if(compress)
+    {
+        encodeRuns(snapshot.words, encoded);
+    }
+    bool encode = compress && encoded.size() < snapshot.words.size();
+    const std::vector<uint64_t>& payload = encode ? encoded : snapshot.words;
+    SnapshotHeader header = snapshotHeader(snapshot, encode ? SNAPSHOT_RLE : SNAPSHOT_RAW, payload.size());
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if(file == nullptr)
+    {
+        error = "cannot create " + temporary;
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(payload.data(), sizeof(uint64_t), payload.size(), file) == payload.size();
+    written = fclose(file) == 0 && written;
+    if(!written || std::rename(temporary.c_str(), path) != 0)
+    {
+        std::remove(temporary.c_str());
+        error = std::string("cannot write ") + path;
+        return false;
+    }
+    return true;
+}
+
+/* the payload of a mapped snapshot, handed out a number of words at a time;
+   raw payloads are read in place, encoded ones decoded into a buffer */
+class SnapshotReader
+{
+public:
+
+    SnapshotReader(const uint64_t* begin, const uint64_t* end, bool encoded):
+        position(begin), end(end), encoded(encoded), left(0), repeat(false), value(0){}
+
+    /* the next count words, nullptr if the payload ends before them */
+    const uint64_t* next(std::size_t count)
+    {
+        if(!encoded)
+        {
+            if((std::size_t)(end - position) < count)
+            {
+                return nullptr;
+            }
+            const uint64_t* words = position;
+            position += count;
+            return words;
+        }
+        buffer.resize(count);
+        uint64_t* out = buffer.data();
+        while(count > 0)
+        {
+            if(left == 0)
+            {
+                if(position == end)
+                {
+                    return nullptr;
+                }
+                uint64_t control = *position++;
+                repeat = (control & SNAPSHOT_REPEAT) != 0;
+                left = control & ~SNAPSHOT_REPEAT;
+                if(left == 0 || (repeat && position == end))
+                {
+                    return nullptr;
+                }
+                if(repeat)
+                {
+                    value = *position++;
+                }
+            }
+            std::size_t take = (std::size_t)std::min<uint64_t>(left, count);
+            if(repeat)
+            {
+                std::fill(out, out + take, value);
+            }
+            else
+            {
+                if((std::size_t)(end - position) < take)
+                {
+                    return nullptr;
+                }
+                std::copy(position, position + take, out);
+                position += take;
+            }
+            out += take;
+            count -= take;
+            left -= take;
+        }
+        return buffer.data();
+    }
+
+    /* has the whole payload been read */
+    bool finished() const
+    {
+        return position == end && left == 0;
+    }
+
+private:
+
+    const uint64_t* position;
+    const uint64_t* end;
+    bool encoded;
+    uint64_t left;          // words left of the current run
+    bool repeat;
+    uint64_t value;         // the word of a repeated run
+    std::vector<uint64_t> buffer;
+};
+
+/* set a row of a bounded grid from its planes of words */
+template <class Process>
+void restoreRow(Process& conway, int y, const uint64_t* words, int planes)
+{
+    conway.setRow(y, words, planes);
+}
+
+template <class R>
+void restoreRow(BitConway<R>& conway, int y, const uint64_t* words, int)
+{
+    conway.setRow(y, words);
+}
+
+#ifdef CONWAY_GPU
+inline void restoreRow(GpuLife& life, int y, const uint64_t* words, int)
+{
+    life.setRow(y, words);
+}
+#endif
+
+/* the rows of a snapshot of a bounded grid into a process of the same size
+   and number of states */
+template <class Process>
+bool restoreRows(const SnapshotHeader& header, SnapshotReader& reader, Process& conway, int states, int width, int height, std::string& error)
+{
+    if(header.backend != SNAPSHOT_BYTE && header.backend != SNAPSHOT_BIT && header.backend != SNAPSHOT_LTL)
+    {
+        error = "snapshot is not of a bounded grid";
+        return false;
+    }
+    if(header.width != width || header.height != height || header.wordsPerRow != (uint64_t)(width + 63) / 64)
+    {
+        error = "snapshot is of a " + std::to_string(header.width) + "x" + std::to_string(header.height) + " grid";
+        return false;
+    }
+    int planes = std::max<int>(header.planes, 1);
+    if(planes != snapshotPlanes(states))
+    {
+        error = "snapshot has " + std::to_string(planes) + " bit planes per row";
+        return false;
+    }
+    for(int y = 0; y<height; y++)
+    {
+        const uint64_t* words = reader.next(planes * header.wordsPerRow);
+        if(words == nullptr)
+        {
+            error = "snapshot is truncated";
+            return false;
+        }
+        restoreRow(conway, y, words, planes);
+    }
+    conway.setGeneration(header.generation);
+    return true;
+}
+
+template <class T, class R>
+bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, Conway<T, R>& conway, int width, int height, std::string& error)
+{
+    return restoreRows(header, reader, conway, conway.lifeRule().states, width, height, error);
+}
+
+template <class R>
+bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, BitConway<R>& conway, int width, int height, std::string& error)
+{
+    return restoreRows(header, reader, conway, 2, width, height, error);
+}
+
+template <class R>
+bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, ChangeListLife<R>& life, int width, int height, std::string& error)
+{
+    return restoreRows(header, reader, life, 2, width, height, error);
+}
+
+inline bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, LargerThanLife& life, int width, int height, std::string& error)
+{
+    return restoreRows(header, reader, life, life.ltlRule().states, width, height, error);
+}
+
+#ifdef CONWAY_GPU
+inline bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, GpuLife& life, int width, int height, std::string& error)
+{
+    return restoreRows(header, reader, life, 2, width, height, error);
+}
+#endif
+
+inline bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, SparseLife& life, int, int, std::string& error)
+{
+    if(header.backend != SNAPSHOT_SPARSE)
+    {
+        error = "snapshot is not of a sparse plane";
+        return false;
+    }
+    life.clear();
+    int coordinates = header.version == 1 ? 1 : 2;  // words of the coordinates before the rows
+    while(!reader.finished())
+    {
+        const uint64_t* words = reader.next(coordinates + SPARSE_CHUNK_SIZE);
+        if(words == nullptr)
+        {
+            error = "snapshot is truncated";
+            return false;
+        }
+        if(coordinates == 1)
+        {
+            life.setChunk((int32_t)(words[0] >> 32), (int32_t)(uint32_t)words[0], words + 1);
+        }
+        else
+        {
+            life.setChunk((int64_t)words[0], (int64_t)words[1], words + 2);
+        }
+    }
+    life.setGeneration(header.generation);
+    return true;
+}
+
+inline bool restorePayload(const SnapshotHeader& header, SnapshotReader& reader, HashLife& life, int, int, std::string& error)
+{
+    if(header.backend != SNAPSHOT_HASHLIFE)
+    {
+        error = "snapshot is not of a HashLife universe";
+        return false;
+    }
+    std::vector<HashLife::Node*> nodes;
+    nodes.push_back(life.makeCell(false));
+    nodes.push_back(life.makeCell(true));
+    while(!reader.finished())
+    {
+        const uint64_t* children = reader.next(4);
+        if(children == nullptr)
+        {
+            error = "snapshot is truncated";
+            return false;
+        }
+        for(int i = 0; i<4; i++)
+        {
+            if(children[i] >= nodes.size() || nodes[children[i]]->level != nodes[children[0]]->level)
+            {
+                error = "snapshot has a broken quadtree";
+                return false;
+            }
+        }
+        nodes.push_back(life.makeNode(nodes[children[0]], nodes[children[1]], nodes[children[2]], nodes[children[3]]));
+    }
+    if(nodes.size() == 2)
+    {
+        error = "snapshot has no quadtree";
+        return false;
+    }
+    if(!life.setRoot(nodes.back(), header.generation))
+    {
+        error = "snapshot wider than 2^62 cells";
+        return false;
+    }
+    return true;
+}
+
+/* check the magic, version and byte order of a header and that it is of the rule */
+inline bool checkSnapshotHeader(SnapshotHeader& header, const std::string& rule, std::string& error)
+{
+    if(std::memcmp(header.magic, "CONWAYSN", sizeof(header.magic)) != 0)
+    {
+        error = "not a snapshot";
+        return false;
+    }
+    if(header.version < 1 || header.version > SNAPSHOT_VERSION || header.byteOrder != SNAPSHOT_BYTE_ORDER)
+    {
+        error = "snapshot of an unsupported version or byte order";
+        return false;
+    }
+    header.rule[sizeof(header.rule) - 1] = 0;
+    if(rule != header.rule)
+    {
+        error = std::string("snapshot is of rule ") + header.rule + ", not " + rule;
+        return false;
+    }
+    return true;
+}
+
+/* restore a process from a snapshot file of the same backend, or a bounded
+   grid from one of the other bounded grid; false with a message if it cannot */
+template <class Process>
+bool restoreSnapshot(const char* path, Process& process, int width, int height, std::string& error)
+{
+    MappedFile file;
+    if(!file.open(path))
+    {
+        error = "cannot open file";
+        return false;
+    }
+    std::size_t size = file.end() - file.begin();
+    SnapshotHeader header;
+    if(size < sizeof(header))
+    {
+        error = "not a snapshot";
+        return false;
+    }
+    std::memcpy(&header, file.begin(), sizeof(header));
+    if(!checkSnapshotHeader(header, snapshotRule(process), error))
+    {
+        return false;
+    }
+    if(header.compression > SNAPSHOT_RLE || (size - sizeof(header)) / sizeof(uint64_t) != header.payloadWords ||
+       (size - sizeof(header)) % sizeof(uint64_t) != 0)
+    {
+        error = "snapshot is damaged";
+        return false;
+    }
+
+    // the mapping is page-aligned and the header keeps the payload word-aligned
+    const uint64_t* payload = reinterpret_cast<const uint64_t*>(file.begin() + sizeof(header));
+    SnapshotReader reader(payload, payload + header.payloadWords, header.compression == SNAPSHOT_RLE);
+    return restorePayload(header, reader, process, width, height, error);
+}
+
+/* restore a process from a snapshot in memory, of whatever rule: the board
+   of a process handed to one of another rule; false with a message if the
+   payload does not fit it */
+template <class Process>
+bool restoreSnapshot(const Snapshot& snapshot, Process& process, int width, int height, std::string& error)
+{
+    SnapshotHeader header = snapshotHeader(snapshot, SNAPSHOT_RAW, snapshot.words.size());
+    SnapshotReader reader(snapshot.words.data(), snapshot.words.data() + snapshot.words.size(), false);
+    return restorePayload(header, reader, process, width, height, error);
+}
+
+/* writes snapshots handed to it on a thread of its own */
+class Checkpointer
+{
+public:
+
+    /* constructor, a snapshot every so many generations goes to path, run-length
+       encoded if compress */
+    Checkpointer(const std::string& path, uint64_t every, bool compress):path(path),
+        every(std::max<uint64_t>(every, 1)), nextDue(0), compress(compress),
+        busy(false), pending(false), stopping(false)
+    {
+        worker = std::thread(&Checkpointer::run, this);
+    }
+
+    /* finish the snapshot being written */
+    ~Checkpointer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    Checkpointer(Checkpointer const&) = delete;
+    Checkpointer& operator=(Checkpointer const&) = delete;
+
+    /* is the writer free to take another snapshot */
+    bool idle() const
+    {
+        return !busy.load(std::memory_order_acquire);
+    }
+
+    /* should a snapshot of this generation be taken; a due snapshot waits
+       for the writer to be idle, counting starts again after a reset */
+    bool due(uint64_t generation)
+    {
+        if(nextDue == 0 || generation + every < nextDue)
+        {
+            nextDue = generation + every;
+        }
+        return generation >= nextDue && idle();
+    }
+
+    /* the snapshot to fill before submit(), only while idle() */
+    Snapshot& spare()
+    {
+        return filling;
+    }
+
+    /* hand the filled snapshot to the writer, only while idle() */
+    void submit()
+    {
+        nextDue = filling.generation + every;
+        busy.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(filling, writing);
+            pending = true;
+        }
+        wake.notify_one();
+    }
+
+    /* have the writer fill the snapshot of a generation with pack, on its
+       thread, and write it; only while idle(), and what pack reads must be
+       left alone until idle() again */
+    void submit(uint64_t generation, std::function<void(Snapshot&)> pack)
+    {
+        nextDue = generation + every;
+        busy.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            packing = std::move(pack);
+            pending = true;
+        }
+        wake.notify_one();
+    }
+
+    /* wait for the snapshot being written, before what it is packed from goes away */
+    void finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]{ return idle(); });
+    }
+
+private:
+
+    /* writer thread */
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            wake.wait(lock, [this]{ return pending || stopping; });
+            if(!pending)
+            {
+                return;
+            }
+            pending = false;
+            lock.unlock();
+            AllowAllocations allow;     // paths and encoded payloads are built as needed
+            if(packing)
+            {
+                packing(writing);
+                packing = nullptr;
+            }
+            std::string error;
+            if(!writeSnapshot(writing, path.c_str(), compress, error))
+            {
+                fprintf(stderr, "checkpoint failed: %s\n", error.c_str());
+            }
+            lock.lock();
+            busy.store(false, std::memory_order_release);
+            done.notify_all();
+        }
+    }
+
+    std::string path;
+    uint64_t every;
+    uint64_t nextDue;           // generation of the next snapshot, 0 before the first call to due()
+    bool compress;
+    Snapshot filling;           // owned by the stepping thread while idle
+    Snapshot writing;           // owned by the writer while busy
+    std::function<void(Snapshot&)> packing;     // fills writing on the writer, empty when submitted filled
+    std::atomic<bool> busy;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    bool pending, stopping;
+    std::thread worker;
+};
+
+#endif
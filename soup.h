@@ -0,0 +1,305 @@
+
+// Author: 	Stephan Meesters
+//
+// Batch soup search
+//
+// A soup search runs a great many small random boards ("soups") until they
+// settle and keeps a census of how they ended. A SoupBatch steps 64 soups
+// in lockstep on one small grid of words: bit i of the word of a cell is
+// that cell in soup i, so the bit-sliced adders of the bit engine step all
+// 64 universes with the same few operations per cell, and neighbours are
+// simply the words of the neighbouring cells.
+//
+// A soup is periodic once its board equals the one SOUP_CHECK_INTERVAL
+// generations earlier; the interval is a multiple of the common periods
+// (1, 2, 3, 4, 5, 6, 8, 15, ...). At the end of a batch the exact period of
+// every settled soup is found by stepping it up to one interval further.
+//
+// searchSoups() hands batches to the threads of a pool as they ask for more
+// work, so batches that settle early do not leave threads idle. Soup k is
+// seeded with firstSeed + k, so any soup of a census can be replayed.
+//
+
+#ifndef CONWAY_SOUP_H
+#define CONWAY_SOUP_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "rule.h"
+#include "bitlife.h"
+
+#define SOUP_LANES 64               // soups per batch, one per bit of a word
+#define SOUP_SIZE_DEFAULT 16        // side of the random square in the middle of the grid
+#define SOUP_CHECK_INTERVAL 120     // generations between periodicity checks
+#define CENSUS_VERSION 1
+#define CENSUS_BYTE_ORDER 0x01020304u      // reads back differently on a host of the other endianness
+
+/* what the search is run with */
+struct SoupSettings
+{
+    SoupSettings():width(64), height(64), soupSize(SOUP_SIZE_DEFAULT), boundary(BOUNDARY_DEAD),
+        generations(10000), soups(SOUP_LANES), firstSeed(0){}
+
+    int width, height;
+    int soupSize;
+    BoundaryPolicy boundary;
+    uint64_t generations;       // most generations a soup is run for
+    uint64_t soups;
+    uint64_t firstSeed;         // soup k is seeded with firstSeed + k
+};
+
+/* census record of one soup */
+struct SoupResult
+{
+    uint64_t seed;
+    uint32_t population;        // live cells at the end
+    uint32_t settled;           // check at which the soup was found periodic, 0 if it was not
+    uint32_t period;            // 0 if it was not periodic
+    uint32_t reserved;
+};
+static_assert(sizeof(SoupResult) == 24, "census records are written as they are");
+
+/* census file header, the records follow right after it */
+struct CensusHeader
+{
+    char magic[8];              // "CONWAYCS"
+    uint32_t version;
+    uint32_t byteOrder;         // CENSUS_BYTE_ORDER
+    uint32_t width, height;
+    uint32_t soupSize;
+    uint32_t boundary;          // BoundaryPolicy
+    uint64_t generations;
+    uint64_t soups;             // records following the header
+    uint64_t firstSeed;
+    char rule[56];              // as written by ruleString(), nul-terminated
+};
+static_assert(sizeof(CensusHeader) == 112, "census records must stay word-aligned");
+
+/* 64 soups stepped together by rule R */
+template <class R = ConwayRule>
+class SoupBatch
+{
+public:
+
+    /* constructor */
+    SoupBatch(const SoupSettings& settings, const R& rule = R()):newGrid(settings.width, settings.height),
+        oldGrid(settings.width, settings.height), checkGrid(settings.width, settings.height),
+        gridWidth(settings.width), gridHeight(settings.height), soupSize(std::min(settings.soupSize, std::min(settings.width, settings.height))),
+        boundary(settings.boundary), rule(rule)
+    {
+    }
+
+    /* run lanes soups, seeded firstSeed, firstSeed + 1, ..., for at most
+       generations, and fill in their results */
+    void run(uint64_t firstSeed, int lanes, uint64_t generations, SoupResult* results)
+    {
+        uint64_t used = lanes >= SOUP_LANES ? ~uint64_t(0) : (uint64_t(1) << lanes) - 1;
+        seed(firstSeed, lanes);
+
+        // step until every soup equals itself an interval ago
+        uint32_t settled[SOUP_LANES] = {0};
+        uint64_t periodic = ~used;
+        copyGrid(checkGrid);
+        for(uint64_t g = 1; g<=generations && periodic != ~uint64_t(0); g++)
+        {
+            update();
+            if(g % SOUP_CHECK_INTERVAL == 0)
+            {
+                uint64_t found = equalLanes(checkGrid) & ~periodic;
+                for(uint64_t left = found; left != 0; left &= left - 1)
+                {
+                    settled[__builtin_ctzll(left)] = (uint32_t)g;
+                }
+                periodic |= found;
+                copyGrid(checkGrid);
+            }
+        }
+
+        // the period of a settled soup is the first generation it is back
+        uint32_t period[SOUP_LANES] = {0};
+        uint64_t waiting = periodic & used;
+        copyGrid(checkGrid);
+        for(int p = 1; p<=SOUP_CHECK_INTERVAL && waiting != 0; p++)
+        {
+            update();
+            uint64_t back = equalLanes(checkGrid) & waiting;
+            for(uint64_t left = back; left != 0; left &= left - 1)
+            {
+                period[__builtin_ctzll(left)] = p;
+            }
+            waiting &= ~back;
+        }
+
+        uint32_t population[SOUP_LANES];
+        countLanes(population);
+        for(int i = 0; i<lanes; i++)
+        {
+            bool found = ((periodic & used) >> i) & 1;
+            results[i] = SoupResult{firstSeed + i, population[i], found ? settled[i] : 0, found ? period[i] : 0, 0};
+        }
+    }
+
+private:
+
+    /* fill the square in the middle of the grid of soup i with random cells from firstSeed + i */
+    void seed(uint64_t firstSeed, int lanes)
+    {
+        newGrid.fill(0);
+        int x0 = (gridWidth - soupSize) / 2, y0 = (gridHeight - soupSize) / 2;
+        for(int i = 0; i<lanes; i++)
+        {
+            std::mt19937_64 gen(firstSeed + i);
+            uint64_t bits = 0;
+            for(int n = 0; n<soupSize*soupSize; n++)
+            {
+                if(n % 64 == 0)
+                {
+                    bits = gen();
+                }
+                newGrid(x0 + n % soupSize, y0 + n / soupSize) |= ((bits >> (n % 64)) & 1) << i;
+            }
+        }
+    }
+
+    /* one generation of all soups */
+    void update()
+    {
+        oldGrid.swap(newGrid);
+        oldGrid.refreshHalo(boundary);
+        for(int j = 0; j<gridHeight; j++)
+        {
+            const uint64_t* a = oldGrid.row(j-1);
+            const uint64_t* b = oldGrid.row(j);
+            const uint64_t* c = oldGrid.row(j+1);
+            uint64_t* out = newGrid.row(j);
+            for(int x = 0; x<gridWidth; x++)
+            {
+                out[x] = lifeWord(rule, a[x-1], a[x], a[x+1], b[x-1], b[x], b[x+1], c[x-1], c[x], c[x+1]);
+            }
+        }
+    }
+
+    /* the soups whose board is the same in newGrid and grid */
+    uint64_t equalLanes(const GridBuffer<uint64_t>& grid) const
+    {
+        uint64_t differ = 0;
+        for(int j = 0; j<gridHeight; j++)
+        {
+            const uint64_t* a = newGrid.row(j);
+            const uint64_t* b = grid.row(j);
+            for(int x = 0; x<gridWidth; x++)
+            {
+                differ |= a[x] ^ b[x];
+            }
+        }
+        return ~differ;
+    }
+
+    /* copy newGrid to grid */
+    void copyGrid(GridBuffer<uint64_t>& grid) const
+    {
+        for(int j = 0; j<gridHeight; j++)
+        {
+            std::copy(newGrid.row(j), newGrid.row(j) + gridWidth, grid.row(j));
+        }
+    }
+
+    /* live cells of every soup */
+    void countLanes(uint32_t* population) const
+    {
+        std::fill(population, population + SOUP_LANES, 0);
+        for(int j = 0; j<gridHeight; j++)
+        {
+            const uint64_t* row = newGrid.row(j);
+            for(int x = 0; x<gridWidth; x++)
+            {
+                for(uint64_t left = row[x]; left != 0; left &= left - 1)
+                {
+                    population[__builtin_ctzll(left)]++;
+                }
+            }
+        }
+    }
+
+    GridBuffer<uint64_t> newGrid;
+    GridBuffer<uint64_t> oldGrid;
+    GridBuffer<uint64_t> checkGrid;     // the board an interval ago
+
+    int gridWidth, gridHeight;
+    int soupSize;
+    BoundaryPolicy boundary;
+    R rule;
+};
+
+/* run every soup of a search, batches spread over the threads of the pool
+   as they finish their last one; nullptr for single-threaded */
+template <class R>
+void searchSoups(const SoupSettings& settings, const R& rule, ThreadPool* pool, std::vector<SoupResult>& results)
+{
+    results.resize(settings.soups);
+    uint64_t batches = (settings.soups + SOUP_LANES - 1) / SOUP_LANES;
+    std::atomic<uint64_t> nextBatch(0);
+    auto work = [&](int, int)
+    {
+        SoupBatch<R> batch(settings, rule);
+        for(uint64_t b = nextBatch++; b<batches; b = nextBatch++)
+        {
+            uint64_t first = b * SOUP_LANES;
+            int lanes = (int)std::min<uint64_t>(SOUP_LANES, settings.soups - first);
+            batch.run(settings.firstSeed + first, lanes, settings.generations, &results[first]);
+        }
+    };
+    if(pool != nullptr && pool->size() > 1)
+    {
+        pool->run(work);
+    }
+    else
+    {
+        work(0, 1);
+    }
+}
+
+/* write a census file, false with the reason if it could not be written */
+inline bool writeCensus(const SoupSettings& settings, const LifeRule& rule, const std::vector<SoupResult>& results,
+                        const char* path, std::string& error)
+{
+    CensusHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CONWAYCS", sizeof(header.magic));
+    header.version = CENSUS_VERSION;
+    header.byteOrder = CENSUS_BYTE_ORDER;
+    header.width = settings.width;
+    header.height = settings.height;
+    header.soupSize = settings.soupSize;
+    header.boundary = settings.boundary;
+    header.generations = settings.generations;
+    header.soups = results.size();
+    header.firstSeed = settings.firstSeed;
+    std::strncpy(header.rule, ruleString(rule).c_str(), sizeof(header.rule) - 1);
+
+    FILE* file = fopen(path, "wb");
+    if(file == nullptr)
+    {
+        error = std::string("cannot create ") + path;
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(results.data(), sizeof(SoupResult), results.size(), file) == results.size();
+    if(fclose(file) != 0 || !written)
+    {
+        error = std::string("cannot write ") + path;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,554 @@
+
+// Author: 	Stephan Meesters
+//
+// Sparse, unbounded Game of Life process
+//
+// The universe is cut in chunks of 64x64 cells and only chunks that hold
+// live cells are stored, in an open-addressing hash map keyed by their 64-bit
+// chunk coordinates. A chunk keeps its rows bit-packed, one uint64_t per row,
+// and is stepped with the same bit-sliced adder as BitConway. Before every
+// generation the empty neighbours that live cells on a chunk edge can grow
+// into are added, and chunks that died out are freed afterwards, so memory
+// follows the population rather than the bounding box of the pattern.
+//
+// The rule is set at runtime. The chunks are stepped by a function
+// instantiated for the matching compile-time rule, picked once per rule
+// change, so the rule costs one indirect call per band of chunks. Rules
+// with B0 would fill the whole plane and are refused.
+//
+// Chunk coordinates are 64-bit, those of every 64-bit cell coordinate, so a
+// pattern travels as far as its coordinates reach; chunks are not grown past
+// that edge, where the plane ends in dead cells. The width x height window at
+// the origin is what is initialized and shown.
+//
+
+#ifndef CONWAY_SPARSE_H
+#define CONWAY_SPARSE_H
+
+#include <cstdint>
+#include <cstring>
+#include <bitset>
+#include <vector>
+#include <functional>
+#include <random>
+
+#include "grid.h"
+#include "threadpool.h"
+#include "bitlife.h"
+#include "rule.h"
+#include "random.h"
+
+#define SPARSE_CHUNK_SIZE 64        // cells per side of a chunk, one word per row
+#define SPARSE_MIN_BUCKETS 64       // smallest hash map size
+#define SPARSE_CHUNK_LIMIT (int64_t(1) << 57)  // chunks lie in [-limit, limit), those of the 64-bit cell coordinates
+
+/* Conway's Game of Life process on an unbounded plane of hashed chunks */
+class SparseLife
+{
+public:
+
+    /* 64x64 cells, the current rows and the rows of the next generation */
+    struct Chunk
+    {
+        uint64_t rows[SPARSE_CHUNK_SIZE];
+        uint64_t next[SPARSE_CHUNK_SIZE];
+        int64_t cx, cy;
+        const Chunk* neighbours[9];     // 3x3 around this chunk, for the step being computed
+    };
+
+    /* constructor, the window is width x height cells at the origin */
+    SparseLife(int width, int height):gridWidth(width), gridHeight(height),
+        display((width + 63) / 64, height), wordsPerRow((width + 63) / 64),
+        lastMask(~uint64_t(0) >> (63 - ((width - 1) & 63))), pool(nullptr),
+        buckets(SPARSE_MIN_BUCKETS, nullptr), count(0), generations(0),
+        rule(ConwayRule::lifeRule()), stepBand(&SparseLife::stepChunks<ConwayRule>)
+    {
+        std::memset(&none, 0, sizeof(none));
+    }
+
+    ~SparseLife()
+    {
+        // deleted rather than released, keeping them spare could allocate
+        for(Chunk* chunk: chunks)
+        {
+            delete chunk;
+        }
+        for(Chunk* chunk: spare)
+        {
+            delete chunk;
+        }
+    }
+
+    SparseLife(SparseLife const&) = delete;
+    SparseLife& operator=(SparseLife const&) = delete;
+
+    /* initialize the window with random values, same board as Conway<T> */
+    void randomInitialization(short sparseness)
+    {
+        auto gen = std::bind(std::uniform_int_distribution<>(0,sparseness),std::default_random_engine());
+        clear();
+        for(int i = 0; i<gridWidth; i++)
+        {
+            for(int j = 0; j<gridHeight; j++)
+            {
+                if(gen() == 0)
+                {
+                    setCell(i, j, true);
+                }
+            }
+        }
+    }
+
+    /* fill the window of the grid size at the origin with random cells of a
+       density in RANDOM_DENSITY_BITS fractional bits, the board of the seed
+       (see random.h); a word of a row is a row of one chunk */
+    void randomFill(uint64_t seed, uint32_t density)
+    {
+        uint64_t key = randomKey(seed);
+        std::vector<uint64_t> words((gridWidth + 63) / 64);
+        clear();
+        for(int j = 0; j<gridHeight; j++)
+        {
+            randomRow(key, j, gridWidth, density, words.data());
+            for(int i = 0; i<(int)words.size(); i++)
+            {
+                if(words[i] != 0)
+                {
+                    Chunk* chunk = find(i, j >> 6);
+                    if(chunk == nullptr)
+                    {
+                        chunk = insert(i, j >> 6);
+                    }
+                    chunk->rows[j & 63] = words[i];
+                }
+            }
+        }
+    }
+
+    /* remove all cells, freeing every chunk */
+    void clear()
+    {
+        for(Chunk* chunk: chunks)
+        {
+            release(chunk);
+        }
+        chunks.clear();
+        buckets.assign(SPARSE_MIN_BUCKETS, nullptr);
+        count = 0;
+        generations = 0;
+    }
+
+    /* step the chunks in parallel on a pool of threads, nullptr for single-threaded */
+    void setThreadPool(ThreadPool* threadPool)
+    {
+        pool = threadPool;
+    }
+
+    /* step by another rule, false for rules with B0 or more than two states */
+    bool setRule(const LifeRule& newRule)
+    {
+        if((newRule.birth & 1) || newRule.states > 2)
+        {
+            return false;
+        }
+        RuleSelector selector = {this};
+        dispatchRule(newRule, selector);
+        rule = newRule;
+        return true;
+    }
+
+    /* the rule the plane is stepped by */
+    LifeRule lifeRule() const { return rule; }
+
+    /* set a cell anywhere on the plane */
+    void setCell(int64_t x, int64_t y, bool alive)
+    {
+        int64_t cx = x >> 6, cy = y >> 6;
+        uint64_t bit = uint64_t(1) << (x & 63);
+        Chunk* chunk = find(cx, cy);
+        if(alive)
+        {
+            if(chunk == nullptr)
+            {
+                chunk = insert(cx, cy);
+            }
+            chunk->rows[y & 63] |= bit;
+        }
+        else if(chunk != nullptr)
+        {
+            chunk->rows[y & 63] &= ~bit;
+        }
+    }
+
+    /* set the 64 rows of the chunk at chunk coordinates (cx, cy) */
+    void setChunk(int64_t cx, int64_t cy, const uint64_t* rows)
+    {
+        Chunk* chunk = find(cx, cy);
+        if(chunk == nullptr)
+        {
+            chunk = insert(cx, cy);
+        }
+        std::copy(rows, rows + SPARSE_CHUNK_SIZE, chunk->rows);
+    }
+
+    /* every stored chunk, in no particular order; some may be empty */
+    const std::vector<Chunk*>& storedChunks() const
+    {
+        return chunks;
+    }
+
+    /* read a cell anywhere on the plane */
+    bool cell(int64_t x, int64_t y) const
+    {
+        const Chunk* chunk = find(x >> 6, y >> 6);
+        return chunk != nullptr && ((chunk->rows[y & 63] >> (x & 63)) & 1);
+    }
+
+    /* live cells on the whole plane */
+    uint64_t population() const
+    {
+        uint64_t total = 0;
+        for(const Chunk* chunk: chunks)
+        {
+            for(int y = 0; y<SPARSE_CHUNK_SIZE; y++)
+            {
+                total += std::bitset<64>(chunk->rows[y]).count();
+            }
+        }
+        return total;
+    }
+
+    /* chunks currently stored */
+    std::size_t chunkCount() const
+    {
+        return chunks.size();
+    }
+
+    /* return a view of the window at the origin */
+    BitGridView fullGrid()
+    {
+        display.fill(0);
+        for(int wx = 0; wx<wordsPerRow; wx++)
+        {
+            for(int cy = 0; cy*SPARSE_CHUNK_SIZE < gridHeight; cy++)
+            {
+                const Chunk* chunk = find(wx, cy);
+                if(chunk == nullptr)
+                {
+                    continue;
+                }
+                int rows = std::min(SPARSE_CHUNK_SIZE, gridHeight - cy*SPARSE_CHUNK_SIZE);
+                for(int y = 0; y<rows; y++)
+                {
+                    display(wx, cy*SPARSE_CHUNK_SIZE + y) = chunk->rows[y] & (wx == wordsPerRow-1 ? lastMask : ~uint64_t(0));
+                }
+            }
+        }
+        return BitGridView(display.row(0), gridWidth, gridHeight, display.stride());
+    }
+
+    /* main update loop */
+    void update()
+    {
+        // grow into the empty neighbours that live cells on an edge reach
+        std::size_t existing = chunks.size();
+        for(std::size_t i = 0; i<existing; i++)
+        {
+            expand(chunks[i]);
+        }
+        for(Chunk* chunk: chunks)
+        {
+            findNeighbours(chunk);
+        }
+
+        // compute every chunk from the current rows
+        if(pool != nullptr && pool->size() > 1)
+        {
+            pool->run([this](int band, int numBands)
+            {
+                int begin, end;
+                ThreadPool::bandRange(band, numBands, (int)chunks.size(), begin, end);
+                (this->*stepBand)(begin, end);
+            });
+        }
+        else
+        {
+            (this->*stepBand)(0, (int)chunks.size());
+        }
+
+        // move to the next generation, free the chunks that died out
+        std::size_t kept = 0;
+        for(Chunk* chunk: chunks)
+        {
+            uint64_t any = 0;
+            for(int y = 0; y<SPARSE_CHUNK_SIZE; y++)
+            {
+                chunk->rows[y] = chunk->next[y];
+                any |= chunk->next[y];
+            }
+            if(any != 0)
+            {
+                chunks[kept++] = chunk;
+            }
+            else
+            {
+                erase(chunk);
+            }
+        }
+        chunks.resize(kept);
+        shrinkIfSparse();
+        generations++;
+    }
+
+    /* generations computed since the plane was initialized */
+    uint64_t generation() const { return generations; }
+    void setGeneration(uint64_t generation) { generations = generation; }
+
+private:
+
+    /* add the empty chunks that cells on the edges of a chunk can be born in */
+    void expand(const Chunk* chunk)
+    {
+        // rows that can reach the chunks above, beside and below,
+        // and the columns that can reach the chunks left, in line and right
+        uint64_t any = 0;
+        for(int y = 0; y<SPARSE_CHUNK_SIZE; y++)
+        {
+            any |= chunk->rows[y];
+        }
+        const uint64_t reachRows[3] = {chunk->rows[0], any, chunk->rows[SPARSE_CHUNK_SIZE-1]};
+        const uint64_t reachColumns[3] = {1, ~uint64_t(0), uint64_t(1) << 63};
+        for(int dy = -1; dy<=1; dy++)
+        {
+            for(int dx = -1; dx<=1; dx++)
+            {
+                if((dx != 0 || dy != 0) && (reachRows[dy+1] & reachColumns[dx+1]) != 0 && inPlane(chunk->cx + dx, chunk->cy + dy))
+                {
+                    ensure(chunk->cx + dx, chunk->cy + dy);
+                }
+            }
+        }
+    }
+
+    /* point a chunk at its eight neighbours, the empty chunk where there is none */
+    void findNeighbours(Chunk* chunk) const
+    {
+        for(int dy = -1; dy<=1; dy++)
+        {
+            for(int dx = -1; dx<=1; dx++)
+            {
+                const Chunk* neighbour = dx == 0 && dy == 0 ? chunk : find(chunk->cx + dx, chunk->cy + dy);
+                chunk->neighbours[(dy+1)*3 + dx+1] = neighbour != nullptr ? neighbour : &none;
+            }
+        }
+    }
+
+    /* row y of the 3x3 neighbourhood as shifted west, unshifted and shifted east, y in [-1, 64] */
+    static void neighbourRow(const Chunk* const* neighbours, int y, uint64_t& west, uint64_t& row, uint64_t& east)
+    {
+        const Chunk* const* band = neighbours + (y < 0 ? 0 : y >= SPARSE_CHUNK_SIZE ? 6 : 3);
+        int r = y & (SPARSE_CHUNK_SIZE-1);
+        row = band[1]->rows[r];
+        west = (row << 1) | (band[0]->rows[r] >> 63);
+        east = (row >> 1) | (band[2]->rows[r] << 63);
+    }
+
+    /* compute the next rows of chunks [begin, end) of the list */
+    template <class R>
+    void stepChunks(int begin, int end)
+    {
+        R stepRule(rule);
+        for(int i = begin; i<end; i++)
+        {
+            step(stepRule, chunks[i]);
+        }
+    }
+
+    /* points stepBand at the instantiation for a rule */
+    struct RuleSelector
+    {
+        SparseLife* life;
+
+        template <class R>
+        void operator()(const R&)
+        {
+            life->stepBand = &SparseLife::stepChunks<R>;
+        }
+
+        /* refused by setRule(), a chunk holds no more than two states */
+        void operator()(const GenerationsRule&){}
+    };
+
+    /* compute the next rows of a chunk */
+    template <class R>
+    static void step(const R& rule, Chunk* chunk)
+    {
+        uint64_t aw, a, ae, bw, b, be, cw, c, ce;
+        neighbourRow(chunk->neighbours, -1, aw, a, ae);
+        neighbourRow(chunk->neighbours, 0, bw, b, be);
+        for(int y = 0; y<SPARSE_CHUNK_SIZE; y++)
+        {
+            neighbourRow(chunk->neighbours, y+1, cw, c, ce);
+            chunk->next[y] = lifeWord(rule, aw, a, ae, bw, b, be, cw, c, ce);
+            aw = bw; a = b; ae = be;
+            bw = cw; b = c; be = ce;
+        }
+    }
+
+    /* are chunk coordinates those of 64-bit cell coordinates */
+    static bool inPlane(int64_t cx, int64_t cy)
+    {
+        return cx >= -SPARSE_CHUNK_LIMIT && cx < SPARSE_CHUNK_LIMIT && cy >= -SPARSE_CHUNK_LIMIT && cy < SPARSE_CHUNK_LIMIT;
+    }
+
+    /* hash of chunk coordinates, the splitmix64 finalizer of both mixed */
+    static std::size_t slotOf(int64_t cx, int64_t cy, std::size_t mask)
+    {
+        uint64_t key = uint64_t(cx) * 0x9e3779b97f4a7c15ULL ^ uint64_t(cy);
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return (std::size_t)(key ^ (key >> 31)) & mask;
+    }
+
+    /* chunk at chunk coordinates, nullptr if it is not stored */
+    Chunk* find(int64_t cx, int64_t cy) const
+    {
+        std::size_t mask = buckets.size() - 1;
+        for(std::size_t i = slotOf(cx, cy, mask); buckets[i] != nullptr; i = (i+1) & mask)
+        {
+            if(buckets[i]->cx == cx && buckets[i]->cy == cy)
+            {
+                return buckets[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /* chunk at chunk coordinates, added empty if it is not stored */
+    void ensure(int64_t cx, int64_t cy)
+    {
+        if(find(cx, cy) == nullptr)
+        {
+            insert(cx, cy);
+        }
+    }
+
+    /* add an empty chunk that is not stored yet */
+    Chunk* insert(int64_t cx, int64_t cy)
+    {
+        if(2*(count+1) > buckets.size())
+        {
+            rehash(buckets.size() * 2);
+        }
+        Chunk* chunk;
+        if(!spare.empty())
+        {
+            chunk = spare.back();
+            spare.pop_back();
+        }
+        else
+        {
+            chunk = new Chunk;
+        }
+        std::memset(chunk, 0, sizeof(Chunk));
+        chunk->cx = cx;
+        chunk->cy = cy;
+        place(chunk);
+        chunks.push_back(chunk);
+        return chunk;
+    }
+
+    /* put a chunk in its first free slot */
+    void place(Chunk* chunk)
+    {
+        std::size_t mask = buckets.size() - 1;
+        std::size_t i = slotOf(chunk->cx, chunk->cy, mask);
+        while(buckets[i] != nullptr)
+        {
+            i = (i+1) & mask;
+        }
+        buckets[i] = chunk;
+        count++;
+    }
+
+    /* remove a chunk from the hash map, shifting back the chunks probed past it;
+       the caller takes it out of the chunk list */
+    void erase(Chunk* chunk)
+    {
+        std::size_t mask = buckets.size() - 1;
+        std::size_t i = slotOf(chunk->cx, chunk->cy, mask);
+        while(buckets[i] != chunk)
+        {
+            i = (i+1) & mask;
+        }
+        buckets[i] = nullptr;
+        count--;
+        for(std::size_t j = (i+1) & mask; buckets[j] != nullptr; j = (j+1) & mask)
+        {
+            // move back a chunk whose home slot is not between the hole and itself
+            std::size_t home = slotOf(buckets[j]->cx, buckets[j]->cy, mask);
+            if(((j - home) & mask) >= ((j - i) & mask))
+            {
+                buckets[i] = buckets[j];
+                buckets[j] = nullptr;
+                i = j;
+            }
+        }
+        release(chunk);
+    }
+
+    /* keep a freed chunk for reuse, up to a quarter of the stored ones */
+    void release(Chunk* chunk)
+    {
+        if(spare.size() < count/4 + 16)
+        {
+            spare.push_back(chunk);
+        }
+        else
+        {
+            delete chunk;
+        }
+    }
+
+    /* halve the hash map when it is mostly empty */
+    void shrinkIfSparse()
+    {
+        std::size_t size = buckets.size();
+        while(size > SPARSE_MIN_BUCKETS && 8*count < size)
+        {
+            size /= 2;
+        }
+        if(size != buckets.size())
+        {
+            rehash(size);
+        }
+    }
+
+    /* move every chunk to a hash map of a new size */
+    void rehash(std::size_t size)
+    {
+        buckets.assign(size, nullptr);
+        count = 0;
+        for(Chunk* chunk: chunks)
+        {
+            place(chunk);
+        }
+    }
+
+    int gridWidth, gridHeight;
+    GridBuffer<uint64_t> display;   // window at the origin
+    int wordsPerRow;
+    uint64_t lastMask;              // valid bits of the last word of a display row
+    ThreadPool* pool;
+
+    std::vector<Chunk*> buckets;    // open addressing, size is a power of two
+    std::size_t count;              // chunks in the hash map
+    std::vector<Chunk*> chunks;     // every stored chunk, in no particular order
+    std::vector<Chunk*> spare;      // freed chunks kept for reuse
+    Chunk none;                     // stands in for missing neighbours, always empty
+    uint64_t generations;
+    LifeRule rule;
+    void (SparseLife::*stepBand)(int begin, int end);     // stepChunks for the rule
+};
+
+#endif
@@ -0,0 +1,71 @@
+// Author: 	Stephan Meesters
+//
+// Lock-free queue between one producer and one consumer thread
+//
+// A ring of a fixed number of slots, with a position for either side. The
+// producer writes a slot and then moves its position past it, the consumer
+// reads a slot and then moves its own; each side only ever stores its own
+// position, so no slot is read and written at the same time and neither side
+// takes a lock or waits. A full queue refuses the item instead of growing, so
+// pushing never allocates.
+//
+
+#ifndef CONWAY_SPSCQUEUE_H
+#define CONWAY_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+/* queue of up to N items of type T, N a power of two */
+template <class T, uint32_t N>
+class SpscQueue
+{
+public:
+
+    static_assert(N > 0 && (N & (N - 1)) == 0, "the queue size must be a power of two");
+
+    SpscQueue():head(0), tail(0){}
+
+    SpscQueue(SpscQueue const&) = delete;
+    SpscQueue& operator=(SpscQueue const&) = delete;
+
+    /* producer: append an item, false if the queue is full */
+    bool push(const T& item)
+    {
+        uint32_t end = tail.load(std::memory_order_relaxed);
+        if(end - head.load(std::memory_order_acquire) == N)
+        {
+            return false;
+        }
+        slots[end & (N - 1)] = item;
+        tail.store(end + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer: take the oldest item, false if the queue is empty */
+    bool pop(T& item)
+    {
+        uint32_t begin = head.load(std::memory_order_relaxed);
+        if(begin == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots[begin & (N - 1)];
+        head.store(begin + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* either side: is the queue empty right now */
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+
+    T slots[N];
+    alignas(64) std::atomic<uint32_t> head;     // next slot to read, stored by the consumer
+    alignas(64) std::atomic<uint32_t> tail;     // next slot to write, stored by the producer
+};
+
+#endif
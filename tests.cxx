@@ -0,0 +1,403 @@
+// Author: 	Stephan Meesters
+//
+// Cross-engine tests of libconway
+//
+// Every engine is driven through the C API of libconway.h from the same
+// random board, and their hashes and populations are compared after a few
+// runs of generations: the bounded engines with one another for every rule
+// and boundary, the unbounded ones with one another and, after their first
+// generation, with the byte engine on a dead boundary. Snapshots are written,
+// plain and run-length encoded, restored into a new process and stepped on
+// beside the one they were taken of. A board larger than two step tiles
+// each way is compared the same, and a few patterns of known fate are
+// stepped on every engine: the blinker, a glider across the edges of a
+// torus and the R-pentomino.
+//
+// A failure is printed and the suite exits with EXIT_FAILURE when there was
+// one, so that ctest reports it.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "libconway.h"
+
+#define TEST_WIDTH 100          // not a multiple of 64, so the bit engines have a partial last word
+#define TEST_HEIGHT 70
+#define TEST_LARGE_WIDTH 1100   // over two STEP_TILE_SIZE each way, and not a multiple of it either
+#define TEST_LARGE_HEIGHT 1030
+#define TEST_THREADS 2
+#define TEST_SEED 7
+#define TEST_DENSITY 0.35
+#define TEST_LIFE_LTL "R1,C0,M0,S2..3,B3..3,NM"     // Conway's rule in Larger than Life notation
+#define TEST_R_GENERATIONS 1103 // the R-pentomino settles down to a population of 116
+#define TEST_R_POPULATION 116
+
+/* a rule, and whether the unbounded engines take it */
+struct TestRule
+{
+    const char* rule;
+    bool unbounded;             // the sparse and hashlife engines take it too, it has no B0
+};
+
+/* failed checks so far */
+static int failures = 0;
+
+/* count and report a failed check */
+static void fail(const std::string& what)
+{
+    printf("FAILED: %s\n", what.c_str());
+    failures++;
+}
+
+/* create an empty process, or report why it cannot be */
+static conway_life* createEmpty(const char* engine, const char* rule, conway_boundary boundary, bool bounded,
+                                int width, int height)
+{
+    char error[256];
+    conway_life* life = conway_create(engine, width, height, rule, TEST_THREADS, error, sizeof(error));
+    if(life == nullptr)
+    {
+        fail(std::string("cannot create ") + engine + " for " + rule + ": " + error);
+        return nullptr;
+    }
+    if(bounded && conway_set_boundary(life, boundary) != CONWAY_OK)
+    {
+        fail(std::string(engine) + " for " + rule + ": " + conway_error(life));
+        conway_destroy(life);
+        return nullptr;
+    }
+    return life;
+}
+
+/* create a process, randomly filled, or report why it cannot be */
+static conway_life* create(const char* engine, const char* rule, conway_boundary boundary, bool bounded,
+                           int width = TEST_WIDTH, int height = TEST_HEIGHT)
+{
+    conway_life* life = createEmpty(engine, rule, boundary, bounded, width, height);
+    if(life != nullptr && conway_fill_random(life, TEST_SEED, TEST_DENSITY) != CONWAY_OK)
+    {
+        fail(std::string(engine) + " for " + rule + ": " + conway_error(life));
+        conway_destroy(life);
+        return nullptr;
+    }
+    return life;
+}
+
+/* set the cells of a pattern of rows of 'o' for alive at (x, y), wrapping around the edges */
+static void place(conway_life* life, const std::vector<const char*>& rows, int x, int y)
+{
+    for(int j = 0; j<(int)rows.size(); j++)
+    {
+        for(int i = 0; rows[j][i] != 0; i++)
+        {
+            if(rows[j][i] == 'o')
+            {
+                conway_set_cell(life, (x + i) % conway_width(life), (y + j) % conway_height(life), 1);
+            }
+        }
+    }
+}
+
+/* are the cells of a pattern alive at (x, y), wrapping around the edges, and
+   are they the whole population */
+static bool holds(conway_life* life, const std::vector<const char*>& rows, int x, int y)
+{
+    uint64_t cells = 0;
+    for(int j = 0; j<(int)rows.size(); j++)
+    {
+        for(int i = 0; rows[j][i] != 0; i++)
+        {
+            if(rows[j][i] == 'o')
+            {
+                cells++;
+                if(conway_get_cell(life, (x + i) % conway_width(life), (y + j) % conway_height(life)) == 0)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return conway_population(life) == cells;
+}
+
+/* do two processes hold the same board at the same generation */
+static bool same(conway_life* a, conway_life* b, const std::string& what)
+{
+    if(conway_generation(a) != conway_generation(b) || conway_population(a) != conway_population(b) ||
+       conway_hash(a) != conway_hash(b))
+    {
+        char numbers[160];
+        snprintf(numbers, sizeof(numbers), ": generation %llu/%llu, population %llu/%llu",
+                 (unsigned long long)conway_generation(a), (unsigned long long)conway_generation(b),
+                 (unsigned long long)conway_population(a), (unsigned long long)conway_population(b));
+        fail(what + numbers);
+        return false;
+    }
+    return true;
+}
+
+/* step every process n generations, false if one fails */
+static bool step(const std::vector<conway_life*>& lives, uint64_t n, const std::string& what)
+{
+    for(conway_life* life: lives)
+    {
+        if(conway_step(life, n) != CONWAY_OK)
+        {
+            fail(what + ": " + conway_error(life));
+            return false;
+        }
+    }
+    return true;
+}
+
+/* step processes of several engines side by side, comparing each with the
+   first after every run of generations */
+static void compareEngines(const std::vector<conway_life*>& lives, const std::vector<const char*>& engines,
+                           const std::string& what)
+{
+    static const uint64_t runs[] = {1, 7, 24, 64};
+    for(uint64_t n: runs)
+    {
+        if(!step(lives, n, what))
+        {
+            return;
+        }
+        for(std::size_t i = 1; i<lives.size(); i++)
+        {
+            if(!same(lives[0], lives[i], what + ", " + engines[0] + " and " + engines[i]))
+            {
+                return;
+            }
+        }
+    }
+}
+
+/* the bounded engines agree on every boundary */
+static void testBounded(const TestRule& rule)
+{
+    static const conway_boundary boundaries[] = {CONWAY_BOUNDARY_TORUS, CONWAY_BOUNDARY_DEAD, CONWAY_BOUNDARY_MIRROR};
+    static const char* names[] = {"torus", "dead", "mirror"};
+    for(int b = 0; b<3; b++)
+    {
+        std::vector<const char*> engines = {"byte", "bit", "changes"};
+        std::vector<const char*> rules(engines.size(), rule.rule);
+        if(strcmp(rule.rule, "B3/S23") == 0)
+        {
+            engines.push_back("ltl");
+            rules.push_back(TEST_LIFE_LTL);
+        }
+        std::vector<conway_life*> lives;
+        for(std::size_t i = 0; i<engines.size(); i++)
+        {
+            if(conway_life* life = create(engines[i], rules[i], boundaries[b], true))
+            {
+                lives.push_back(life);
+            }
+        }
+        if(lives.size() == engines.size())
+        {
+            compareEngines(lives, engines, std::string(rule.rule) + " on " + names[b]);
+        }
+        for(conway_life* life: lives)
+        {
+            conway_destroy(life);
+        }
+    }
+}
+
+/* the unbounded engines agree with one another, and with a dead boundary
+   until the board has grown past the window */
+static void testUnbounded(const TestRule& rule)
+{
+    conway_life* dead = create("byte", rule.rule, CONWAY_BOUNDARY_DEAD, true);
+    conway_life* sparse = create("sparse", rule.rule, CONWAY_BOUNDARY_DEAD, false);
+    conway_life* hashlife = create("hashlife", rule.rule, CONWAY_BOUNDARY_DEAD, false);
+    std::string what = std::string(rule.rule) + " unbounded";
+    if(dead != nullptr && sparse != nullptr && hashlife != nullptr && step({dead, sparse, hashlife}, 1, what) &&
+       same(dead, sparse, what + ", byte on dead and sparse") && same(dead, hashlife, what + ", byte on dead and hashlife"))
+    {
+        compareEngines({sparse, hashlife}, {"sparse", "hashlife"}, what);
+    }
+    conway_destroy(dead);
+    conway_destroy(sparse);
+    conway_destroy(hashlife);
+}
+
+/* the bounded engines agree on a board of several step tiles each way, so
+   that temporal blocking, activity tracking and the bands of the threads
+   all meet the edges of their tiles */
+static void testLarge()
+{
+    static const conway_boundary boundaries[] = {CONWAY_BOUNDARY_TORUS, CONWAY_BOUNDARY_DEAD};
+    static const char* names[] = {"torus", "dead"};
+    for(int b = 0; b<2; b++)
+    {
+        std::vector<const char*> engines = {"byte", "bit", "changes", "ltl"};
+        std::vector<conway_life*> lives;
+        for(const char* engine: engines)
+        {
+            const char* rule = strcmp(engine, "ltl") == 0 ? TEST_LIFE_LTL : "B3/S23";
+            if(conway_life* life = create(engine, rule, boundaries[b], true, TEST_LARGE_WIDTH, TEST_LARGE_HEIGHT))
+            {
+                lives.push_back(life);
+            }
+        }
+        if(lives.size() == engines.size())
+        {
+            compareEngines(lives, engines, std::string("large board on ") + names[b]);
+        }
+        for(conway_life* life: lives)
+        {
+            conway_destroy(life);
+        }
+    }
+}
+
+/* patterns of known fate: the blinker has a period of 2, a glider moves a
+   cell down and right every 4 generations, also across the edges of a
+   torus, and the R-pentomino has 116 cells at generation 1103 */
+static void testKnown(const char* engine, const char* rule, bool bounded)
+{
+    static const std::vector<const char*> blinker = {"ooo"};
+    static const std::vector<const char*> blinkerTurned = {"o", "o", "o"};
+    static const std::vector<const char*> glider = {".o.", "..o", "ooo"};
+    static const std::vector<const char*> rPentomino = {".oo", "oo.", ".o."};
+    std::string what = std::string(engine) + " " + rule;
+    if(conway_life* life = createEmpty(engine, rule, CONWAY_BOUNDARY_TORUS, bounded, TEST_WIDTH, TEST_HEIGHT))
+    {
+        place(life, blinker, 10, 10);
+        uint64_t hash = conway_hash(life);
+        if(step({life}, 1, what))
+        {
+            if(!holds(life, blinkerTurned, 11, 9))
+            {
+                fail(what + ": the blinker does not turn");
+            }
+            else if(step({life}, 1, what) && (!holds(life, blinker, 10, 10) || conway_hash(life) != hash))
+            {
+                fail(what + ": the blinker does not come back after 2 generations");
+            }
+        }
+        conway_destroy(life);
+    }
+    if(bounded)
+    {
+        if(conway_life* life = createEmpty(engine, rule, CONWAY_BOUNDARY_TORUS, true, TEST_WIDTH, TEST_HEIGHT))
+        {
+            place(life, glider, TEST_WIDTH - 2, TEST_HEIGHT - 2);
+            for(int n = 1; n<=3; n++)
+            {
+                if(!step({life}, 4, what) || !holds(life, glider, TEST_WIDTH - 2 + n, TEST_HEIGHT - 2 + n))
+                {
+                    fail(what + ": the glider is not where it should be after " + std::to_string(4*n) +
+                         " generations on a torus");
+                    break;
+                }
+            }
+            conway_destroy(life);
+        }
+    }
+
+    // the gliders it sends out stay clear of the edges of the large board
+    if(conway_life* life = createEmpty(engine, rule, CONWAY_BOUNDARY_DEAD, bounded, TEST_LARGE_WIDTH, TEST_LARGE_HEIGHT))
+    {
+        place(life, rPentomino, TEST_LARGE_WIDTH / 2, TEST_LARGE_HEIGHT / 2);
+        if(step({life}, TEST_R_GENERATIONS, what) && conway_population(life) != TEST_R_POPULATION)
+        {
+            fail(what + ": the R-pentomino has " + std::to_string(conway_population(life)) + " cells at generation " +
+                 std::to_string(TEST_R_GENERATIONS) + ", not " + std::to_string(TEST_R_POPULATION));
+        }
+        conway_destroy(life);
+    }
+}
+
+/* a restored snapshot holds the board it was taken of, and goes on the same */
+static void testSnapshot(const char* engine, const char* rule, bool bounded, const char* path)
+{
+    for(int compress = 0; compress<2; compress++)
+    {
+        std::string what = std::string(engine) + " " + rule + (compress ? " snapshot, compressed" : " snapshot");
+        conway_life* life = create(engine, rule, CONWAY_BOUNDARY_TORUS, bounded);
+        conway_life* restored = create(engine, rule, CONWAY_BOUNDARY_TORUS, bounded);
+        if(life != nullptr && restored != nullptr && step({life}, 13, what))
+        {
+            if(conway_save_snapshot(life, path, compress) != CONWAY_OK)
+            {
+                fail(what + ": " + conway_error(life));
+            }
+            else if(conway_restore_snapshot(restored, path) != CONWAY_OK)
+            {
+                fail(what + ": " + conway_error(restored));
+            }
+            else if(same(life, restored, what + ", restored") && step({life, restored}, 20, what))
+            {
+                same(life, restored, what + ", stepped after restoring");
+            }
+        }
+        conway_destroy(life);
+        conway_destroy(restored);
+    }
+    remove(path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char* path = "conway-tests.snapshot";
+    if(argc == 2)
+    {
+        path = argv[1];
+    }
+    else if(argc > 2)
+    {
+        printf("usage: ConwayTests [scratch snapshot file]\n");
+        return EXIT_FAILURE;
+    }
+    if(conway_api_version() != CONWAY_API_VERSION)
+    {
+        printf("FAILED: library of API version %d, header of %d\n", conway_api_version(), CONWAY_API_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    const TestRule rules[] = {{"B3/S23", true}, {"B36/S23", true}, {"B3678/S34678", true}, {"B1357/S1357", true},
+                              {"B0/S8", false}};
+    for(const TestRule& rule: rules)
+    {
+        testBounded(rule);
+        if(rule.unbounded)
+        {
+            testUnbounded(rule);
+        }
+    }
+
+    testLarge();
+
+    const char* boundedEngines[] = {"byte", "bit", "changes"};
+    for(const char* engine: boundedEngines)
+    {
+        testKnown(engine, "B3/S23", true);
+    }
+    testKnown("ltl", TEST_LIFE_LTL, true);
+    testKnown("sparse", "B3/S23", false);
+    testKnown("hashlife", "B3/S23", false);
+
+    for(const char* engine: boundedEngines)
+    {
+        testSnapshot(engine, "B3/S23", true, path);
+    }
+    testSnapshot("byte", "B2/S/C3", true, path);    // a plane per bit of the state
+    testSnapshot("ltl", TEST_LIFE_LTL, true, path);
+    testSnapshot("sparse", "B3/S23", false, path);
+    testSnapshot("hashlife", "B3/S23", false, path);
+
+    if(failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+
+// Author: 	Stephan Meesters
+//
+// Persistent worker threads for the Game of Life processes
+//
+// The pool is created once and reused for every generation. A job is run by
+// all workers and the calling thread together, each on its own band of the
+// grid, and run() returns once every band is finished.
+//
+
+#ifndef CONWAY_THREADPOOL_H
+#define CONWAY_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+/* reusable barrier for a fixed number of threads */
+class Barrier
+{
+public:
+
+    explicit Barrier(int count):count(count), waiting(count), generation(0){}
+
+    /* block until all threads have arrived */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned int gen = generation;
+        if(--waiting == 0)
+        {
+            generation++;
+            waiting = count;
+            condition.notify_all();
+        }
+        else
+        {
+            condition.wait(lock, [this, gen]{ return gen != generation; });
+        }
+    }
+
+    /* take threads that will never arrive out of the count */
+    void drop(int threads)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        count -= threads;
+        waiting -= threads;
+    }
+
+private:
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    int count, waiting;
+    unsigned int generation;
+};
+
+/* fixed set of worker threads that run a job in bands */
+class ThreadPool
+{
+public:
+
+    /* constructor, numThreads includes the calling thread */
+    explicit ThreadPool(int numThreads):
+        numThreads(std::max(1, numThreads)), startBarrier(this->numThreads),
+        finishBarrier(this->numThreads), jobFunction(nullptr), jobContext(nullptr), stopping(false)
+    {
+        try
+        {
+            for(int i = 1; i<this->numThreads; i++)
+            {
+                workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+            }
+        }
+        catch(...)
+        {
+            // stop the workers that did start before passing the failure on
+            startBarrier.drop(this->numThreads - 1 - (int)workers.size());
+            stopping = true;
+            startBarrier.wait();
+            for(auto& worker: workers)
+            {
+                worker.join();
+            }
+            throw;
+        }
+    }
+
+    ~ThreadPool()
+    {
+        stopping = true;
+        startBarrier.wait();
+        for(auto& worker: workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    /* number of bands a job is split into */
+    int size() const
+    {
+        return numThreads;
+    }
+
+    /* run job(band, numBands) on every thread, return when all are done */
+    template <class Job>
+    void run(const Job& job)
+    {
+        jobFunction = &invoke<Job>;
+        jobContext = &job;
+        startBarrier.wait();
+        job(0, numThreads);
+        finishBarrier.wait();
+    }
+
+    /* the thread of a band, from 1; band 0 runs on the thread that calls run() */
+    std::thread& worker(int band)
+    {
+        return workers[band-1];
+    }
+
+    /* split n items in equal bands, return the range of one band */
+    static void bandRange(int band, int numBands, int n, int& begin, int& end)
+    {
+        begin = (long long)n * band / numBands;
+        end = (long long)n * (band+1) / numBands;
+    }
+
+private:
+
+    /* call a job of a known type through the type-erased pointer */
+    template <class Job>
+    static void invoke(const void* context, int band, int numBands)
+    {
+        (*static_cast<const Job*>(context))(band, numBands);
+    }
+
+    /* wait for jobs and run our band of them */
+    void workerLoop(int band)
+    {
+        while(1)
+        {
+            startBarrier.wait();
+            if(stopping)
+            {
+                return;
+            }
+            jobFunction(jobContext, band, numThreads);
+            finishBarrier.wait();
+        }
+    }
+
+    int numThreads;
+    std::vector<std::thread> workers;
+    Barrier startBarrier, finishBarrier;
+
+    void (*jobFunction)(const void*, int, int);
+    const void* jobContext;
+    bool stopping;  // written before, read after startBarrier
+};
+
+#endif
@@ -0,0 +1,77 @@
+
+// Author: 	Stephan Meesters
+//
+// Lock-free triple buffer between one producer and one consumer thread
+//
+// The producer fills its back slot and publishes it, the consumer picks up
+// the newest published slot. The third slot sits in the middle, its index is
+// swapped atomically together with a flag telling whether it holds a frame
+// the consumer has not seen yet. Neither side ever waits for the other: a
+// slow consumer skips frames and a slow producer shows the last one again.
+//
+
+#ifndef CONWAY_TRIPLEBUFFER_H
+#define CONWAY_TRIPLEBUFFER_H
+
+#include <atomic>
+
+/* triple buffer of slots of type T */
+template <class T>
+class TripleBuffer
+{
+public:
+
+    TripleBuffer():middle(1), back(0), front(2){}
+
+    TripleBuffer(TripleBuffer const&) = delete;
+    TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+    /* producer: the slot to fill */
+    T& writeBuffer()
+    {
+        return slots[back];
+    }
+
+    /* producer: hand the filled slot to the consumer */
+    void publish()
+    {
+        int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = old & INDEX;
+    }
+
+    /* producer: has the consumer picked up the last published slot */
+    bool consumed() const
+    {
+        return (middle.load(std::memory_order_acquire) & FRESH) == 0;
+    }
+
+    /* consumer: move to the newest published slot, false if there is none */
+    bool update()
+    {
+        if((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+        int old = middle.exchange(front, std::memory_order_acq_rel);
+        front = old & INDEX;
+        return true;
+    }
+
+    /* consumer: the slot picked up last */
+    const T& readBuffer() const
+    {
+        return slots[front];
+    }
+
+private:
+
+    static const int INDEX = 3;     // bits of the middle slot index
+    static const int FRESH = 4;     // middle slot not seen by the consumer
+
+    T slots[3];
+    std::atomic<int> middle;
+    alignas(64) int back;           // owned by the producer
+    alignas(64) int front;          // owned by the consumer
+};
+
+#endif
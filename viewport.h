@@ -0,0 +1,89 @@
+
+// Author: 	Stephan Meesters
+//
+// Viewport of the window onto the grid
+//
+// The window shows a rectangle of the grid at a number of cells per pixel,
+// below one when zoomed in. Zooming keeps the cell under the mouse where it
+// is, panning moves the view by a number of pixels. A view is drawn from the
+// level of detail whose blocks are at most a pixel: the cells themselves up
+// close, blocks of 2^k x 2^k cells zoomed out (see pyramid.h), so a frame
+// handles at most about twice as many blocks as the window has pixels in
+// either direction.
+//
+
+#ifndef CONWAY_VIEWPORT_H
+#define CONWAY_VIEWPORT_H
+
+#include <cmath>
+#include <algorithm>
+
+#define VIEWPORT_MIN_SCALE (1.0 / 64)   // cells per pixel when zoomed in all the way
+#define VIEWPORT_ZOOM_STEP 1.25         // zoom factor of a wheel notch or key press
+#define VIEWPORT_PAN_STEP 64            // pixels panned by an arrow key
+
+/* rectangle of the grid shown in the window */
+struct Viewport
+{
+    Viewport():x(0), y(0), scale(1), screenWidth(0), screenHeight(0), gridWidth(0), gridHeight(0){}
+
+    double x, y;                    // cell at the top left corner of the window
+    double scale;                   // cells per pixel
+    int screenWidth, screenHeight;
+    int gridWidth, gridHeight;      // 0 until fitted to a grid
+
+    /* show the whole grid, centred */
+    void fit(int width, int height, int windowWidth, int windowHeight)
+    {
+        gridWidth = width;
+        gridHeight = height;
+        screenWidth = windowWidth;
+        screenHeight = windowHeight;
+        scale = std::max((double)width / windowWidth, (double)height / windowHeight);
+        x = (width - windowWidth * scale) / 2;
+        y = (height - windowHeight * scale) / 2;
+    }
+
+    /* is the view fitted to a grid of this size */
+    bool fitted(int width, int height) const
+    {
+        return gridWidth == width && gridHeight == height;
+    }
+
+    /* zoom by a factor around a pixel of the window, above 1 zooms out */
+    void zoom(double factor, int px, int py)
+    {
+        double cx = x + px * scale, cy = y + py * scale;
+        double fitScale = std::max((double)gridWidth / screenWidth, (double)gridHeight / screenHeight);
+        scale = std::min(std::max(scale * factor, VIEWPORT_MIN_SCALE), std::max(2 * fitScale, 1.0));
+        x = cx - px * scale;
+        y = cy - py * scale;
+        clamp();
+    }
+
+    /* move the view by a number of pixels */
+    void pan(double dx, double dy)
+    {
+        x -= dx * scale;
+        y -= dy * scale;
+        clamp();
+    }
+
+    /* level of detail to draw from, log2 of the cells per block */
+    int level() const
+    {
+        return scale < 2 ? 0 : (int)std::floor(std::log2(scale));
+    }
+
+private:
+
+    /* keep the centre of the window over the grid */
+    void clamp()
+    {
+        double w = screenWidth * scale, h = screenHeight * scale;
+        x = std::min(std::max(x, -w / 2), gridWidth - w / 2);
+        y = std::min(std::max(y, -h / 2), gridHeight - h / 2);
+    }
+};
+
+#endif